@@ -3,6 +3,7 @@
 #include <mutex>
 
 #include <opencv2/opencv.hpp>
+#include "common_helper_cv.h"
 #include "image_processor.h"
 
 //#define WORK_DIR    "/sdcard/resource/"
@@ -40,6 +41,52 @@ Java_com_iwatake_viewandroidtflite_MainActivity_ImageProcessorProcess(
     return ret;
 }
 
+extern "C" JNIEXPORT jint JNICALL
+Java_com_iwatake_viewandroidtflite_MainActivity_ImageProcessorProcessYuv(
+        JNIEnv* env,
+        jobject, /* this */
+        jobject yBuffer,
+        jobject uBuffer,
+        jobject vBuffer,
+        jint    width,
+        jint    height,
+        jint    yRowStride,
+        jint    uvRowStride,
+        jint    uvPixelStride,
+        jint    rotation,
+        jlong   objMatRender) {
+
+    std::lock_guard<std::mutex> lock(g_mtx);
+    int ret = 0;
+    /* Planes of YUV_420_888 are direct buffers, so no copy is needed */
+    const uint8_t* y = (const uint8_t*) env->GetDirectBufferAddress(yBuffer);
+    const uint8_t* u = (const uint8_t*) env->GetDirectBufferAddress(uBuffer);
+    const uint8_t* v = (const uint8_t*) env->GetDirectBufferAddress(vBuffer);
+    if (!y || !u || !v) return -1;
+    cv::Mat* mat_render = (cv::Mat*) objMatRender;  /* 0 = no rendering */
+    ImageProcessor::Result result;
+#ifdef IMAGE_PROCESSOR_HAS_PROCESS_YUV420
+    ret = ImageProcessor::ProcessYuv420(y, u, v, width, height, yRowStride, uvRowStride, uvPixelStride, rotation, mat_render, result);
+#else
+    /* The ImageProcessor takes cv::Mat only. Convert the whole image */
+    CommonHelper::Yuv420Image yuv;
+    yuv.y = y;
+    yuv.u = u;
+    yuv.v = v;
+    yuv.width = width;
+    yuv.height = height;
+    yuv.y_row_stride = yRowStride;
+    yuv.uv_row_stride = uvRowStride;
+    yuv.uv_pixel_stride = uvPixelStride;
+    yuv.rotation = rotation;
+    cv::Mat mat;
+    CommonHelper::ConvertYuv420(yuv, mat);
+    ret = ImageProcessor::Process(mat, result);
+    if (mat_render) *mat_render = mat;
+#endif
+    return ret;
+}
+
 extern "C" JNIEXPORT jint JNICALL
 Java_com_iwatake_viewandroidtflite_MainActivity_ImageProcessorFinalize(
         JNIEnv* env,
@@ -280,29 +280,46 @@ public class MainActivity extends AppCompatActivity {
                 image.close();
                 return;
             }
-            /* Create cv::mat(RGB888) from image(NV21) */
-            Mat matOrg = getMatFromImage(image);
-            /* Fix image rotation (it looks image in PreviewView is automatically fixed by CameraX???) */
-            Mat mat = fixMatRotation(matOrg);
-//            Log.i(TAG, "[analyze] width = " + image.getWidth() + ", height = " + image.getHeight() + "Rotation = " + previewView.getDisplay().getRotation());
-//            Log.i(TAG, "[analyze] mat width = " + matOrg.cols() + ", mat height = " + matOrg.rows());
-
             /* store the original image */
             Bitmap bitmap_src;
+            Mat matOutput;
+            long imageProcessTimeStart;
+            long imageProcessTimeEnd;
             if (viewMode == ViewMode.BeforeAfter) {
+                /* Create cv::mat(RGB888) from image(NV21) */
+                Mat matOrg = getMatFromImage(image);
+                /* Fix image rotation (it looks image in PreviewView is automatically fixed by CameraX???) */
+                Mat mat = fixMatRotation(matOrg);
                 bitmap_src = Bitmap.createBitmap(mat.cols(), mat.rows(), Bitmap.Config.ARGB_8888);
                 Utils.matToBitmap(mat, bitmap_src);
+
+                /* Do some image processing */
+                appStatus = AppStatus.Running;
+                imageProcessTimeStart = System.nanoTime();
+                ImageProcessorProcess(mat.getNativeObjAddr());
+                imageProcessTimeEnd = System.nanoTime();
+                appStatus = AppStatus.Initialized;
+                matOutput = mat;
             } else {
                 bitmap_src = Bitmap.createBitmap(32, 32, Bitmap.Config.ARGB_8888); /* dummy */
-            }
 
-            /* Do some image processing */
-            appStatus = AppStatus.Running;
-            long imageProcessTimeStart = System.nanoTime();
-            ImageProcessorProcess(mat.getNativeObjAddr());
-            long imageProcessTimeEnd = System.nanoTime();
-            appStatus = AppStatus.Initialized;
-            Mat matOutput = mat;
+                /* Pass the camera buffer (YUV_420_888) to native directly. The rotated RGB image is created in native only for display */
+                ImageProxy.PlaneProxy[] planes = image.getPlanes();
+                Mat mat = new Mat();
+                appStatus = AppStatus.Running;
+                imageProcessTimeStart = System.nanoTime();
+                ImageProcessorProcessYuv(planes[0].getBuffer(), planes[1].getBuffer(), planes[2].getBuffer(),
+                        image.getWidth(), image.getHeight(),
+                        planes[0].getRowStride(), planes[1].getRowStride(), planes[1].getPixelStride(),
+                        getImageRotation(), mat.getNativeObjAddr());
+                imageProcessTimeEnd = System.nanoTime();
+                appStatus = AppStatus.Initialized;
+                matOutput = mat;
+            }
+            if (matOutput.empty()) {
+                image.close();
+                return;
+            }
 //            Mat matOutput = new Mat(mat.rows(), mat.cols(), mat.type());
 //            if (matPrevious == null) matPrevious = mat;
 //            Core.absdiff(mat, matPrevious, matOutput);
@@ -364,6 +381,19 @@ public class MainActivity extends AppCompatActivity {
             return mat;
         }
 
+        /* Clockwise rotation to be applied to the camera image. The same as fixMatRotation */
+        private int getImageRotation() {
+            switch (previewView.getDisplay().getRotation()){
+                default:
+                case Surface.ROTATION_0:
+                    return (lensFacing == CameraSelector.LENS_FACING_BACK) ? 90 : 270;
+                case Surface.ROTATION_90:
+                    return 0;
+                case Surface.ROTATION_270:
+                    return 180;
+            }
+        }
+
         private Mat fixMatRotation(Mat matOrg) {
             Mat mat;
             switch (previewView.getDisplay().getRotation()){
@@ -425,6 +455,7 @@ public class MainActivity extends AppCompatActivity {
      */
     public native int ImageProcessorInitialize();
     public native int ImageProcessorProcess(long objMat);
+    public native int ImageProcessorProcessYuv(ByteBuffer y, ByteBuffer u, ByteBuffer v, int width, int height, int yRowStride, int uvRowStride, int uvPixelStride, int rotation, long objMatRender);
     public native int ImageProcessorFinalize();
     public native int ImageProcessorCommand(int cmd);
 }
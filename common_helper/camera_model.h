@@ -24,6 +24,8 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <memory>
 
 #include <opencv2/opencv.hpp>
 #ifdef _OPENMP
@@ -209,6 +211,7 @@ public:
     }
 
     /*** Methods for projection ***/
+    /* Rotation matrix, its inverse and K are unpacked once per call (not per point). Only the pixel ray LUT is cached. It's immutable and replaced as a whole, so the camera can be used from several threads as long as its parameters are not modified */
     void ConvertWorld2Image(const cv::Point3f& object_point, cv::Point2f& image_point)
     {
         std::vector<cv::Point3f> object_point_list = { object_point };
@@ -224,55 +227,35 @@ public:
 #if 1
         /*** Projection ***/
         /* s[x, y, 1] = K * [R t] * [M, 1] = K * M_from_cam */
-        cv::Mat K = this->K;
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat Rt = (cv::Mat_<float>(3, 4) <<
-            R.at<float>(0), R.at<float>(1), R.at<float>(2), this->tx(),
-            R.at<float>(3), R.at<float>(4), R.at<float>(5), this->ty(),
-            R.at<float>(6), R.at<float>(7), R.at<float>(8), this->tz());
-
-        image_point_list.resize(object_point_list.size());
+        const ProjectionParam c = CreateProjectionParam();
+        const int32_t num = static_cast<int32_t>(object_point_list.size());
+        image_point_list.resize(num);
 
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-        for (int32_t i = 0; i < object_point_list.size(); i++) {
+        for (int32_t i = 0; i < num; i++) {
             const auto& object_point = object_point_list[i];
             auto& image_point = image_point_list[i];
-            cv::Mat Mw = (cv::Mat_<float>(4, 1) << object_point.x, object_point.y, object_point.z, 1);
-            cv::Mat Mc = Rt * Mw;
-            float Zc = Mc.at<float>(2);
+            float Xc, Yc, Zc;
+            Transform(c.R, c.t, object_point.x, object_point.y, object_point.z, Xc, Yc, Zc);
             if (Zc <= 0) {
                 /* Do not project points behind the camera */
                 image_point = cv::Point2f(-1, -1);
                 continue;
             }
 
-            cv::Mat XY = K * Mc;
-            float x = XY.at<float>(0);
-            float y = XY.at<float>(1);
-            float s = XY.at<float>(2);
-            x /= s;
-            y /= s;
-
-            if (this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0) {
-                image_point.x = x;
-                image_point.y = y;
-            } else {
+            float u = Xc / Zc;  /* from optical center (normalized) */
+            float v = Yc / Zc;
+            if (c.is_distorted) {
                 /*** Distort ***/
-                float u = (x - this->cx()) / this->fx();  /* from optical center*/
-                float v = (y - this->cy()) / this->fy();  /* from optical center*/
                 float r2 = u * u + v * v;
                 float r4 = r2 * r2;
-                float k1 = this->dist_coeff.at<float>(0);
-                float k2 = this->dist_coeff.at<float>(1);
-                float p1 = this->dist_coeff.at<float>(3);
-                float p2 = this->dist_coeff.at<float>(4);
-                u = u + u * (k1 * r2 + k2 * r4 /*+ k3 * r6 */) + (2 * p1 * u * v) + p2 * (r2 + 2 * u * u);
-                v = v + v * (k1 * r2 + k2 * r4 /*+ k3 * r6 */) + (2 * p2 * u * v) + p1 * (r2 + 2 * v * v);
-                image_point.x = u * this->fx() + this->cx();
-                image_point.y = v * this->fy() + this->cy();
+                u = u + u * (c.k1 * r2 + c.k2 * r4 /*+ k3 * r6 */) + (2 * c.p1 * u * v) + c.p2 * (r2 + 2 * u * u);
+                v = v + v * (c.k1 * r2 + c.k2 * r4 /*+ k3 * r6 */) + (2 * c.p2 * u * v) + c.p1 * (r2 + 2 * v * v);
             }
+            image_point.x = u * c.fx + v * c.skew + c.cx;
+            image_point.y = v * c.fy + c.cy;
         }
 #else
         cv::projectPoints(object_point_list, this->rvec, this->tvec, this->K, this->dist_coeff, image_point_list);
@@ -283,26 +266,17 @@ public:
     {
         /*** Mw -> Mc ***/
         /* Mc = [R t] * [M, 1] */
-        cv::Mat K = this->K;
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat Rt = (cv::Mat_<float>(3, 4) <<
-            R.at<float>(0), R.at<float>(1), R.at<float>(2), this->tx(),
-            R.at<float>(3), R.at<float>(4), R.at<float>(5), this->ty(),
-            R.at<float>(6), R.at<float>(7), R.at<float>(8), this->tz());
-
-        object_point_in_camera_list.resize(object_point_in_world_list.size());
+        const ProjectionParam c = CreateProjectionParam();
+        const int32_t num = static_cast<int32_t>(object_point_in_world_list.size());
+        object_point_in_camera_list.resize(num);
 
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-        for (int32_t i = 0; i < object_point_in_world_list.size(); i++) {
-            const auto& object_point_in_world = object_point_in_world_list[i];
+        for (int32_t i = 0; i < num; i++) {
+            const cv::Point3f object_point_in_world = object_point_in_world_list[i];    /* copy, so that input and output can be the same */
             auto& object_point_in_camera = object_point_in_camera_list[i];
-            cv::Mat Mw = (cv::Mat_<float>(4, 1) << object_point_in_world.x, object_point_in_world.y, object_point_in_world.z, 1);
-            cv::Mat Mc = Rt * Mw;
-            object_point_in_camera.x = Mc.at<float>(0);
-            object_point_in_camera.y = Mc.at<float>(1);
-            object_point_in_camera.z = Mc.at<float>(2);
+            Transform(c.R, c.t, object_point_in_world.x, object_point_in_world.y, object_point_in_world.z, object_point_in_camera.x, object_point_in_camera.y, object_point_in_camera.z);
         }
     }
 
@@ -312,26 +286,18 @@ public:
         /* Mc = [R t] * [Mw, 1] */
         /* -> [M, 1] = [R t]^1 * Mc <- Unable to get the inverse of [R t] because it's 4x3 */
         /* So, Mc = R * Mw + t */
-        /* -> Mw = R^1 * (Mc - t) */
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat R_inv;
-        cv::invert(R, R_inv);
-        cv::Mat t = this->tvec;
-
-
-        object_point_in_world_list.resize(object_point_in_camera_list.size());
+        /* -> Mw = R^1 * (Mc - t) = R^1 * Mc - R^1 * t */
+        const ProjectionParam c = CreateProjectionParam();
+        const int32_t num = static_cast<int32_t>(object_point_in_camera_list.size());
+        object_point_in_world_list.resize(num);
 
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-        for (int32_t i = 0; i < object_point_in_camera_list.size(); i++) {
-            const auto& object_point_in_camera = object_point_in_camera_list[i];
+        for (int32_t i = 0; i < num; i++) {
+            const cv::Point3f object_point_in_camera = object_point_in_camera_list[i];  /* copy, so that input and output can be the same */
             auto& object_point_in_world = object_point_in_world_list[i];
-            cv::Mat Mc = (cv::Mat_<float>(3, 1) << object_point_in_camera.x, object_point_in_camera.y, object_point_in_camera.z);
-            cv::Mat Mw = R_inv * (Mc - t);
-            object_point_in_world.x = Mw.at<float>(0);
-            object_point_in_world.y = Mw.at<float>(1);
-            object_point_in_world.z = Mw.at<float>(2);
+            Transform(c.R_inv, c.t_inv, object_point_in_camera.x, object_point_in_camera.y, object_point_in_camera.z, object_point_in_world.x, object_point_in_world.y, object_point_in_world.z);
         }
     }
 
@@ -349,118 +315,121 @@ public:
         /*   s * Rinv * Kinv * [x, y, 1] = M + R_inv * t */
         /*      where, M = (X, Y, Z), and we assume Y = 0(ground_plane) */
         /*      so , we can solve left[1] = R_inv * t[1](camera_height) */
+        /* Kinv * [x, y, 1] is the ray of the undistorted pixel */
 
         if (image_point_list.size() == 0) return;
 
-        cv::Mat K = this->K;
-        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
-        cv::Mat K_inv;
-        cv::invert(K, K_inv);
-        cv::Mat R_inv;
-        cv::invert(R, R_inv);
-        cv::Mat t = this->tvec;
+        const ProjectionParam c = CreateProjectionParam();
+        const int32_t num = static_cast<int32_t>(image_point_list.size());
+        object_point_list.resize(num);
 
         /*** Undistort image point ***/
-        std::vector<cv::Point2f> image_point_undistort;
-        if (this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0) {
-            image_point_undistort = image_point_list;
-        } else {
-            cv::undistortPoints(image_point_list, image_point_undistort, this->K, this->dist_coeff, this->K);    /* don't use K_new */
+        std::vector<cv::Point2f> ray_list;
+        if (c.is_distorted) {
+            cv::undistortPoints(image_point_list, ray_list, this->K, this->dist_coeff);    /* normalized coordinate */
         }
 
-        object_point_list.resize(image_point_list.size());
-        for (int32_t i = 0; i < object_point_list.size(); i++) {
-            const auto& image_point = image_point_list[i];
-            auto& object_point = object_point_list[i];
-
-            float x = image_point_undistort[i].x;
-            float y = image_point_undistort[i].y;
-            if (y < EstimateVanishmentY()) {
-                object_point.x = 999;
-                object_point.y = 999;
-                object_point.z = 999;
-                continue;
-            }
-
-            cv::Mat XY = (cv::Mat_<float>(3, 1) << x, y, 1);
-
-            /* calculate s */
-            cv::Mat LEFT_WO_S = R_inv * K_inv * XY;
-            cv::Mat RIGHT_WO_M = R_inv * t;         /* no need to add M because M[1] = 0 (ground plane)*/
-            float s = RIGHT_WO_M.at<float>(1) / LEFT_WO_S.at<float>(1);
-
-            /* calculate M */
-            cv::Mat TEMP = R_inv * (s * K_inv * XY - t);
-
-            object_point.x = TEMP.at<float>(0);
-            object_point.y = TEMP.at<float>(1);
-            object_point.z = TEMP.at<float>(2);
-            if (object_point.z < 0) object_point.z = 999;
+        const int32_t vanishment_y = EstimateVanishmentY();
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+        for (int32_t i = 0; i < num; i++) {
+            const cv::Point2f ray = c.is_distorted ? ray_list[i] : Pixel2Ray(c, image_point_list[i]);
+            ConvertRay2GroundPlane(c, ray, static_cast<float>(vanishment_y), object_point_list[i]);
         }
     }
 
-    void ConvertImage2Camera(std::vector<cv::Point2f>& image_point_list, const std::vector<float>& z_list, std::vector<cv::Point3f>& object_point_list)
+    void ConvertImage2Camera(const std::vector<cv::Point2f>& image_point_list, const std::vector<float>& z_list, std::vector<cv::Point3f>& object_point_list)
     {
         /*** Image -> Mc ***/
+        /* Mc = Zc * ray (ray = Kinv * [x, y, 1] of the undistorted pixel) */
+        const ProjectionParam c = CreateProjectionParam();
+        const cv::Point2f* ray_list = nullptr;
+        std::shared_ptr<const RayLut> ray_lut;
+        std::vector<cv::Point2f> ray_undistort_list;
         if (image_point_list.size() == 0) {
             /* Convert for all pixels on image, when image_point_list = empty */
             if (z_list.size() != this->width * this->height) {
                 printf("[ConvertImage2Camera] Invalid z_list size\n");
                 return;
             }
-            /* Generate the original image point mat */
-            /* todo: no need to generate every time */
-            for (int32_t y = 0; y < this->height; y++) {
-                for (int32_t x = 0; x < this->width; x++) {
-                    image_point_list.push_back(cv::Point2f(float(x), float(y)));
-                }
-            }
+            ray_lut = GetRayLut();
+            ray_list = ray_lut->ray_list.data();
         } else {
             /* Convert for the input pixels only */
             if (z_list.size() != image_point_list.size()) {
                 printf("[ConvertImage2Camera] Invalid z_list size\n");
                 return;
             }
+            if (c.is_distorted) {
+                cv::undistortPoints(image_point_list, ray_undistort_list, this->K, this->dist_coeff);    /* normalized coordinate */
+                ray_list = ray_undistort_list.data();
+            }
         }
 
-        /*** Undistort image point ***/
-        std::vector<cv::Point2f> image_point_undistort;
-        if (this->dist_coeff.empty() || this->dist_coeff.at<float>(0) == 0) {
-            image_point_undistort = image_point_list;   /* todo: redundant copy. I do this just because to make code simple */
-        } else {
-            cv::undistortPoints(image_point_list, image_point_undistort, this->K, this->dist_coeff, this->K);    /* don't use K_new */
-        }
-
-        object_point_list.resize(image_point_list.size());
+        const int32_t num = static_cast<int32_t>(z_list.size());
+        object_point_list.resize(num);
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-        for (int32_t i = 0; i < object_point_list.size(); i++) {
-            const auto& Zc = z_list[i];
+        for (int32_t i = 0; i < num; i++) {
+            const float Zc = z_list[i];
+            const cv::Point2f ray = ray_list ? ray_list[i] : Pixel2Ray(c, image_point_list[i]);
             auto& object_point = object_point_list[i];
-
-            float x = image_point_undistort[i].x;
-            float y = image_point_undistort[i].y;
-
-            float u = x - this->cx();
-            float v = y - this->cy();
-            float Xc = Zc * u / this->fx();
-            float Yc = Zc * v / this->fy();
-            object_point.x = Xc;
-            object_point.y = Yc;
+            object_point.x = Zc * ray.x;
+            object_point.y = Zc * ray.y;
             object_point.z = Zc;
         }
     }
 
-    void ConvertImage2World(std::vector<cv::Point2f>& image_point_list, const std::vector<float>& z_list, std::vector<cv::Point3f>& object_point_list)
+    void ConvertImage2World(const std::vector<cv::Point2f>& image_point_list, const std::vector<float>& z_list, std::vector<cv::Point3f>& object_point_list)
     {
         /*** Image -> Mw ***/
-        std::vector<cv::Point3f> object_point_in_camera_list;
-        ConvertImage2Camera(image_point_list, z_list, object_point_in_camera_list);
-        ConvertCamera2World(object_point_in_camera_list, object_point_list);
+        /* Convert in place to avoid a temporary point list */
+        ConvertImage2Camera(image_point_list, z_list, object_point_list);
+        ConvertCamera2World(object_point_list, object_point_list);
     }
 
 
+    /* Estimate the minimal image area which covers the area on the ground plane (x_min - x_max, z_near - z_far in world coordinate) */
+    /* Use this area as crop for models which only need road (e.g. lane detection, road segmentation) */
+    cv::Rect EstimateGroundRoi(float x_min, float x_max, float z_near, float z_far, int32_t num_sample_per_edge = 8)
+    {
+        /* Sample points along the edges (not only corners) because a straight line on the ground can be curved by distortion */
+        std::vector<cv::Point3f> object_point_list;
+        for (int32_t i = 0; i <= num_sample_per_edge; i++) {
+            float ratio = static_cast<float>(i) / num_sample_per_edge;
+            float x = x_min + (x_max - x_min) * ratio;
+            float z = z_near + (z_far - z_near) * ratio;
+            object_point_list.push_back(cv::Point3f(x, 0, z_near));
+            object_point_list.push_back(cv::Point3f(x, 0, z_far));
+            object_point_list.push_back(cv::Point3f(x_min, 0, z));
+            object_point_list.push_back(cv::Point3f(x_max, 0, z));
+        }
+        std::vector<cv::Point2f> image_point_list;
+        ConvertWorld2Image(object_point_list, image_point_list);
+
+        float left = static_cast<float>(this->width);
+        float right = 0;
+        float top = static_cast<float>(this->height);
+        float bottom = 0;
+        bool is_valid = false;
+        for (const auto& image_point : image_point_list) {
+            if (image_point.x == -1 && image_point.y == -1) continue;  /* behind the camera */
+            left = (std::min)(left, image_point.x);
+            right = (std::max)(right, image_point.x);
+            top = (std::min)(top, image_point.y);
+            bottom = (std::max)(bottom, image_point.y);
+            is_valid = true;
+        }
+        if (!is_valid) return cv::Rect(0, 0, this->width, this->height);
+
+        cv::Rect roi(cv::Point(static_cast<int32_t>(std::floor(left)), static_cast<int32_t>(std::floor(top))), cv::Point(static_cast<int32_t>(std::ceil(right)), static_cast<int32_t>(std::ceil(bottom))));
+        roi &= cv::Rect(0, 0, this->width, this->height);
+        if (roi.area() == 0) return cv::Rect(0, 0, this->width, this->height);
+        return roi;
+    }
+
     /* tan(theta) = delta / f */
     float EstimatePitch(float vanishment_y)
     {
@@ -555,6 +524,200 @@ public:
             object_point.z += z;
         }
     }
+
+private:
+    /*** Parameters for projection, unpacked from K, dist_coeff, rvec and tvec ***/
+    typedef struct ProjectionParam_ {
+        float fx, fy, cx, cy, skew;
+        bool is_distorted;
+        float k1, k2, p1, p2;
+        std::array<float, 9> R;         /* Mw -> Mc */
+        std::array<float, 3> t;
+        std::array<float, 9> R_inv;     /* Mc -> Mw */
+        std::array<float, 3> t_inv;     /* = -R_inv * t */
+    } ProjectionParam;
+
+    ProjectionParam CreateProjectionParam()
+    {
+        ProjectionParam c;
+        c.fx = this->fx();
+        c.fy = this->fy();
+        c.cx = this->cx();
+        c.cy = this->cy();
+        c.skew = this->K.at<float>(1);
+        c.is_distorted = !this->dist_coeff.empty() && this->dist_coeff.at<float>(0) != 0;
+        c.k1 = c.is_distorted ? this->dist_coeff.at<float>(0) : 0;
+        c.k2 = c.is_distorted ? this->dist_coeff.at<float>(1) : 0;
+        c.p1 = c.is_distorted ? this->dist_coeff.at<float>(3) : 0;
+        c.p2 = c.is_distorted ? this->dist_coeff.at<float>(4) : 0;
+
+        cv::Mat R = MakeRotationMat(Rad2Deg(this->rx()), Rad2Deg(this->ry()), Rad2Deg(this->rz()));
+        for (int32_t i = 0; i < 9; i++) c.R[i] = R.at<float>(i);
+        for (int32_t i = 0; i < 3; i++) c.t[i] = this->tvec.at<float>(i);
+        /* R is orthogonal, so R_inv = R^T */
+        for (int32_t y = 0; y < 3; y++) {
+            for (int32_t x = 0; x < 3; x++) c.R_inv[y * 3 + x] = c.R[x * 3 + y];
+        }
+        for (int32_t i = 0; i < 3; i++) {
+            c.t_inv[i] = -(c.R_inv[i * 3 + 0] * c.t[0] + c.R_inv[i * 3 + 1] * c.t[1] + c.R_inv[i * 3 + 2] * c.t[2]);
+        }
+        return c;
+    }
+
+    /*** Undistorted rays (Xc / Zc, Yc / Zc) of all pixels. index = y * width + x ***/
+    /* Built once, and re-built only when K, dist_coeff or image size are changed. Never modified after it's built */
+    typedef struct RayLut_ {
+        std::array<float, 9 + 5> intrinsic_param;   /* K, dist_coeff */
+        int32_t width;
+        int32_t height;
+        std::vector<cv::Point2f> ray_list;
+    } RayLut;
+    std::shared_ptr<const RayLut> ray_lut_;
+
+    std::shared_ptr<const RayLut> GetRayLut()
+    {
+        std::array<float, 9 + 5> intrinsic_param = {};
+        for (int32_t i = 0; i < 9; i++) intrinsic_param[i] = this->K.at<float>(i);
+        if (!this->dist_coeff.empty()) {
+            for (int32_t i = 0; i < 5; i++) intrinsic_param[9 + i] = this->dist_coeff.at<float>(i);
+        }
+
+        std::shared_ptr<const RayLut> ray_lut = std::atomic_load(&ray_lut_);
+        if (ray_lut && ray_lut->intrinsic_param == intrinsic_param && ray_lut->width == this->width && ray_lut->height == this->height) {
+            return ray_lut;
+        }
+
+        std::shared_ptr<RayLut> ray_lut_new = std::make_shared<RayLut>();
+        ray_lut_new->intrinsic_param = intrinsic_param;
+        ray_lut_new->width = this->width;
+        ray_lut_new->height = this->height;
+        ray_lut_new->ray_list.resize(this->width * this->height);
+        const ProjectionParam c = CreateProjectionParam();
+        if (c.is_distorted) {
+            std::vector<cv::Point2f> pixel_list(this->width * this->height);
+            for (int32_t y = 0; y < this->height; y++) {
+                for (int32_t x = 0; x < this->width; x++) {
+                    pixel_list[y * this->width + x] = cv::Point2f(static_cast<float>(x), static_cast<float>(y));
+                }
+            }
+            cv::undistortPoints(pixel_list, ray_lut_new->ray_list, this->K, this->dist_coeff);    /* normalized coordinate */
+        } else {
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+            for (int32_t y = 0; y < this->height; y++) {
+                for (int32_t x = 0; x < this->width; x++) {
+                    ray_lut_new->ray_list[y * this->width + x] = Pixel2Ray(c, cv::Point2f(static_cast<float>(x), static_cast<float>(y)));
+                }
+            }
+        }
+        ray_lut = ray_lut_new;
+        std::atomic_store(&ray_lut_, ray_lut);
+        return ray_lut;
+    }
+
+    /* dst = R * src + t */
+    static inline void Transform(const std::array<float, 9>& R, const std::array<float, 3>& t, float x, float y, float z, float& dst_x, float& dst_y, float& dst_z)
+    {
+        dst_x = R[0] * x + R[1] * y + R[2] * z + t[0];
+        dst_y = R[3] * x + R[4] * y + R[5] * z + t[1];
+        dst_z = R[6] * x + R[7] * y + R[8] * z + t[2];
+    }
+
+    /* Kinv * [x, y, 1] for a pixel without distortion */
+    static inline cv::Point2f Pixel2Ray(const ProjectionParam& c, const cv::Point2f& image_point)
+    {
+        float v = (image_point.y - c.cy) / c.fy;
+        float u = (image_point.x - c.cx - c.skew * v) / c.fx;
+        return cv::Point2f(u, v);
+    }
+
+    static inline void ConvertRay2GroundPlane(const ProjectionParam& c, const cv::Point2f& ray, float vanishment_y, cv::Point3f& object_point)
+    {
+        if (ray.y * c.fy + c.cy < vanishment_y) {
+            object_point.x = 999;
+            object_point.y = 999;
+            object_point.z = 999;
+            return;
+        }
+
+        /* calculate s */
+        float left_x, left_y, left_z;   /* R_inv * Kinv * [x, y, 1] */
+        Transform(c.R_inv, { 0, 0, 0 }, ray.x, ray.y, 1.0f, left_x, left_y, left_z);
+        /* R_inv * t = -t_inv. no need to add M because M[1] = 0 (ground plane) */
+        float s = -c.t_inv[1] / left_y;
+
+        /* calculate M = R_inv * (s * Kinv * [x, y, 1] - t) = s * left + t_inv */
+        object_point.x = s * left_x + c.t_inv[0];
+        object_point.y = s * left_y + c.t_inv[1];
+        object_point.z = s * left_z + c.t_inv[2];
+        if (object_point.z < 0) object_point.z = 999;
+    }
+};
+
+
+/***
+* Crop area of the road for lane / road models, estimated from a camera setup
+*   - default: dashcam (fov 80 deg, pitch 0 deg, 1.5 m height) and road of +-8 m width from 3 m to 50 m
+*   - aspect (width / height): the area is expanded to this aspect so that the model sees the road in the framing it was trained on. 0 = as estimated
+*   - estimated only when the image size changes
+* Usage:
+*   RoadAreaEstimator s_road_area_estimator;
+*   engine->Process(mat, result, s_road_area_estimator.Get(mat.size(), 2.0f));
+***/
+class RoadAreaEstimator {
+public:
+    RoadAreaEstimator(float fov_deg = 80.0f, float pitch_deg = 0.0f, float camera_height = 1.5f, float half_width = 8.0f, float distance_near = 3.0f, float distance_far = 50.0f)
+        : fov_deg_(fov_deg), pitch_deg_(pitch_deg), camera_height_(camera_height), half_width_(half_width), distance_near_(distance_near), distance_far_(distance_far), aspect_(0.0f)
+    {}
+
+    const cv::Rect& Get(const cv::Size& image_size, float aspect = 0.0f)
+    {
+        if (image_size != image_size_ || aspect != aspect_) {
+            image_size_ = image_size;
+            aspect_ = aspect;
+            road_area_ = Estimate(image_size.width, image_size.height, aspect);
+        }
+        return road_area_;
+    }
+
+private:
+    cv::Rect Estimate(int32_t width, int32_t height, float aspect) const
+    {
+        CameraModel camera;
+        camera.SetIntrinsic(width, height, FocalLength(width, fov_deg_));
+        camera.SetExtrinsic(
+            { pitch_deg_, 0.0f, 0.0f },    /* rvec [deg] */
+            { 0.0f, -camera_height_, 0.0f }, true);   /* tvec (Oc - Ow in world coordinate. X+= Right, Y+ = down, Z+ = far) */
+        cv::Rect roi = camera.EstimateGroundRoi(-half_width_, half_width_, distance_near_, distance_far_);
+        if (aspect <= 0) return roi;
+
+        /* Expand around the center (not shrink, not to lose the road), then shift into the image */
+        int32_t w = roi.width;
+        int32_t h = roi.height;
+        if (w > h * aspect) {
+            h = static_cast<int32_t>(w / aspect);
+        } else {
+            w = static_cast<int32_t>(h * aspect);
+        }
+        w = (std::min)(w, width);
+        h = (std::min)(h, height);
+        const int32_t x = (std::max)(0, (std::min)(roi.x + roi.width / 2 - w / 2, width - w));
+        const int32_t y = (std::max)(0, (std::min)(roi.y + roi.height / 2 - h / 2, height - h));
+        return cv::Rect(x, y, w, h);
+    }
+
+private:
+    float fov_deg_;
+    float pitch_deg_;
+    float camera_height_;
+    float half_width_;
+    float distance_near_;
+    float distance_far_;
+
+    cv::Size image_size_;
+    float aspect_;
+    cv::Rect road_area_;
 };
 
 #endif
@@ -25,9 +25,14 @@ limitations under the License.
 #include <algorithm>
 #include <chrono>
 #include <numeric>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/utils/filesystem.hpp>
 
 #include "common_helper.h"
 #include "common_helper_cv.h"
@@ -57,14 +62,41 @@ void CommonHelper::DrawText(cv::Mat& mat, const std::string& text, cv::Point pos
     }
 }
 
+/* Resize org(src_rect) into dst. Read from a pyramid level of FrameImageCache if org is the registered frame */
+static void ResizeRect(const cv::Mat& org, const cv::Rect& src_rect, cv::Mat& dst, int32_t interpolation_flag)
+{
+#ifdef CV_COLOR_IS_RGB
+    static constexpr bool kIsNativeRgb = true;
+#else
+    static constexpr bool kIsNativeRgb = false;
+#endif
+    auto& cache = CommonHelper::FrameImageCache::GetInstance();
+    const int32_t level = cache.SelectLevel(src_rect.size(), dst.size());
+    cv::Mat image;
+    if (level > 0 && cache.GetImage(org, level, kIsNativeRgb, image)) {
+        /* dst(x) = image((src_rect.x + (x + 0.5) * scale) / factor - 0.5), in pixel center coordinate */
+        const double scale_x = static_cast<double>(src_rect.width) / dst.cols;
+        const double scale_y = static_cast<double>(src_rect.height) / dst.rows;
+        const double factor_x = static_cast<double>(org.cols) / image.cols;
+        const double factor_y = static_cast<double>(org.rows) / image.rows;
+        cv::Mat trans = (cv::Mat_<double>(2, 3) <<
+            scale_x / factor_x, 0, (src_rect.x + 0.5 * scale_x) / factor_x - 0.5,
+            0, scale_y / factor_y, (src_rect.y + 0.5 * scale_y) / factor_y - 0.5);
+        cv::warpAffine(image, dst, trans, dst.size(), interpolation_flag | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+    } else {
+        cv::resize(org(src_rect), dst, dst.size(), 0, 0, interpolation_flag);
+    }
+}
+
 void CommonHelper::CropResizeCvt(const cv::Mat& org, cv::Mat& dst, int32_t& crop_x, int32_t& crop_y, int32_t& crop_w, int32_t& crop_h, bool is_rgb, int32_t crop_type, bool resize_by_linear)
 {
     const int32_t interpolation_flag = resize_by_linear ? cv::INTER_LINEAR : cv::INTER_NEAREST;
 
-    cv::Mat src = org(cv::Rect(crop_x, crop_y, crop_w, crop_h));
+    const cv::Rect src_rect(crop_x, crop_y, crop_w, crop_h);
+    cv::Mat src = org(src_rect);
 
     if (crop_type == kCropTypeStretch) {
-        cv::resize(src, dst, dst.size(), 0, 0, interpolation_flag);
+        ResizeRect(org, src_rect, dst, interpolation_flag);
     } else if (crop_type == kCropTypeCut) {
         float aspect_ratio_src = static_cast<float>(src.cols) / src.rows;
         float aspect_ratio_dst = static_cast<float>(dst.cols) / dst.rows;
@@ -76,8 +108,7 @@ void CommonHelper::CropResizeCvt(const cv::Mat& org, cv::Mat& dst, int32_t& crop
             target_rect.height = static_cast<int32_t>(src.cols / aspect_ratio_dst);
             target_rect.y = (src.rows - target_rect.height) / 2;
         }
-        cv::Mat target = src(target_rect);
-        cv::resize(target, dst, dst.size(), 0, 0, interpolation_flag);
+        ResizeRect(org, target_rect + src_rect.tl(), dst, interpolation_flag);
         crop_x += target_rect.x;
         crop_y += target_rect.y;
         crop_w = target_rect.width;
@@ -94,7 +125,7 @@ void CommonHelper::CropResizeCvt(const cv::Mat& org, cv::Mat& dst, int32_t& crop
             target_rect.x = (dst.cols - target_rect.width) / 2;
         }
         cv::Mat target = dst(target_rect);
-        cv::resize(src, target, target.size(), 0, 0, interpolation_flag);
+        ResizeRect(org, src_rect, target, interpolation_flag);
         crop_x -= target_rect.x * crop_w / target_rect.width;
         crop_y -= target_rect.y * crop_h / target_rect.height;
         crop_w = dst.cols * crop_w / target_rect.width;
@@ -113,6 +144,176 @@ void CommonHelper::CropResizeCvt(const cv::Mat& org, cv::Mat& dst, int32_t& crop
 
 }
 
+cv::Size CommonHelper::GetYuv420ImageSize(const Yuv420Image& yuv)
+{
+    if (yuv.rotation == 90 || yuv.rotation == 270) {
+        return cv::Size(yuv.height, yuv.width);
+    }
+    return cv::Size(yuv.width, yuv.height);
+}
+
+/* Sampling position along one axis of dst. The axis is the sensor x or y of the buffer, reversed for some rotations */
+typedef struct SampleTap_ {
+    int32_t offset_y[2];
+    int32_t offset_uv[2];
+    int32_t weight_y;       // of [1] (x128)
+    int32_t weight_uv;
+} SampleTap;
+
+static void CreateSampleTapList(std::vector<SampleTap>& tap_list, int32_t src_start, int32_t src_len, int32_t dst_len, int32_t sensor_len, int32_t stride_y, int32_t stride_uv, bool is_flip, bool is_linear)
+{
+    static constexpr float kWeightScale = 128.0f;
+    const int32_t sensor_len_uv = (sensor_len + 1) / 2;
+    tap_list.resize(dst_len);
+    for (int32_t d = 0; d < dst_len; d++) {
+        /* Center of the dst pixel in the sensor coordinate (luma pixel i covers [i, i + 1)) */
+        float s = src_start + (d + 0.5f) * src_len / dst_len;
+        if (is_flip) s = sensor_len - s;
+        SampleTap& tap = tap_list[d];
+        if (is_linear) {
+            /* Luma sample i is at i + 0.5, chroma sample j is at 2j + 1 */
+            const float s_y = s - 0.5f;
+            const float s_uv = s / 2 - 0.5f;
+            const int32_t i_y = static_cast<int32_t>(std::floor(s_y));
+            const int32_t i_uv = static_cast<int32_t>(std::floor(s_uv));
+            tap.weight_y = static_cast<int32_t>((s_y - i_y) * kWeightScale);
+            tap.weight_uv = static_cast<int32_t>((s_uv - i_uv) * kWeightScale);
+            for (int32_t k = 0; k < 2; k++) {
+                tap.offset_y[k] = (std::max)(0, (std::min)(sensor_len - 1, i_y + k)) * stride_y;
+                tap.offset_uv[k] = (std::max)(0, (std::min)(sensor_len_uv - 1, i_uv + k)) * stride_uv;
+            }
+        } else {
+            const int32_t i_y = (std::max)(0, (std::min)(sensor_len - 1, static_cast<int32_t>(s)));
+            tap.weight_y = 0;
+            tap.weight_uv = 0;
+            tap.offset_y[0] = tap.offset_y[1] = i_y * stride_y;
+            tap.offset_uv[0] = tap.offset_uv[1] = (i_y / 2) * stride_uv;
+        }
+    }
+}
+
+/* Integer arithmetic only (x1024). BT.601, the same as cv::COLOR_YUV2RGB_NV21 */
+static inline void ConvertYuvPixel(int32_t y, int32_t u, int32_t v, uint8_t* dst, int32_t index_r, int32_t index_b)
+{
+    const int32_t c = (std::max)(0, y - 16) * 1192 + 512;
+    const int32_t d = u - 128;
+    const int32_t e = v - 128;
+    const int32_t r = (c + 1634 * e) >> 10;
+    const int32_t g = (c - 833 * e - 400 * d) >> 10;
+    const int32_t b = (c + 2066 * d) >> 10;
+    dst[index_r] = static_cast<uint8_t>((std::max)(0, (std::min)(255, r)));
+    dst[1] = static_cast<uint8_t>((std::max)(0, (std::min)(255, g)));
+    dst[index_b] = static_cast<uint8_t>((std::max)(0, (std::min)(255, b)));
+}
+
+/* Bilinear interpolation of 4 samples with weights (x128) */
+static inline int32_t Interpolate(const uint8_t* row0, const uint8_t* row1, int32_t col0, int32_t col1, int32_t weight_col, int32_t weight_row)
+{
+    const int32_t v0 = row0[col0] * (128 - weight_col) + row0[col1] * weight_col;
+    const int32_t v1 = row1[col0] * (128 - weight_col) + row1[col1] * weight_col;
+    return (v0 * (128 - weight_row) + v1 * weight_row + (1 << 13)) >> 14;
+}
+
+/* Sample src_rect (in the rotated image) into dst_rect, and convert to RGB/BGR */
+static void SampleYuv420(const CommonHelper::Yuv420Image& yuv, const cv::Rect& src_rect, cv::Mat& dst, const cv::Rect& dst_rect, bool is_rgb, bool is_linear)
+{
+    if (src_rect.area() <= 0 || dst_rect.area() <= 0) return;
+
+    /* For any rotation, one of the sensor x/y depends only on the column of dst, and the other only on the row */
+    std::vector<SampleTap> col_tap_list;
+    std::vector<SampleTap> row_tap_list;
+    const bool is_col_sensor_x = (yuv.rotation != 90 && yuv.rotation != 270);
+    const bool is_col_flip = (yuv.rotation == 90 || yuv.rotation == 180);
+    const bool is_row_flip = (yuv.rotation == 180 || yuv.rotation == 270);
+    if (is_col_sensor_x) {
+        CreateSampleTapList(col_tap_list, src_rect.x, src_rect.width, dst_rect.width, yuv.width, 1, yuv.uv_pixel_stride, is_col_flip, is_linear);
+        CreateSampleTapList(row_tap_list, src_rect.y, src_rect.height, dst_rect.height, yuv.height, yuv.y_row_stride, yuv.uv_row_stride, is_row_flip, is_linear);
+    } else {
+        CreateSampleTapList(col_tap_list, src_rect.x, src_rect.width, dst_rect.width, yuv.height, yuv.y_row_stride, yuv.uv_row_stride, is_col_flip, is_linear);
+        CreateSampleTapList(row_tap_list, src_rect.y, src_rect.height, dst_rect.height, yuv.width, 1, yuv.uv_pixel_stride, is_row_flip, is_linear);
+    }
+
+    const int32_t index_r = is_rgb ? 0 : 2;
+    const int32_t index_b = is_rgb ? 2 : 0;
+#pragma omp parallel for
+    for (int32_t dy = 0; dy < dst_rect.height; dy++) {
+        const SampleTap& row_tap = row_tap_list[dy];
+        uint8_t* dst_row = dst.ptr<uint8_t>(dst_rect.y + dy) + dst_rect.x * 3;
+        if (is_linear) {
+            const uint8_t* y_row[2] = { yuv.y + row_tap.offset_y[0], yuv.y + row_tap.offset_y[1] };
+            const uint8_t* u_row[2] = { yuv.u + row_tap.offset_uv[0], yuv.u + row_tap.offset_uv[1] };
+            const uint8_t* v_row[2] = { yuv.v + row_tap.offset_uv[0], yuv.v + row_tap.offset_uv[1] };
+            for (int32_t dx = 0; dx < dst_rect.width; dx++) {
+                const SampleTap& col_tap = col_tap_list[dx];
+                const int32_t y = Interpolate(y_row[0], y_row[1], col_tap.offset_y[0], col_tap.offset_y[1], col_tap.weight_y, row_tap.weight_y);
+                const int32_t u = Interpolate(u_row[0], u_row[1], col_tap.offset_uv[0], col_tap.offset_uv[1], col_tap.weight_uv, row_tap.weight_uv);
+                const int32_t v = Interpolate(v_row[0], v_row[1], col_tap.offset_uv[0], col_tap.offset_uv[1], col_tap.weight_uv, row_tap.weight_uv);
+                ConvertYuvPixel(y, u, v, dst_row + dx * 3, index_r, index_b);
+            }
+        } else {
+            const uint8_t* y_row = yuv.y + row_tap.offset_y[0];
+            const uint8_t* u_row = yuv.u + row_tap.offset_uv[0];
+            const uint8_t* v_row = yuv.v + row_tap.offset_uv[0];
+            for (int32_t dx = 0; dx < dst_rect.width; dx++) {
+                const SampleTap& col_tap = col_tap_list[dx];
+                ConvertYuvPixel(y_row[col_tap.offset_y[0]], u_row[col_tap.offset_uv[0]], v_row[col_tap.offset_uv[0]], dst_row + dx * 3, index_r, index_b);
+            }
+        }
+    }
+}
+
+void CommonHelper::ConvertYuv420(const Yuv420Image& yuv, cv::Mat& dst)
+{
+    const cv::Size size = GetYuv420ImageSize(yuv);
+    dst.create(size, CV_8UC3);
+#ifdef CV_COLOR_IS_RGB
+    SampleYuv420(yuv, cv::Rect(0, 0, size.width, size.height), dst, cv::Rect(0, 0, size.width, size.height), true, false);
+#else
+    SampleYuv420(yuv, cv::Rect(0, 0, size.width, size.height), dst, cv::Rect(0, 0, size.width, size.height), false, false);
+#endif
+}
+
+void CommonHelper::CropResizeCvtYuv420(const Yuv420Image& yuv, cv::Mat& dst, int32_t& crop_x, int32_t& crop_y, int32_t& crop_w, int32_t& crop_h, bool is_rgb, int32_t crop_type, bool resize_by_linear)
+{
+    /* Same geometry as CropResizeCvt */
+    const cv::Rect src(crop_x, crop_y, crop_w, crop_h);
+    if (crop_type == kCropTypeStretch) {
+        SampleYuv420(yuv, src, dst, cv::Rect(0, 0, dst.cols, dst.rows), is_rgb, resize_by_linear);
+    } else if (crop_type == kCropTypeCut) {
+        float aspect_ratio_src = static_cast<float>(src.width) / src.height;
+        float aspect_ratio_dst = static_cast<float>(dst.cols) / dst.rows;
+        cv::Rect target_rect(0, 0, src.width, src.height);
+        if (aspect_ratio_src > aspect_ratio_dst) {
+            target_rect.width = static_cast<int32_t>(src.height * aspect_ratio_dst);
+            target_rect.x = (src.width - target_rect.width) / 2;
+        } else {
+            target_rect.height = static_cast<int32_t>(src.width / aspect_ratio_dst);
+            target_rect.y = (src.height - target_rect.height) / 2;
+        }
+        SampleYuv420(yuv, cv::Rect(src.x + target_rect.x, src.y + target_rect.y, target_rect.width, target_rect.height), dst, cv::Rect(0, 0, dst.cols, dst.rows), is_rgb, resize_by_linear);
+        crop_x += target_rect.x;
+        crop_y += target_rect.y;
+        crop_w = target_rect.width;
+        crop_h = target_rect.height;
+    } else {
+        float aspect_ratio_src = static_cast<float>(src.width) / src.height;
+        float aspect_ratio_dst = static_cast<float>(dst.cols) / dst.rows;
+        cv::Rect target_rect(0, 0, dst.cols, dst.rows);
+        if (aspect_ratio_src > aspect_ratio_dst) {
+            target_rect.height = static_cast<int32_t>(target_rect.width / aspect_ratio_src);
+            target_rect.y = (dst.rows - target_rect.height) / 2;
+        } else {
+            target_rect.width = static_cast<int32_t>(target_rect.height * aspect_ratio_src);
+            target_rect.x = (dst.cols - target_rect.width) / 2;
+        }
+        SampleYuv420(yuv, src, dst, target_rect, is_rgb, resize_by_linear);
+        crop_x -= target_rect.x * crop_w / target_rect.width;
+        crop_y -= target_rect.y * crop_h / target_rect.height;
+        crop_w = dst.cols * crop_w / target_rect.width;
+        crop_h = dst.rows * crop_h / target_rect.height;
+    }
+}
+
 /* https://github.com/JetsonHacksNano/CSI-Camera/blob/master/simple_camera.cpp */
 /* modified by iwatake2222 */
 std::string CommonHelper::CreateGStreamerPipeline(int capture_width, int capture_height, int display_width, int display_height, int framerate, int flip_method) {
@@ -195,6 +396,44 @@ bool CommonHelper::InputKeyCommand(cv::VideoCapture& cap)
     return ret_to_quit;
 }
 
+bool CommonHelper::InputKeyCommand(VideoSource& cap)
+{
+    bool ret_to_quit = false;
+    static bool is_pause = false;
+    bool is_process_one_frame = false;
+    do {
+        int32_t key = cv::waitKey(1) & 0xff;
+        switch (key) {
+        case 'q':
+            cap.Release();
+            ret_to_quit = true;
+            break;
+        case 'p':
+            is_pause = !is_pause;
+            break;
+        case '>':
+            if (is_pause) {
+                is_process_one_frame = true;
+            } else {
+                int32_t current_frame = static_cast<int32_t>(cap.Get(cv::CAP_PROP_POS_FRAMES));
+                cap.Set(cv::CAP_PROP_POS_FRAMES, current_frame + 100);
+            }
+            break;
+        case '<':
+            int32_t current_frame = static_cast<int32_t>(cap.Get(cv::CAP_PROP_POS_FRAMES));
+            if (is_pause) {
+                is_process_one_frame = true;
+                cap.Set(cv::CAP_PROP_POS_FRAMES, current_frame - 2);
+            } else {
+                cap.Set(cv::CAP_PROP_POS_FRAMES, current_frame - 100);
+            }
+            break;
+        }
+    } while (is_pause && !is_process_one_frame);
+
+    return ret_to_quit;
+}
+
 CommonHelper::NiceColorGenerator::NiceColorGenerator(int32_t num)
 {
     std::vector<uint8_t> seq_num(256);
@@ -244,4 +483,693 @@ cv::Mat CommonHelper::CombineMat1to3(int32_t rows, int32_t cols, float* data0, f
     const cv::Mat mat2 = cv::Mat(rows, cols, CV_32FC1, data2);
     return CombineMat1to3(mat0, mat1, mat2);
 
-}
\ No newline at end of file
+}
+
+
+CommonHelper::FrameImageCache& CommonHelper::FrameImageCache::GetInstance()
+{
+    static FrameImageCache s_instance;
+    return s_instance;
+}
+
+CommonHelper::FrameImageCache::FrameImageCache()
+{
+    Clear();
+}
+
+void CommonHelper::FrameImageCache::SetFrame(const cv::Mat& frame)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    frame_data_ = frame.data;
+    frame_size_ = frame.size();
+    frame_step_ = frame.step;
+    frame_type_ = frame.type();
+    for (auto& is_valid : is_valid_list_) is_valid.fill(false);
+}
+
+void CommonHelper::FrameImageCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    frame_data_ = nullptr;
+    frame_size_ = cv::Size();
+    frame_step_ = 0;
+    frame_type_ = 0;
+    for (auto& is_valid : is_valid_list_) is_valid.fill(false);
+    for (auto& image : image_list_) image.fill(cv::Mat());
+}
+
+bool CommonHelper::FrameImageCache::IsFrame(const cv::Mat& frame)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return IsFrameLocked(frame);
+}
+
+bool CommonHelper::FrameImageCache::IsFrameLocked(const cv::Mat& frame) const
+{
+    return frame_data_ != nullptr && frame.data == frame_data_ && frame.size() == frame_size_ && frame.step == frame_step_ && frame.type() == frame_type_;
+}
+
+bool CommonHelper::FrameImageCache::GetImage(const cv::Mat& frame, int32_t level, bool is_rgb, cv::Mat& image)
+{
+    if (level < 0 || level >= kLevelNum) return false;
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!IsFrameLocked(frame)) return false;
+    const int32_t color = is_rgb ? 1 : 0;
+    CreateImageLocked(frame, level, color);
+#ifdef CV_COLOR_IS_RGB
+    const bool is_frame_itself = (level == 0 && is_rgb);
+#else
+    const bool is_frame_itself = (level == 0 && !is_rgb);
+#endif
+    image = is_frame_itself ? frame : image_list_[level][color];
+    return true;
+}
+
+int32_t CommonHelper::FrameImageCache::SelectLevel(const cv::Size& src_size, const cv::Size& dst_size) const
+{
+    if (dst_size.width <= 0 || dst_size.height <= 0) return 0;
+    float scale = (std::min)(static_cast<float>(src_size.width) / dst_size.width, static_cast<float>(src_size.height) / dst_size.height);
+    int32_t level = 0;
+    while (level + 1 < kLevelNum && scale >= 2.0f) {
+        scale /= 2.0f;
+        level++;
+    }
+    return level;
+}
+
+void CommonHelper::FrameImageCache::CreateImageLocked(const cv::Mat& frame, int32_t level, int32_t color)
+{
+#ifdef CV_COLOR_IS_RGB
+    const int32_t color_native = 1;
+#else
+    const int32_t color_native = 0;
+#endif
+    if (is_valid_list_[level][color]) return;
+    if (color == color_native) {
+        if (level == 0) return;     /* the frame itself */
+        CreateImageLocked(frame, level - 1, color_native);
+        const cv::Mat& upper = (level == 1) ? frame : image_list_[level - 1][color_native];
+        cv::resize(upper, image_list_[level][color], cv::Size((std::max)(1, upper.cols / 2), (std::max)(1, upper.rows / 2)), 0, 0, cv::INTER_AREA);
+    } else {
+        CreateImageLocked(frame, level, color_native);
+        const cv::Mat& native = (level == 0) ? frame : image_list_[level][color_native];
+        cv::cvtColor(native, image_list_[level][color], cv::COLOR_BGR2RGB);   /* swap R and B */
+    }
+    is_valid_list_[level][color] = true;
+}
+
+
+static constexpr int32_t kMotionGateCellSize = 8;
+
+CommonHelper::MotionGate::MotionGate(int32_t analysis_width, int32_t threshold_diff, float threshold_cell_ratio, float threshold_region_ratio, int32_t max_skip_frame, float learning_rate)
+{
+    analysis_width_ = (std::max)(kMotionGateCellSize, analysis_width);
+    threshold_diff_ = threshold_diff;
+    threshold_cell_ratio_ = threshold_cell_ratio;
+    threshold_region_ratio_ = threshold_region_ratio;
+    max_skip_frame_ = (std::max)(1, max_skip_frame);
+    learning_rate_ = learning_rate;
+    Reset();
+}
+
+void CommonHelper::MotionGate::Reset()
+{
+    frame_size_ = cv::Size();
+    background_.release();
+    motion_rect_ = cv::Rect();
+    motion_ratio_ = 0.0f;
+    frame_cnt_from_full_ = 0;
+    frame_num_ = 0;
+    skipped_frame_num_ = 0;
+}
+
+void CommonHelper::MotionGate::CreateGray(const cv::Mat& frame, cv::Mat& gray)
+{
+    /* Resize first, then convert color, to reduce calculation */
+    cv::Mat small;
+    const int32_t width = (std::min)(analysis_width_, frame.cols);
+    const int32_t height = (std::max)(1, frame.rows * width / frame.cols);
+    cv::resize(frame, small, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+    if (small.channels() == 3) {
+        cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+    } else if (small.channels() == 4) {
+        cv::cvtColor(small, gray, cv::COLOR_BGRA2GRAY);
+    } else {
+        gray = small;
+    }
+}
+
+CommonHelper::MotionGate::Gate CommonHelper::MotionGate::Check(const cv::Mat& frame)
+{
+    frame_num_++;
+    CreateGray(frame, gray_);
+    if (frame.size() != frame_size_ || background_.empty()) {
+        frame_size_ = frame.size();
+        gray_.convertTo(background_, CV_32F);
+        motion_rect_ = cv::Rect(0, 0, frame_size_.width, frame_size_.height);
+        motion_ratio_ = 1.0f;
+        frame_cnt_from_full_ = 0;
+        return kGateFull;
+    }
+
+    /* Changed pixels against the background (0 / 1), and the number of them in each cell with the integral image */
+    background_.convertTo(background_u8_, CV_8U);
+    cv::absdiff(gray_, background_u8_, mask_);
+    cv::threshold(mask_, mask_, threshold_diff_, 1, cv::THRESH_BINARY);
+    cv::integral(mask_, integral_, CV_32S);
+
+    const int32_t cell_num_x = (gray_.cols + kMotionGateCellSize - 1) / kMotionGateCellSize;
+    const int32_t cell_num_y = (gray_.rows + kMotionGateCellSize - 1) / kMotionGateCellSize;
+    int32_t moving_cell_num = 0;
+    int32_t moving_x0 = gray_.cols;
+    int32_t moving_y0 = gray_.rows;
+    int32_t moving_x1 = 0;
+    int32_t moving_y1 = 0;
+    for (int32_t cell_y = 0; cell_y < cell_num_y; cell_y++) {
+        const int32_t y0 = cell_y * kMotionGateCellSize;
+        const int32_t y1 = (std::min)(y0 + kMotionGateCellSize, gray_.rows);
+        const int32_t* integral_y0 = integral_.ptr<int32_t>(y0);
+        const int32_t* integral_y1 = integral_.ptr<int32_t>(y1);
+        for (int32_t cell_x = 0; cell_x < cell_num_x; cell_x++) {
+            const int32_t x0 = cell_x * kMotionGateCellSize;
+            const int32_t x1 = (std::min)(x0 + kMotionGateCellSize, gray_.cols);
+            const int32_t changed_num = integral_y1[x1] - integral_y1[x0] - integral_y0[x1] + integral_y0[x0];
+            if (changed_num > threshold_cell_ratio_ * (x1 - x0) * (y1 - y0)) {
+                moving_cell_num++;
+                moving_x0 = (std::min)(moving_x0, x0);
+                moving_y0 = (std::min)(moving_y0, y0);
+                moving_x1 = (std::max)(moving_x1, x1);
+                moving_y1 = (std::max)(moving_y1, y1);
+            }
+        }
+    }
+    motion_ratio_ = static_cast<float>(moving_cell_num) / (cell_num_x * cell_num_y);
+
+    /* Background is updated slowly, so that an object which stops becomes background */
+    cv::accumulateWeighted(gray_, background_, learning_rate_);
+
+    Gate gate = kGateFull;
+    frame_cnt_from_full_++;
+    if (frame_cnt_from_full_ < max_skip_frame_) {
+        if (moving_cell_num == 0) {
+            gate = kGateSkip;
+        } else {
+            /* Expand by a cell, and scale to the frame */
+            const float scale = static_cast<float>(frame_size_.width) / gray_.cols;
+            moving_x0 = static_cast<int32_t>((std::max)(0, moving_x0 - kMotionGateCellSize) * scale);
+            moving_y0 = static_cast<int32_t>((std::max)(0, moving_y0 - kMotionGateCellSize) * scale);
+            moving_x1 = (std::min)(frame_size_.width, static_cast<int32_t>((moving_x1 + kMotionGateCellSize) * scale));
+            moving_y1 = (std::min)(frame_size_.height, static_cast<int32_t>((moving_y1 + kMotionGateCellSize) * scale));
+            motion_rect_ = cv::Rect(moving_x0, moving_y0, moving_x1 - moving_x0, moving_y1 - moving_y0);
+            if (motion_rect_.area() < threshold_region_ratio_ * frame_size_.area()) gate = kGateRegion;
+        }
+    }
+
+    if (gate == kGateFull) {
+        motion_rect_ = cv::Rect(0, 0, frame_size_.width, frame_size_.height);
+        frame_cnt_from_full_ = 0;
+    } else if (gate == kGateSkip) {
+        motion_rect_ = cv::Rect();
+        skipped_frame_num_++;
+    }
+    return gate;
+}
+
+static bool IsVideoFileName(const std::string& name)
+{
+    return name.find(".mp4") != std::string::npos || name.find(".avi") != std::string::npos || name.find(".webm") != std::string::npos;
+}
+
+static bool IsImageFileName(const std::string& name)
+{
+    return name.find(".jpg") != std::string::npos || name.find(".png") != std::string::npos || name.find(".bmp") != std::string::npos;
+}
+
+CommonHelper::VideoSource::VideoSource()
+    : type_(kTypeNone), mode_(kModeLossless), slot_in_use_(-1), frame_index_in_use_(-1), is_running_(false), is_end_(false), next_frame_index_(0)
+{
+}
+
+CommonHelper::VideoSource::~VideoSource()
+{
+    Release();
+}
+
+bool CommonHelper::VideoSource::Open(const std::string& input_name, int32_t width, int32_t height, Mode mode, int32_t pool_size)
+{
+    Release();
+
+    if (input_name.find('*') != std::string::npos || cv::utils::fs::isDirectory(input_name)) {
+        std::vector<cv::String> file_list;
+        cv::glob(input_name, file_list, false);     /* sorted */
+        std::vector<std::string> image_list;
+        for (const auto& file : file_list) {
+            if (IsImageFileName(file)) image_list.push_back(file);
+        }
+        if (image_list.empty()) {
+            printf("Invalid input source: %s\n", input_name.c_str());
+            return false;
+        }
+        return Open(image_list, mode, pool_size);
+    }
+
+    if (!FindSourceImage(input_name, cap_, width, height)) {
+        return false;
+    }
+    if (cap_.isOpened()) {
+        type_ = kTypeVideo;
+        if (mode == kModeAuto) {
+            mode_ = IsVideoFileName(input_name) ? kModeLossless : kModeLatest;
+        } else {
+            mode_ = mode;
+        }
+        image_size_ = cv::Size(static_cast<int32_t>(cap_.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int32_t>(cap_.get(cv::CAP_PROP_FRAME_HEIGHT)));
+        Start(pool_size);
+    } else {
+        /* still image is decoded only once, and copied into the pool for each Read */
+        type_ = kTypeImage;
+        image_org_ = cv::imread(input_name);
+        image_size_ = image_org_.size();
+        pool_.resize(1);
+    }
+    return true;
+}
+
+bool CommonHelper::VideoSource::Open(const std::vector<std::string>& image_list, Mode mode, int32_t pool_size)
+{
+    Release();
+
+    if (image_list.empty()) return false;
+    cv::Mat image = cv::imread(image_list[0]);
+    if (image.empty()) {
+        printf("Invalid input source: %s\n", image_list[0].c_str());
+        return false;
+    }
+    type_ = kTypeImageList;
+    mode_ = (mode == kModeAuto) ? kModeLossless : mode;
+    image_list_ = image_list;
+    image_size_ = image.size();
+    Start(pool_size);
+    return true;
+}
+
+void CommonHelper::VideoSource::Release()
+{
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            is_running_ = false;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+    if (cap_.isOpened()) cap_.release();
+    type_ = kTypeNone;
+    image_list_.clear();
+    image_org_.release();
+    pool_.clear();
+    pool_frame_index_.clear();
+    pool_file_buffer_.clear();
+    free_list_.clear();
+    ready_list_.clear();
+    slot_in_use_ = -1;
+    frame_index_in_use_ = -1;
+}
+
+void CommonHelper::VideoSource::Start(int32_t pool_size)
+{
+    pool_size = (std::max)(pool_size, 3);     /* in use + ready + decoding */
+    pool_.assign(pool_size, cv::Mat());
+    pool_frame_index_.assign(pool_size, -1);
+    pool_file_buffer_.assign(pool_size, std::vector<uint8_t>());
+    free_list_.clear();
+    ready_list_.clear();
+    for (int32_t i = 0; i < pool_size; i++) free_list_.push_back(i);
+    slot_in_use_ = -1;
+    frame_index_in_use_ = -1;
+    next_frame_index_ = 0;
+    is_end_ = false;
+    is_running_ = true;
+    thread_ = std::thread(&VideoSource::ThreadDecode, this);
+}
+
+bool CommonHelper::VideoSource::Read(cv::Mat& mat)
+{
+    mat.release();      /* so that the buffer can be recycled */
+    if (type_ == kTypeImage) {
+        PrepareSlot(0);
+        image_org_.copyTo(pool_[0]);
+        mat = pool_[0];
+        return true;
+    }
+    if (type_ == kTypeNone) return false;
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (slot_in_use_ >= 0) {
+        free_list_.push_back(slot_in_use_);
+        slot_in_use_ = -1;
+    }
+    cv_.notify_all();
+    cv_.wait(lock, [this] { return !ready_list_.empty() || is_end_; });
+    if (ready_list_.empty()) return false;
+    slot_in_use_ = ready_list_.front();
+    ready_list_.pop_front();
+    frame_index_in_use_ = pool_frame_index_[slot_in_use_];
+    mat = pool_[slot_in_use_];
+    lock.unlock();
+    cv_.notify_all();
+    return true;
+}
+
+double CommonHelper::VideoSource::Get(int32_t prop_id)
+{
+    switch (prop_id) {
+    case cv::CAP_PROP_FRAME_WIDTH:
+        return image_size_.width;
+    case cv::CAP_PROP_FRAME_HEIGHT:
+        return image_size_.height;
+    case cv::CAP_PROP_POS_FRAMES:
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return frame_index_in_use_ + 1;
+    }
+    default:
+        break;
+    }
+    if (type_ == kTypeVideo) {
+        std::lock_guard<std::mutex> lock_source(mtx_source_);
+        return cap_.get(prop_id);
+    } else if (type_ == kTypeImageList && prop_id == cv::CAP_PROP_FRAME_COUNT) {
+        return static_cast<double>(image_list_.size());
+    }
+    return 0;
+}
+
+bool CommonHelper::VideoSource::Set(int32_t prop_id, double value)
+{
+    if (!IsVideo()) return false;
+    std::lock_guard<std::mutex> lock_source(mtx_source_);
+    if (prop_id != cv::CAP_PROP_POS_FRAMES) {
+        return (type_ == kTypeVideo) ? cap_.set(prop_id, value) : false;
+    }
+
+    /* seek, and discard frames decoded from the previous position */
+    int32_t frame_index = (std::max)(0, static_cast<int32_t>(value));
+    if (type_ == kTypeVideo) {
+        if (!cap_.set(cv::CAP_PROP_POS_FRAMES, frame_index)) return false;
+    } else {
+        frame_index = (std::min)(frame_index, static_cast<int32_t>(image_list_.size()));
+    }
+    next_frame_index_ = frame_index;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        while (!ready_list_.empty()) {
+            free_list_.push_back(ready_list_.front());
+            ready_list_.pop_front();
+        }
+        is_end_ = false;
+    }
+    cv_.notify_all();
+    return true;
+}
+
+void CommonHelper::VideoSource::PrepareSlot(int32_t slot)
+{
+    /* the buffer is still referred by the caller (e.g. kept for rendering). Don't overwrite it, but allocate a new one */
+    cv::Mat& mat = pool_[slot];
+    if (mat.u && mat.u->refcount > 1) mat.release();
+}
+
+void CommonHelper::VideoSource::ThreadDecode()
+{
+    std::vector<int32_t> slot_list;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this] { return !is_running_ || (!is_end_ && (!free_list_.empty() || (mode_ == kModeLatest && !ready_list_.empty()))); });
+            if (!is_running_) break;
+            slot_list.clear();
+            if (free_list_.empty()) {
+                /* kModeLatest: overwrite the oldest frame which is not read yet */
+                slot_list.push_back(ready_list_.front());
+                ready_list_.pop_front();
+            } else if (type_ == kTypeImageList) {
+                /* take all free slots to decode images in parallel */
+                while (!free_list_.empty()) {
+                    slot_list.push_back(free_list_.front());
+                    free_list_.pop_front();
+                }
+            } else {
+                slot_list.push_back(free_list_.front());
+                free_list_.pop_front();
+            }
+        }
+
+        /* Set (seek) waits until frames from the current position are queued */
+        std::lock_guard<std::mutex> lock_source(mtx_source_);
+        int32_t decoded_num = (type_ == kTypeVideo) ? DecodeVideo(slot_list) : DecodeImageList(slot_list);
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            for (int32_t i = 0; i < static_cast<int32_t>(slot_list.size()); i++) {
+                if (i < decoded_num) {
+                    if (mode_ == kModeLatest) {
+                        while (!ready_list_.empty()) {
+                            free_list_.push_back(ready_list_.front());
+                            ready_list_.pop_front();
+                        }
+                    }
+                    ready_list_.push_back(slot_list[i]);
+                } else {
+                    free_list_.push_back(slot_list[i]);
+                }
+            }
+            if (decoded_num < static_cast<int32_t>(slot_list.size())) is_end_ = true;
+        }
+        cv_.notify_all();
+    }
+}
+
+int32_t CommonHelper::VideoSource::DecodeVideo(const std::vector<int32_t>& slot_list)
+{
+    int32_t decoded_num = 0;
+    for (int32_t slot : slot_list) {
+        PrepareSlot(slot);
+        if (!cap_.read(pool_[slot]) || pool_[slot].empty()) break;     /* the same buffer is reused if size is the same */
+        pool_frame_index_[slot] = next_frame_index_++;
+        decoded_num++;
+    }
+    return decoded_num;
+}
+
+int32_t CommonHelper::VideoSource::DecodeImageList(const std::vector<int32_t>& slot_list)
+{
+    const int32_t image_num = (std::max)(0, (std::min)(static_cast<int32_t>(slot_list.size()), static_cast<int32_t>(image_list_.size()) - next_frame_index_));
+    const int32_t frame_index_start = next_frame_index_;
+#pragma omp parallel for
+    for (int32_t i = 0; i < image_num; i++) {
+        const int32_t slot = slot_list[i];
+        const std::string& filename = image_list_[frame_index_start + i];
+        std::vector<uint8_t>& file_buffer = pool_file_buffer_[slot];
+        std::ifstream ifs(filename, std::ios::binary);
+        if (ifs) {
+            ifs.seekg(0, std::ios::end);
+            file_buffer.resize(static_cast<size_t>(ifs.tellg()));
+            ifs.seekg(0, std::ios::beg);
+            ifs.read(reinterpret_cast<char*>(file_buffer.data()), file_buffer.size());
+        } else {
+            file_buffer.clear();
+        }
+        PrepareSlot(slot);
+        if (file_buffer.empty()) {
+            pool_[slot].release();
+        } else {
+            cv::imdecode(file_buffer, cv::IMREAD_COLOR, &pool_[slot]);     /* the same buffer is reused if size is the same */
+        }
+    }
+
+    /* stop at an invalid image */
+    int32_t decoded_num = 0;
+    for (int32_t i = 0; i < image_num; i++) {
+        const int32_t slot = slot_list[i];
+        if (pool_[slot].empty()) {
+            printf("Invalid input source: %s\n", image_list_[frame_index_start + i].c_str());
+            break;
+        }
+        pool_frame_index_[slot] = next_frame_index_++;
+        decoded_num++;
+    }
+    return decoded_num;
+}
+
+
+CommonHelper::VideoSink::VideoSink()
+    : type_(kTypeNone), is_blocking_(false), is_running_(false), written_num_(0), dropped_num_(0)
+{
+}
+
+CommonHelper::VideoSink::~VideoSink()
+{
+    Release();
+}
+
+bool CommonHelper::VideoSink::Open(const std::string& filename, double fps, const cv::Size& size, int32_t queue_size, bool is_blocking)
+{
+    Release();
+    writer_ = cv::VideoWriter(filename, cv::VideoWriter::fourcc('M', 'P', '4', 'V'), fps, size);
+    if (!writer_.isOpened()) {
+        printf("Unable to open video writer: %s\n", filename.c_str());
+        return false;
+    }
+    type_ = kTypeVideo;
+    filename_ = filename;
+    Start(queue_size, is_blocking);
+    return true;
+}
+
+bool CommonHelper::VideoSink::Open(const std::string& filename, VideoSource& source, const cv::Size& size, int32_t queue_size)
+{
+    const double fps = (std::max)(10.0, source.Get(cv::CAP_PROP_FPS));
+    cv::Size frame_size = size;
+    if (frame_size.area() <= 0) {
+        frame_size = cv::Size(static_cast<int32_t>(source.Get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int32_t>(source.Get(cv::CAP_PROP_FRAME_HEIGHT)));
+    }
+    /* Frames from a file are not lost on the way in, so don't lose them on the way out */
+    return Open(filename, fps, frame_size, queue_size, !source.IsLive());
+}
+
+bool CommonHelper::VideoSink::OpenResult(const std::string& filename, int32_t queue_size, bool is_blocking)
+{
+    Release();
+    if (result_writer_.Open(filename) != TensorTraceWriter::kRetOk) {
+        printf("Unable to open result writer: %s\n", filename.c_str());
+        return false;
+    }
+    type_ = kTypeResult;
+    filename_ = filename;
+    Start(queue_size, is_blocking);
+    return true;
+}
+
+void CommonHelper::VideoSink::Release()
+{
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            is_running_ = false;
+        }
+        cv_.notify_all();
+        thread_.join();     /* frames in the queue are written before the thread exits */
+    }
+    if (type_ != kTypeNone) {
+        printf("Recorded %s: %d frames (%d dropped)\n", filename_.c_str(), written_num_, dropped_num_);
+    }
+    if (writer_.isOpened()) writer_.release();
+    result_writer_.Close();
+    type_ = kTypeNone;
+    pool_.clear();
+    free_list_.clear();
+    ready_list_.clear();
+}
+
+void CommonHelper::VideoSink::Start(int32_t queue_size, bool is_blocking)
+{
+    queue_size = (std::max)(queue_size, 1);
+    is_blocking_ = is_blocking;
+    pool_.assign(queue_size, Slot());
+    free_list_.clear();
+    ready_list_.clear();
+    for (int32_t i = 0; i < queue_size; i++) free_list_.push_back(i);
+    written_num_ = 0;
+    dropped_num_ = 0;
+    is_running_ = true;
+    thread_ = std::thread(&VideoSink::ThreadWrite, this);
+}
+
+int32_t CommonHelper::VideoSink::AcquireSlot()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (is_blocking_) {
+        cv_.wait(lock, [this] { return !free_list_.empty(); });
+    } else if (free_list_.empty()) {
+        dropped_num_++;
+        return -1;
+    }
+    int32_t slot = free_list_.front();
+    free_list_.pop_front();
+    return slot;
+}
+
+void CommonHelper::VideoSink::Submit(int32_t slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ready_list_.push_back(slot);
+    }
+    cv_.notify_all();
+}
+
+bool CommonHelper::VideoSink::Write(const cv::Mat& frame)
+{
+    if (type_ != kTypeVideo || frame.empty()) return false;
+    int32_t slot = AcquireSlot();
+    if (slot < 0) return false;
+    frame.copyTo(pool_[slot].frame);   /* the same buffer is reused if size is the same */
+    Submit(slot);
+    return true;
+}
+
+bool CommonHelper::VideoSink::WriteResult(const TensorTrace::Frame& frame)
+{
+    if (type_ != kTypeResult) return false;
+    int32_t slot = AcquireSlot();
+    if (slot < 0) return false;
+    Slot& s = pool_[slot];
+    s.result = frame;
+    s.result_data_list.resize(frame.tensor_list.size());
+    for (size_t i = 0; i < frame.tensor_list.size(); i++) {
+        const uint8_t* data = static_cast<const uint8_t*>(frame.tensor_list[i].data);
+        s.result_data_list[i].assign(data, data + frame.tensor_list[i].data_size);
+        s.result.tensor_list[i].data = s.result_data_list[i].data();
+    }
+    Submit(slot);
+    return true;
+}
+
+int32_t CommonHelper::VideoSink::GetWrittenNum()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return written_num_;
+}
+
+int32_t CommonHelper::VideoSink::GetDroppedNum()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return dropped_num_;
+}
+
+void CommonHelper::VideoSink::ThreadWrite()
+{
+    while (true) {
+        int32_t slot = -1;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this] { return !is_running_ || !ready_list_.empty(); });
+            if (ready_list_.empty()) break;     /* stopped and flushed */
+            slot = ready_list_.front();
+            ready_list_.pop_front();
+        }
+
+        if (type_ == kTypeVideo) {
+            writer_.write(pool_[slot].frame);
+        } else {
+            result_writer_.Write(pool_[slot].result);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            free_list_.push_back(slot);
+            written_num_++;
+        }
+        cv_.notify_all();
+    }
+}
@@ -20,10 +20,18 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include <array>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
 
+/* for My modules */
+#include "bounding_box.h"
+#include "tensor_trace.h"
+
 
 namespace CommonHelper
 {
@@ -37,9 +45,30 @@ enum {
 cv::Scalar CreateCvColor(int32_t b, int32_t g, int32_t r);
 void DrawText(cv::Mat& mat, const std::string& text, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true);
 void CropResizeCvt(const cv::Mat& org, cv::Mat& dst, int32_t& crop_x, int32_t& crop_y, int32_t& crop_w, int32_t& crop_h, bool is_rgb = true, int32_t crop_type = kCropTypeStretch, bool resize_by_linear = true);
+
+/* YUV 4:2:0 image in the camera buffer (Android YUV_420_888, I420, NV12, NV21). Not copied */
+typedef struct Yuv420Image_ {
+    const uint8_t* y;
+    const uint8_t* u;
+    const uint8_t* v;
+    int32_t width;              // size of the buffer (before rotation)
+    int32_t height;
+    int32_t y_row_stride;
+    int32_t uv_row_stride;
+    int32_t uv_pixel_stride;    // 1: planar (I420), 2: semi planar (NV12, NV21)
+    int32_t rotation;           // clockwise [deg] (0, 90, 180, 270). applied before crop
+    Yuv420Image_() : y(nullptr), u(nullptr), v(nullptr), width(0), height(0), y_row_stride(0), uv_row_stride(0), uv_pixel_stride(1), rotation(0) {}
+} Yuv420Image;
+cv::Size GetYuv420ImageSize(const Yuv420Image& yuv);    /* after rotation */
+/* Convert the whole image (for display, nearest neighbor). The color order is the same as other cv::Mat (BGR, or RGB if CV_COLOR_IS_RGB) */
+void ConvertYuv420(const Yuv420Image& yuv, cv::Mat& dst);
+/* The same as CropResizeCvt, but color conversion, rotation, crop and resize are done in one pass from YUV. crop is in the rotated image */
+void CropResizeCvtYuv420(const Yuv420Image& yuv, cv::Mat& dst, int32_t& crop_x, int32_t& crop_y, int32_t& crop_w, int32_t& crop_h, bool is_rgb = true, int32_t crop_type = kCropTypeStretch, bool resize_by_linear = true);
 std::string CreateGStreamerPipeline(int capture_width, int capture_height, int display_width, int display_height, int framerate, int flip_method);
 bool FindSourceImage(const std::string& input_name, cv::VideoCapture& cap, int32_t width = 640, int32_t height = 480);
 bool InputKeyCommand(cv::VideoCapture& cap);
+class VideoSource;
+bool InputKeyCommand(VideoSource& cap);
 cv::Mat CombineMat1to3(const cv::Mat& mat0, const cv::Mat& mat1, const cv::Mat& mat2);
 cv::Mat CombineMat1to3(int32_t rows, int32_t cols, float* data0, float* data1, float* data2);
 
@@ -58,6 +87,278 @@ private:
 };
 
 
+/***
+* Per-frame image cache shared by the engines of a cascaded pipeline (palm + landmark, face detection + facemesh, detection + re-id, etc.)
+*   - downscaled pyramid (1/2, 1/4, ...) and color converted images of the frame are created at the first request, and reused in the frame
+*   - images are keyed by (level, color order), so the large frame is scaled / converted only once per frame
+*   - CropResizeCvt serves a request from the smallest level which is still larger than dst, if org is the registered frame
+*   - the frame is identified by its buffer (not referenced, so VideoSource can recycle it). SetFrame must be called for every frame
+* Usage:
+*   FrameImageCache::GetInstance().SetFrame(mat);  // ImageProcessor::Process, before the engines
+*   CropResizeCvt(mat, img_src, ...);              // engines: no change
+*   FrameImageCache::GetInstance().GetImage(mat, 1, true, image);   // half size RGB image
+***/
+class FrameImageCache
+{
+public:
+    static FrameImageCache& GetInstance();
+
+    /* Call at the beginning of each frame. Images of the previous frame are invalidated (buffers are reused) */
+    void SetFrame(const cv::Mat& frame);
+    void Clear();
+    bool IsFrame(const cv::Mat& frame);
+
+    /* level 0 = the frame itself. Return false if frame is not the registered frame */
+    bool GetImage(const cv::Mat& frame, int32_t level, bool is_rgb, cv::Mat& image);
+    /* The smallest level where src_size is still larger than dst_size */
+    int32_t SelectLevel(const cv::Size& src_size, const cv::Size& dst_size) const;
+
+private:
+    FrameImageCache();
+    bool IsFrameLocked(const cv::Mat& frame) const;
+    void CreateImageLocked(const cv::Mat& frame, int32_t level, int32_t color);
+
+private:
+    static constexpr int32_t kLevelNum = 5;
+    std::mutex mtx_;
+    const uint8_t* frame_data_;
+    cv::Size frame_size_;
+    size_t frame_step_;
+    int32_t frame_type_;
+    std::array<std::array<cv::Mat, 2>, kLevelNum> image_list_;  /* [level][is_rgb] */
+    std::array<std::array<bool, 2>, kLevelNum> is_valid_list_;
+};
+
+
+/***
+* Motion gate for a fixed camera. Inference is skipped or restricted to the moving region when the scene is static
+*   - the frame is downsampled to gray (analysis_width), and compared with the background (running average)
+*   - changed pixels are counted per cell (8 x 8 px in the downsampled image) with an integral image
+*   - kGateSkip: no moving cell. Skip inference and reuse the last result
+*   - kGateRegion: moving cells cover a part of the frame. Inference on GetMotionRect only (e.g. mat(rect) for CropResizeCvt)
+*   - kGateFull: large motion, the first frame, or every max_skip_frame frames to refresh the result
+* Usage:
+*   switch (gate.Check(frame)) {
+*   case MotionGate::kGateSkip:   result = result_last; result.is_result_reused = true; break;
+*   case MotionGate::kGateRegion: engine->Process(frame(gate.GetMotionRect()), result); gate.MapRegionResult(result, bbox_last_list); break;
+*   case MotionGate::kGateFull:   engine->Process(frame, result); break;
+*   }
+***/
+class MotionGate
+{
+public:
+    typedef enum {
+        kGateFull,
+        kGateRegion,
+        kGateSkip,
+    } Gate;
+
+public:
+    MotionGate(int32_t analysis_width = 160, int32_t threshold_diff = 20, float threshold_cell_ratio = 0.1f, float threshold_region_ratio = 0.5f, int32_t max_skip_frame = 30, float learning_rate = 0.05f);
+    void Reset();
+
+    /* Call for every frame */
+    Gate Check(const cv::Mat& frame);
+    /* Moving region in the frame (expanded by a cell). The whole frame for kGateFull */
+    const cv::Rect& GetMotionRect() const { return motion_rect_; }
+    /* Ratio of moving cells in the last frame */
+    float GetMotionRatio() const { return motion_ratio_; }
+    /* Ratio of frames where inference is skipped since Reset */
+    float GetGatingRatio() const { return frame_num_ > 0 ? static_cast<float>(skipped_frame_num_) / frame_num_ : 0.0f; }
+
+    /* For kGateRegion. Map the result on GetMotionRect to the frame (RESULT needs bbox_list and crop) */
+    /* Objects out of the region didn't move, so the boxes of bbox_last_list out of the region are added to keep them */
+    template <typename RESULT>
+    void MapRegionResult(RESULT& result, const std::vector<BoundingBox>& bbox_last_list) const
+    {
+        for (auto& bbox : result.bbox_list) {
+            bbox.x += motion_rect_.x;
+            bbox.y += motion_rect_.y;
+        }
+        result.crop.x += motion_rect_.x;
+        result.crop.y += motion_rect_.y;
+        for (const auto& bbox : bbox_last_list) {
+            if ((cv::Rect(bbox.x, bbox.y, bbox.w, bbox.h) & motion_rect_).area() == 0) {
+                result.bbox_list.push_back(bbox);
+            }
+        }
+    }
+
+private:
+    void CreateGray(const cv::Mat& frame, cv::Mat& gray);
+
+private:
+    int32_t analysis_width_;
+    int32_t threshold_diff_;
+    float threshold_cell_ratio_;
+    float threshold_region_ratio_;
+    int32_t max_skip_frame_;
+    float learning_rate_;
+
+    cv::Size frame_size_;
+    cv::Mat gray_;
+    cv::Mat background_;        /* CV_32FC1 */
+    cv::Mat background_u8_;
+    cv::Mat mask_;
+    cv::Mat integral_;
+    cv::Rect motion_rect_;
+    float motion_ratio_;
+    int32_t frame_cnt_from_full_;
+    int32_t frame_num_;
+    int32_t skipped_frame_num_;
+};
+
+
+/***
+* Frame source decoded on a background thread
+*   - input: video file, camera id, "jetson", gstreamer pipeline, still image, directory of images, wildcard ("dir/*.jpg"), or list of images
+*   - frames are decoded into a fixed pool of cv::Mat which is recycled (a buffer still referenced by the caller is not overwritten but re-allocated)
+*   - kModeLatest: only the newest frame is kept, and older ones are dropped (live camera)
+*   - kModeLossless: every frame is delivered in order (video file, images)
+*   - images in a list are decoded in parallel (OpenMP)
+* Usage:
+*   VideoSource cap;
+*   cap.Open(input_name);
+*   cap.Read(image);        // image refers to a buffer in the pool. It's valid until the next Read
+***/
+class VideoSource
+{
+public:
+    typedef enum {
+        kModeAuto,      // kModeLatest for camera, kModeLossless for others
+        kModeLatest,
+        kModeLossless,
+    } Mode;
+
+public:
+    VideoSource();
+    ~VideoSource();
+    bool Open(const std::string& input_name, int32_t width = 640, int32_t height = 480, Mode mode = kModeAuto, int32_t pool_size = 4);
+    bool Open(const std::vector<std::string>& image_list, Mode mode = kModeLossless, int32_t pool_size = 4);
+    void Release();
+
+    /* Returns false at the end. A still image is returned repeatedly */
+    bool Read(cv::Mat& mat);
+    /* true: frames are streamed (video, camera, images). false: still image or not opened */
+    bool IsVideo() const { return type_ == kTypeVideo || type_ == kTypeImageList; }
+    /* true: frames are dropped when the reader is slow (camera. kModeLatest) */
+    bool IsLive() const { return type_ == kTypeVideo && mode_ == kModeLatest; }
+    /* The same as cv::VideoCapture. CAP_PROP_POS_FRAMES is the position next to the frame returned by Read. Setting it discards decoded frames */
+    double Get(int32_t prop_id);
+    bool Set(int32_t prop_id, double value);
+
+private:
+    typedef enum {
+        kTypeNone,
+        kTypeVideo,
+        kTypeImage,
+        kTypeImageList,
+    } Type;
+
+private:
+    void Start(int32_t pool_size);
+    void ThreadDecode();
+    int32_t DecodeVideo(const std::vector<int32_t>& slot_list);
+    int32_t DecodeImageList(const std::vector<int32_t>& slot_list);
+    void PrepareSlot(int32_t slot);
+
+private:
+    Type type_;
+    Mode mode_;
+    cv::VideoCapture cap_;
+    std::vector<std::string> image_list_;
+    cv::Mat image_org_;         // kTypeImage
+    cv::Size image_size_;
+
+    std::vector<cv::Mat> pool_;
+    std::vector<int32_t> pool_frame_index_;
+    std::vector<std::vector<uint8_t>> pool_file_buffer_;   // kTypeImageList
+    std::deque<int32_t> free_list_;
+    std::deque<int32_t> ready_list_;
+    int32_t slot_in_use_;
+    int32_t frame_index_in_use_;
+
+    std::thread thread_;
+    std::mutex mtx_;            // pool lists and flags
+    std::mutex mtx_source_;     // cap_ and next_frame_index_. Held while decoding
+    std::condition_variable cv_;
+    bool is_running_;
+    bool is_end_;
+    int32_t next_frame_index_;
+};
+
+
+/***
+* Recording sink which encodes on a background thread
+*   - Write copies the frame into a recycled buffer in a bounded queue and returns. cv::VideoWriter runs on the sink thread
+*   - when the queue is full, the frame is dropped (counted and reported at Release), or Write waits if is_blocking (offline conversion)
+*   - Open with VideoSource: drops frames only for a live source (camera), and waits for the encoder for a file or image list
+*   - OpenResult: raw results (boxes, tracks, masks, ...) are recorded as TensorTrace frames instead of pixels. It waits by default (small data)
+* Usage:
+*   VideoSink writer;
+*   writer.Open("out.mp4", cap);      // fps and size of cap. or writer.Open("out.mp4", 30.0, cv::Size(640, 480));
+*   writer.Write(image);
+*   writer.Release();       // queued frames are flushed
+***/
+class VideoSink
+{
+public:
+    VideoSink();
+    ~VideoSink();
+    bool Open(const std::string& filename, double fps, const cv::Size& size, int32_t queue_size = 8, bool is_blocking = false);
+    /* size: the frame size of source if empty */
+    bool Open(const std::string& filename, VideoSource& source, const cv::Size& size = cv::Size(), int32_t queue_size = 8);
+    bool OpenResult(const std::string& filename, int32_t queue_size = 32, bool is_blocking = true);
+    void Release();
+    bool IsOpened() const { return type_ != kTypeNone; }
+
+    /* Returns false if the frame is dropped */
+    bool Write(const cv::Mat& frame);
+    /* Tensor data is copied */
+    bool WriteResult(const TensorTrace::Frame& frame);
+
+    int32_t GetWrittenNum();
+    int32_t GetDroppedNum();
+
+private:
+    typedef enum {
+        kTypeNone,
+        kTypeVideo,
+        kTypeResult,
+    } Type;
+
+    typedef struct Slot_ {
+        cv::Mat frame;
+        TensorTrace::Frame result;
+        std::vector<std::vector<uint8_t>> result_data_list;
+    } Slot;
+
+private:
+    void Start(int32_t queue_size, bool is_blocking);
+    int32_t AcquireSlot();
+    void Submit(int32_t slot);
+    void ThreadWrite();
+
+private:
+    Type type_;
+    bool is_blocking_;
+    std::string filename_;
+    cv::VideoWriter writer_;
+    TensorTraceWriter result_writer_;
+
+    std::vector<Slot> pool_;
+    std::deque<int32_t> free_list_;
+    std::deque<int32_t> ready_list_;
+
+    std::thread thread_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool is_running_;
+    int32_t written_num_;
+    int32_t dropped_num_;
+};
+
+
 }
 
 #endif
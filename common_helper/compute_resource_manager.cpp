@@ -0,0 +1,220 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* for My modules */
+#include "common_helper.h"
+#include "engine_config.h"
+#include "compute_resource_manager.h"
+
+/*** Macro ***/
+#define TAG "ComputeResourceManager"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Function ***/
+ComputeResourceManager& ComputeResourceManager::GetInstance()
+{
+    static ComputeResourceManager instance;
+    return instance;
+}
+
+ComputeResourceManager::ComputeResourceManager() : concurrent_core_num_(0), is_main_thread_configured_(false), omp_num_threads_previous_(0)
+{
+    cpu_list_available_ = GetCurrentThreadAffinity();
+    if (cpu_list_available_.empty()) {
+        /* Affinity is not supported. Assume all the cores are available */
+        const int32_t hardware_concurrency = (std::max)(1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+        for (int32_t i = 0; i < hardware_concurrency; i++) cpu_list_available_.push_back(i);
+    }
+    const int32_t core_num = EngineConfig::GetInstance().GetInt("num_cores", static_cast<int32_t>(cpu_list_available_.size()));
+    SetCoreNum(core_num);
+}
+
+void ComputeResourceManager::SetCoreNum(int32_t core_num)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!budget_map_.empty()) {
+        PRINT_E("Core num must be set before Reserve\n");
+        return;
+    }
+    /* Use the highest ids, which are the big cores on big.LITTLE */
+    core_num = (std::max)(1, (std::min)(core_num, static_cast<int32_t>(cpu_list_available_.size())));
+    cpu_list_.assign(cpu_list_available_.end() - core_num, cpu_list_available_.end());
+}
+
+int32_t ComputeResourceManager::GetCoreNum()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return static_cast<int32_t>(cpu_list_.size());
+}
+
+ComputeResourceManager::Budget ComputeResourceManager::Reserve(const std::string& engine_name, int32_t num_threads, ExecutionType type)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    const auto& it = budget_map_.find(engine_name);
+    if (it != budget_map_.end()) {
+        return it->second;
+    }
+
+    Budget budget;
+    budget.type = type;
+    const int32_t main_core_num = static_cast<int32_t>(cpu_list_.size()) - concurrent_core_num_;
+    if (num_threads <= 0) num_threads = main_core_num;
+    if (type == kConcurrent) {
+        const int32_t available_core_num = main_core_num - 1;     /* keep at least one core for the main thread */
+        if (available_core_num > 0) {
+            budget.num_threads = (std::min)(num_threads, available_core_num);
+            budget.cpu_list.assign(cpu_list_.begin() + concurrent_core_num_, cpu_list_.begin() + concurrent_core_num_ + budget.num_threads);
+            concurrent_core_num_ += budget.num_threads;
+        } else {
+            /* No core left. Share all the cores */
+            PRINT("No free core for %s\n", engine_name.c_str());
+            budget.num_threads = 1;
+            budget.cpu_list = cpu_list_;
+        }
+    } else {
+        budget.num_threads = (std::min)(num_threads, main_core_num);
+        budget.cpu_list.assign(cpu_list_.begin() + concurrent_core_num_, cpu_list_.end());
+    }
+    budget_map_[engine_name] = budget;
+    PRINT("%s: %d threads on cpu %d - %d\n", engine_name.c_str(), budget.num_threads, budget.cpu_list.front(), budget.cpu_list.back());
+    return budget;
+}
+
+bool ComputeResourceManager::GetBudget(const std::string& engine_name, Budget& budget)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    const auto& it = budget_map_.find(engine_name);
+    if (it == budget_map_.end()) return false;
+    budget = it->second;
+    return true;
+}
+
+void ComputeResourceManager::Reset(void)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    budget_map_.clear();
+    concurrent_core_num_ = 0;
+
+    if (is_main_thread_configured_) {
+        /* The caller may be a thread owned by the application (e.g. JNI thread), so don't leave it pinned */
+        const std::vector<int32_t> cpu_list = cpu_list_main_thread_previous_;
+        SetCurrentThreadAffinity(cpu_list);
+#ifdef _OPENMP
+        const int32_t num_threads = omp_num_threads_previous_;
+        omp_set_num_threads(num_threads);
+#pragma omp parallel num_threads(num_threads)
+        {
+            SetCurrentThreadAffinity(cpu_list);
+        }
+#endif
+        is_main_thread_configured_ = false;
+    }
+}
+
+std::vector<int32_t> ComputeResourceManager::GetMainCpuList()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return std::vector<int32_t>(cpu_list_.begin() + concurrent_core_num_, cpu_list_.end());
+}
+
+int32_t ComputeResourceManager::ConfigureMainThread(int32_t num_threads)
+{
+    const std::vector<int32_t> cpu_list = GetMainCpuList();
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!is_main_thread_configured_) {
+            cpu_list_main_thread_previous_ = GetCurrentThreadAffinity();
+#ifdef _OPENMP
+            omp_num_threads_previous_ = omp_get_max_threads();
+#endif
+            is_main_thread_configured_ = true;
+        }
+    }
+    SetCurrentThreadAffinity(cpu_list);
+    const int32_t main_core_num = static_cast<int32_t>(cpu_list.size());
+    num_threads = (num_threads <= 0) ? main_core_num : (std::min)(num_threads, main_core_num);
+#ifdef _OPENMP
+    /* OpenMP threads are reused across parallel regions, so pinning them once is enough */
+    omp_set_num_threads(num_threads);
+#pragma omp parallel num_threads(num_threads)
+    {
+        SetCurrentThreadAffinity(cpu_list);
+    }
+#endif
+    return num_threads;
+}
+
+int32_t ComputeResourceManager::SetCurrentThreadAffinity(const std::vector<int32_t>& cpu_list)
+{
+    if (cpu_list.empty()) return kRetOk;
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto cpu : cpu_list) {
+        CPU_SET(cpu, &cpu_set);
+    }
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {     /* 0 = calling thread */
+        PRINT_E("Failed to set cpu affinity\n");
+        return kRetErr;
+    }
+    return kRetOk;
+#else
+    return kRetErr;     /* not supported */
+#endif
+}
+
+std::vector<int32_t> ComputeResourceManager::GetCurrentThreadAffinity(void)
+{
+    std::vector<int32_t> cpu_list;
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        for (int32_t i = 0; i < CPU_SETSIZE; i++) {
+            if (CPU_ISSET(i, &cpu_set)) cpu_list.push_back(i);
+        }
+    }
+#endif
+    return cpu_list;
+}
+
+ComputeResourceManager::ScopedAffinity::ScopedAffinity(const std::vector<int32_t>& cpu_list)
+{
+    if (cpu_list.empty()) return;
+    cpu_list_previous_ = GetCurrentThreadAffinity();
+    SetCurrentThreadAffinity(cpu_list);
+}
+
+ComputeResourceManager::ScopedAffinity::~ScopedAffinity()
+{
+    SetCurrentThreadAffinity(cpu_list_previous_);
+}
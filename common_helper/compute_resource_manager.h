@@ -0,0 +1,106 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef COMPUTE_RESOURCE_MANAGER_
+#define COMPUTE_RESOURCE_MANAGER_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+/***
+* Process-wide manager of cores, to avoid oversubscription when a project uses several interpreters and OpenMP
+*   - kSequential: engines called one after another in the frame loop (e.g. palm detection -> hand landmark). Their num_threads is only clamped to the number of main cores
+*     (each interpreter still creates its own thread pool. No pool is shared between them)
+*   - kConcurrent: engines running at the same time as the frame loop (async thread, pipeline segment). They get their own cores taken from the main cores
+*   - the cores are the affinity of the process at start up (taskset, cpuset), or the last "num_cores" of them in EngineConfig
+*   - kConcurrent cores are taken from the lowest cpu ids, so that the main cores are the big ones on big.LITTLE (the highest ids)
+*   - the OpenMP pool (used for post process) is sized and pinned to the main cores by ConfigureMainThread, and restored by Reset
+*   - worker threads of an interpreter inherit the affinity of the thread which creates them, so create it under ScopedAffinity
+* Usage:
+*   auto& manager = ComputeResourceManager::GetInstance();
+*   const auto budget_async = manager.Reserve("ClassificationEngine", 2, ComputeResourceManager::kConcurrent);   // reserve concurrent ones first
+*   const auto budget = manager.Reserve("PalmDetectionEngine", 4);
+*   manager.ConfigureMainThread(num_threads);
+*   { ComputeResourceManager::ScopedAffinity affinity(budget_async.cpu_list); engine->Initialize(work_dir, budget_async.num_threads); }
+***/
+class ComputeResourceManager {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+    typedef enum {
+        kSequential,
+        kConcurrent,
+    } ExecutionType;
+
+    typedef struct Budget_ {
+        ExecutionType         type;
+        int32_t               num_threads;      // for the interpreter
+        std::vector<int32_t>  cpu_list;
+        Budget_() : type(kSequential), num_threads(1) {}
+    } Budget;
+
+    /* Sets the affinity of the calling thread in the scope, and restores it */
+    class ScopedAffinity {
+    public:
+        explicit ScopedAffinity(const std::vector<int32_t>& cpu_list);
+        ~ScopedAffinity();
+    private:
+        std::vector<int32_t> cpu_list_previous_;
+    };
+
+public:
+    static ComputeResourceManager& GetInstance();
+
+    void SetCoreNum(int32_t core_num);
+    int32_t GetCoreNum();
+
+    /* Returns the same budget if the engine is already reserved. num_threads <= 0 means as many as possible */
+    Budget Reserve(const std::string& engine_name, int32_t num_threads, ExecutionType type = kSequential);
+    bool GetBudget(const std::string& engine_name, Budget& budget);
+    /* Releases all the budgets, and restores the affinity changed by ConfigureMainThread (call from the same thread) */
+    void Reset(void);
+
+    /* Cores which are not reserved by kConcurrent engines */
+    std::vector<int32_t> GetMainCpuList();
+    /* Pins the calling thread and the OpenMP pool to the main cores. num_threads <= 0 means all the main cores. Returns the number of threads for post process */
+    int32_t ConfigureMainThread(int32_t num_threads = 0);
+
+    static int32_t SetCurrentThreadAffinity(const std::vector<int32_t>& cpu_list);
+    static std::vector<int32_t> GetCurrentThreadAffinity(void);
+
+private:
+    ComputeResourceManager();
+    ComputeResourceManager(const ComputeResourceManager&) = delete;
+    ComputeResourceManager& operator=(const ComputeResourceManager&) = delete;
+
+private:
+    std::mutex mtx_;
+    std::vector<int32_t> cpu_list_available_;   // affinity at start up
+    std::vector<int32_t> cpu_list_;             // cores to use (the last core_num of cpu_list_available_)
+    int32_t concurrent_core_num_;               // taken from the beginning of cpu_list_
+    std::map<std::string, Budget> budget_map_;
+
+    bool is_main_thread_configured_;
+    std::vector<int32_t> cpu_list_main_thread_previous_;
+    int32_t omp_num_threads_previous_;
+};
+
+#endif
@@ -0,0 +1,151 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "common_helper.h"
+#include "detection_scheduler.h"
+
+/*** Macro ***/
+#define TAG "DetectionScheduler"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Setting ***/
+static constexpr int32_t kGridPointNum = 3;     /* kGridPointNum x kGridPointNum points in a bbox are tracked */
+static constexpr int32_t kMinValidPointNum = 4;
+
+
+DetectionScheduler::DetectionScheduler(int32_t detection_interval, float threshold_uncertainty, float threshold_speed, bool use_optical_flow, int32_t flow_width)
+{
+    detection_interval_ = (std::max)(1, detection_interval);
+    threshold_uncertainty_ = threshold_uncertainty;
+    threshold_speed_ = threshold_speed;
+    use_optical_flow_ = use_optical_flow;
+    flow_width_ = flow_width;
+    Reset();
+}
+
+void DetectionScheduler::Reset()
+{
+    frame_size_ = cv::Size();
+    gray_.release();
+    gray_prev_.release();
+    is_detection_frame_ = true;
+    is_tracking_lost_ = false;
+    uncertainty_max_ = 0.0f;
+    speed_max_ = 0.0f;
+    frame_cnt_from_detection_ = 0;
+}
+
+void DetectionScheduler::CreateGray(const cv::Mat& frame, cv::Mat& gray)
+{
+    /* Resize first, then convert color, to reduce calculation */
+    cv::Mat small;
+    const int32_t width = (std::min)(flow_width_, frame.cols);
+    const int32_t height = (std::max)(1, frame.rows * width / frame.cols);
+    cv::resize(frame, small, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+    if (small.channels() == 3) {
+        cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+    } else if (small.channels() == 4) {
+        cv::cvtColor(small, gray, cv::COLOR_BGRA2GRAY);
+    } else {
+        gray = small;
+    }
+}
+
+bool DetectionScheduler::CheckDetectionFrame(const cv::Mat& frame)
+{
+    /* Detect every frame: nothing to do */
+    if (detection_interval_ <= 1 || frame.empty()) {
+        is_detection_frame_ = true;
+        frame_cnt_from_detection_ = 0;
+        return true;
+    }
+
+    if (use_optical_flow_) {
+        cv::swap(gray_prev_, gray_);
+        CreateGray(frame, gray_);
+    }
+
+    bool is_detection_frame = false;
+    if (frame.size() != frame_size_) {
+        is_detection_frame = true;
+    } else if (frame_cnt_from_detection_ + 1 >= detection_interval_) {
+        is_detection_frame = true;
+    } else if (is_tracking_lost_ || uncertainty_max_ > threshold_uncertainty_ || speed_max_ > threshold_speed_) {
+        is_detection_frame = true;
+    }
+
+    frame_size_ = frame.size();
+    is_detection_frame_ = is_detection_frame;
+    if (is_detection_frame) {
+        frame_cnt_from_detection_ = 0;
+        is_tracking_lost_ = false;
+    } else {
+        frame_cnt_from_detection_++;
+    }
+    return is_detection_frame;
+}
+
+void DetectionScheduler::TrackOpticalFlow(std::vector<BoundingBox>& bbox_list, std::vector<bool>& is_valid_list)
+{
+    is_valid_list.assign(bbox_list.size(), false);
+    if (gray_prev_.empty() || gray_.empty() || gray_prev_.size() != gray_.size()) return;
+
+    const float scale = static_cast<float>(gray_.cols) / frame_size_.width;
+    std::vector<cv::Point2f> point_prev_list;
+    for (const auto& bbox : bbox_list) {
+        for (int32_t y = 1; y <= kGridPointNum; y++) {
+            for (int32_t x = 1; x <= kGridPointNum; x++) {
+                point_prev_list.push_back(cv::Point2f((bbox.x + bbox.w * x / (kGridPointNum + 1.0f)) * scale, (bbox.y + bbox.h * y / (kGridPointNum + 1.0f)) * scale));
+            }
+        }
+    }
+
+    std::vector<cv::Point2f> point_list;
+    std::vector<uint8_t> status_list;
+    std::vector<float> error_list;
+    cv::calcOpticalFlowPyrLK(gray_prev_, gray_, point_prev_list, point_list, status_list, error_list, cv::Size(15, 15), 2);
+
+    /* Median of the movement of the tracked points is used as the movement of the bbox */
+    constexpr int32_t kPointNumPerBbox = kGridPointNum * kGridPointNum;
+    std::vector<float> dx_list;
+    std::vector<float> dy_list;
+    for (size_t i_bbox = 0; i_bbox < bbox_list.size(); i_bbox++) {
+        dx_list.clear();
+        dy_list.clear();
+        for (int32_t i = 0; i < kPointNumPerBbox; i++) {
+            size_t index = i_bbox * kPointNumPerBbox + i;
+            if (!status_list[index]) continue;
+            dx_list.push_back(point_list[index].x - point_prev_list[index].x);
+            dy_list.push_back(point_list[index].y - point_prev_list[index].y);
+        }
+        if (static_cast<int32_t>(dx_list.size()) < kMinValidPointNum) continue;
+        std::nth_element(dx_list.begin(), dx_list.begin() + dx_list.size() / 2, dx_list.end());
+        std::nth_element(dy_list.begin(), dy_list.begin() + dy_list.size() / 2, dy_list.end());
+        bbox_list[i_bbox].x += static_cast<int32_t>(std::round(dx_list[dx_list.size() / 2] / scale));
+        bbox_list[i_bbox].y += static_cast<int32_t>(std::round(dy_list[dy_list.size() / 2] / scale));
+        is_valid_list[i_bbox] = true;
+    }
+}
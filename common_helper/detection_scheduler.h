@@ -0,0 +1,117 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef DETECTION_SCHEDULER_
+#define DETECTION_SCHEDULER_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "bounding_box.h"
+
+/***
+* Run detector only on some frames, and move tracks by Kalman prediction (+ sparse optical flow) on the other frames
+*   - detection frame: every detection_interval frames, or when a track is uncertain (Kalman covariance), moves fast or is lost by optical flow
+*   - tracker needs Predict() and tracks need GetLatestBoundingBox(), Correct(), GetPositionUncertainty(), GetSpeed() (Tracker, TrackerDeepSort)
+* Usage:
+*   if (scheduler.CheckDetectionFrame(frame)) {
+*       engine->Process(frame, det_result);
+*       tracker.Update(det_result.bbox_list);
+*   } else {
+*       scheduler.Interpolate(tracker);
+*   }
+*   scheduler.UpdateTrackStatus(tracker);
+***/
+class DetectionScheduler {
+public:
+    DetectionScheduler(int32_t detection_interval = 1, float threshold_uncertainty = 4.0f, float threshold_speed = 20.0f, bool use_optical_flow = true, int32_t flow_width = 320);
+    ~DetectionScheduler() {}
+    void Reset();
+
+    /* Call for every frame. Returns true if detector needs to be run for the frame */
+    bool CheckDetectionFrame(const cv::Mat& frame);
+    bool IsDetectionFrame() const { return is_detection_frame_; }
+    int32_t GetFrameCountFromDetection() const { return frame_cnt_from_detection_; }
+
+    /* Call instead of tracker.Update when CheckDetectionFrame returns false */
+    template <typename T>
+    void Interpolate(T& tracker)
+    {
+        std::vector<BoundingBox> bbox_list;
+        for (auto& track : tracker.GetTrackList()) {
+            bbox_list.push_back(track.GetLatestBoundingBox());
+        }
+        tracker.Predict();
+        if (!use_optical_flow_ || bbox_list.empty()) return;
+
+        /* Position is measured by optical flow from the previous frame, and size is kept as predicted */
+        std::vector<bool> is_valid_list;
+        TrackOpticalFlow(bbox_list, is_valid_list);
+        size_t i = 0;
+        for (auto& track : tracker.GetTrackList()) {
+            if (is_valid_list[i]) {
+                BoundingBox bbox = track.GetLatestBoundingBox();
+                bbox.x = bbox_list[i].x + (bbox_list[i].w - bbox.w) / 2;
+                bbox.y = bbox_list[i].y + (bbox_list[i].h - bbox.h) / 2;
+                track.Correct(bbox);
+            } else {
+                is_tracking_lost_ = true;
+            }
+            i++;
+        }
+    }
+
+    /* Call for every frame after the tracker is updated (or interpolated), to decide whether the next frame needs detection */
+    template <typename T>
+    void UpdateTrackStatus(T& tracker)
+    {
+        uncertainty_max_ = 0.0f;
+        speed_max_ = 0.0f;
+        for (auto& track : tracker.GetTrackList()) {
+            uncertainty_max_ = (std::max)(uncertainty_max_, track.GetPositionUncertainty());
+            speed_max_ = (std::max)(speed_max_, track.GetSpeed());
+        }
+    }
+
+private:
+    void CreateGray(const cv::Mat& frame, cv::Mat& gray);
+    /* Move bboxes from the previous frame to the current frame. Result is invalid if not enough points are tracked */
+    void TrackOpticalFlow(std::vector<BoundingBox>& bbox_list, std::vector<bool>& is_valid_list);
+
+private:
+    int32_t detection_interval_;
+    float threshold_uncertainty_;
+    float threshold_speed_;
+    bool use_optical_flow_;
+    int32_t flow_width_;
+
+    cv::Size frame_size_;
+    cv::Mat gray_;
+    cv::Mat gray_prev_;
+    bool is_detection_frame_;
+    bool is_tracking_lost_;
+    float uncertainty_max_;
+    float speed_max_;
+    int32_t frame_cnt_from_detection_;
+};
+
+#endif
@@ -0,0 +1,380 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+
+/* for My modules */
+#include "common_helper.h"
+#include "engine_config.h"
+
+/*** Macro ***/
+#define TAG "EngineConfig"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Function ***/
+/* Minimal JSON parser. Only flat values (string, number, true/false/null) and nested objects are supported. Arrays are skipped */
+namespace {
+class JsonParser {
+public:
+    JsonParser(const std::string& text, std::map<std::string, std::string>& value_map) : text_(text), pos_(0), value_map_(value_map) {}
+
+    bool Parse()
+    {
+        SkipSpace();
+        if (!ParseObject("")) return false;
+        SkipSpace();
+        return pos_ == text_.size();
+    }
+
+private:
+    void SkipSpace()
+    {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) pos_++;
+    }
+
+    bool Consume(char c)
+    {
+        SkipSpace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool ParseString(std::string& str)
+    {
+        if (!Consume('"')) return false;
+        str.clear();
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            if (text_[pos_] == '\\' && pos_ + 1 < text_.size()) {
+                pos_++;
+                switch (text_[pos_]) {
+                case 'n': str += '\n'; break;
+                case 't': str += '\t'; break;
+                default: str += text_[pos_]; break;   /* \" \\ \/ */
+                }
+            } else {
+                str += text_[pos_];
+            }
+            pos_++;
+        }
+        return Consume('"');
+    }
+
+    bool ParseValue(const std::string& key)
+    {
+        SkipSpace();
+        if (pos_ >= text_.size()) return false;
+        char c = text_[pos_];
+        if (c == '{') {
+            return ParseObject(key);
+        } else if (c == '[') {
+            return SkipArray();
+        } else if (c == '"') {
+            std::string str;
+            if (!ParseString(str)) return false;
+            value_map_[key] = str;
+            return true;
+        } else {
+            /* number, true, false, null */
+            size_t pos_start = pos_;
+            while (pos_ < text_.size() && text_[pos_] != ',' && text_[pos_] != '}' && text_[pos_] != ']' && !std::isspace(static_cast<unsigned char>(text_[pos_]))) pos_++;
+            std::string str = text_.substr(pos_start, pos_ - pos_start);
+            if (str.empty()) return false;
+            if (str != "null") value_map_[key] = str;
+            return true;
+        }
+    }
+
+    bool ParseObject(const std::string& prefix)
+    {
+        if (!Consume('{')) return false;
+        if (Consume('}')) return true;
+        do {
+            std::string key;
+            if (!ParseString(key)) return false;
+            if (!Consume(':')) return false;
+            if (!ParseValue(prefix.empty() ? key : prefix + "." + key)) return false;
+        } while (Consume(','));
+        return Consume('}');
+    }
+
+    bool SkipArray()
+    {
+        int32_t depth = 0;
+        bool is_in_string = false;
+        for (; pos_ < text_.size(); pos_++) {
+            char c = text_[pos_];
+            if (is_in_string) {
+                if (c == '\\') pos_++;
+                else if (c == '"') is_in_string = false;
+            } else if (c == '"') {
+                is_in_string = true;
+            } else if (c == '[') {
+                depth++;
+            } else if (c == ']') {
+                if (--depth == 0) {
+                    pos_++;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    const std::string& text_;
+    size_t pos_;
+    std::map<std::string, std::string>& value_map_;
+};
+}
+
+EngineConfig& EngineConfig::GetInstance()
+{
+    static EngineConfig s_instance;
+    return s_instance;
+}
+
+int32_t EngineConfig::LoadJson(const std::string& filename)
+{
+    std::ifstream ifs(filename);
+    if (ifs.fail()) {
+        PRINT_E("Failed to read %s\n", filename.c_str());
+        return kRetErr;
+    }
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    if (LoadJsonString(ss.str()) != kRetOk) {
+        PRINT_E("Invalid json: %s\n", filename.c_str());
+        return kRetErr;
+    }
+    return kRetOk;
+}
+
+int32_t EngineConfig::LoadJsonString(const std::string& json)
+{
+    std::map<std::string, std::string> value_map;
+    JsonParser parser(json, value_map);
+    if (!parser.Parse()) return kRetErr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& value : value_map) {
+        value_map_[value.first] = value.second;
+    }
+    return kRetOk;
+}
+
+std::vector<std::string> EngineConfig::ParseCommandLine(int32_t argc, char* argv[])
+{
+    /* Load config file first, so that the other options overwrite it */
+    for (int32_t i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.find("--config=") == 0) {
+            LoadJson(arg.substr(strlen("--config=")));
+        }
+    }
+
+    std::vector<std::string> arg_list;
+    for (int32_t i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.find("--") != 0) {
+            arg_list.push_back(arg);
+            continue;
+        }
+        /* The next argument is never taken as the value, so that "--flag input.mp4" keeps the input */
+        std::string key = arg.substr(2);
+        std::string value = "true";     /* --flag */
+        size_t pos_equal = key.find('=');
+        if (pos_equal != std::string::npos) {
+            value = key.substr(pos_equal + 1);
+            key = key.substr(0, pos_equal);
+        }
+        if (key != "config") Set(key, value);
+    }
+    return arg_list;
+}
+
+void EngineConfig::Set(const std::string& key, const std::string& value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    value_map_[key] = value;
+}
+
+bool EngineConfig::Find(const std::string& tag, const std::string& key, std::string& value) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = value_map_.find(tag + "." + key);
+    if (it == value_map_.end()) it = value_map_.find(key);
+    if (it == value_map_.end()) return false;
+    value = it->second;
+    return true;
+}
+
+bool EngineConfig::Find(const std::string& key, std::string& value) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = value_map_.find(key);
+    if (it == value_map_.end()) return false;
+    value = it->second;
+    return true;
+}
+
+int32_t EngineConfig::ConvertInt(const std::string& key, const std::string& value, int32_t default_value)
+{
+    char* end;
+    long ret = std::strtol(value.c_str(), &end, 10);
+    if (end == value.c_str()) {
+        PRINT_E("Invalid value for %s: %s\n", key.c_str(), value.c_str());
+        return default_value;
+    }
+    return static_cast<int32_t>(ret);
+}
+
+bool EngineConfig::Has(const std::string& tag, const std::string& key) const
+{
+    std::string value;
+    return Find(tag, key, value);
+}
+
+std::string EngineConfig::GetString(const std::string& tag, const std::string& key, const std::string& default_value) const
+{
+    std::string value;
+    return Find(tag, key, value) ? value : default_value;
+}
+
+int32_t EngineConfig::GetInt(const std::string& tag, const std::string& key, int32_t default_value) const
+{
+    std::string value;
+    return Find(tag, key, value) ? ConvertInt(key, value, default_value) : default_value;
+}
+
+float EngineConfig::GetFloat(const std::string& tag, const std::string& key, float default_value) const
+{
+    std::string value;
+    if (!Find(tag, key, value)) return default_value;
+    char* end;
+    float ret = std::strtof(value.c_str(), &end);
+    if (end == value.c_str()) {
+        PRINT_E("Invalid value for %s: %s\n", key.c_str(), value.c_str());
+        return default_value;
+    }
+    return ret;
+}
+
+bool EngineConfig::GetBool(const std::string& tag, const std::string& key, bool default_value) const
+{
+    std::string value;
+    if (!Find(tag, key, value)) return default_value;
+    return value == "true" || value == "1" || value == "on";
+}
+
+std::string EngineConfig::GetString(const std::string& key, const std::string& default_value) const
+{
+    std::string value;
+    return Find(key, value) ? value : default_value;
+}
+
+int32_t EngineConfig::GetInt(const std::string& key, int32_t default_value) const
+{
+    std::string value;
+    return Find(key, value) ? ConvertInt(key, value, default_value) : default_value;
+}
+
+
+std::string EngineConfig::GetMachineName()
+{
+    /* Cache is valid only on the same machine (and the same number of cores) */
+    const char* host_name = std::getenv("HOSTNAME");
+    if (!host_name) host_name = std::getenv("COMPUTERNAME");
+    return std::string(host_name ? host_name : "unknown") + "_" + std::to_string(std::thread::hardware_concurrency());
+}
+
+std::string EngineConfig::GetModelId(const std::string& model_filename)
+{
+    struct stat st;
+    if (stat(model_filename.c_str(), &st) != 0) return model_filename;
+    return model_filename + "_" + std::to_string(static_cast<int64_t>(st.st_size)) + "_" + std::to_string(static_cast<int64_t>(st.st_mtime));
+}
+
+std::vector<int32_t> EngineConfig::GetNumThreadsCandidateList()
+{
+    const int32_t num_cores = (std::max)(1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+    std::vector<int32_t> num_threads_list;
+    for (int32_t num_threads = 1; num_threads < num_cores; num_threads *= 2) {
+        num_threads_list.push_back(num_threads);
+    }
+    num_threads_list.push_back(num_cores);
+    return num_threads_list;
+}
+
+std::string EngineConfig::AutoTune(const std::string& model_name, const std::vector<std::string>& candidate_list, const BenchmarkFunction& benchmark)
+{
+    if (candidate_list.empty()) return "";
+    const std::string cache_filename = GetString("auto_tune_cache", "auto_tune_cache.txt");
+    const std::string machine_name = GetMachineName();
+    const std::string model_id = GetModelId(model_name);
+
+    /* Use the cached result if exists. format: machine model candidate time (separated by tab) */
+    std::ifstream ifs(cache_filename);
+    std::string line;
+    while (std::getline(ifs, line)) {
+        std::vector<std::string> item_list;
+        std::stringstream ss(line);
+        std::string item;
+        while (std::getline(ss, item, '\t')) item_list.push_back(item);
+        if (item_list.size() >= 3 && item_list[0] == machine_name && item_list[1] == model_id
+            && std::find(candidate_list.begin(), candidate_list.end(), item_list[2]) != candidate_list.end()) {
+            PRINT("Auto tune (cached): %s -> %s\n", model_name.c_str(), item_list[2].c_str());
+            return item_list[2];
+        }
+    }
+    ifs.close();
+
+    /* Benchmark all candidates */
+    std::string best_candidate;
+    double best_time = -1;
+    for (const auto& candidate : candidate_list) {
+        double time = benchmark(candidate);
+        PRINT("Auto tune: %s = %.3lf [msec]\n", candidate.c_str(), time);
+        if (time >= 0 && (best_time < 0 || time < best_time)) {
+            best_time = time;
+            best_candidate = candidate;
+        }
+    }
+    if (best_time < 0) {
+        PRINT_E("No candidate is available\n");
+        return candidate_list[0];
+    }
+    PRINT("Auto tune: %s -> %s\n", model_name.c_str(), best_candidate.c_str());
+
+    std::ofstream ofs(cache_filename, std::ios::app);
+    if (ofs) {
+        ofs << machine_name << "\t" << model_id << "\t" << best_candidate << "\t" << best_time << "\n";
+    }
+    return best_candidate;
+}
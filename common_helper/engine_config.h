@@ -0,0 +1,87 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef ENGINE_CONFIG_
+#define ENGINE_CONFIG_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <functional>
+
+/***
+* Runtime configuration for engines (model, backend, number of threads, crop type, thresholds, ...)
+*   - values are loaded from a JSON file and/or command line options
+*   - only DetectionEngine of pj_tflite_det_yolox reads the engine settings (model, backend, threads, crop type, thresholds, trace). Other engines still use their compile-time settings
+*   - image processors read their scheduling settings (detection_interval, keyframe_interval, ...) in ImageProcessor::Initialize
+*   - a value for a specific engine can be set with its tag as prefix ("DetectionEngine.model"). nested JSON object is flattened in the same way
+*       { "num_threads": 4, "DetectionEngine": { "model": "yolox_nano_480x640.tflite", "backend": "tflite_xnnpack" } }
+*   - command line: --key=value. --flag (without value) is "true". --config=file.json loads the file
+* Usage:
+*   EngineConfig::GetInstance().ParseCommandLine(argc, argv);       // in main
+*   config.GetInt(TAG, "detection_interval", kDetectionInterval);    // in ImageProcessor::Initialize
+***/
+class EngineConfig {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+    /* Benchmark function for auto tune. Returns processing time [msec] of the candidate, or negative value if the candidate is not available */
+    typedef std::function<double(const std::string& candidate)> BenchmarkFunction;
+
+public:
+    static EngineConfig& GetInstance();
+
+    int32_t LoadJson(const std::string& filename);
+    int32_t LoadJsonString(const std::string& json);
+    /* Returns arguments which are not options (e.g. input file name) */
+    std::vector<std::string> ParseCommandLine(int32_t argc, char* argv[]);
+    void Set(const std::string& key, const std::string& value);
+
+    /* "tag.key" is used if it exists, otherwise "key" is used */
+    bool Has(const std::string& tag, const std::string& key) const;
+    std::string GetString(const std::string& tag, const std::string& key, const std::string& default_value) const;
+    int32_t GetInt(const std::string& tag, const std::string& key, int32_t default_value) const;
+    float GetFloat(const std::string& tag, const std::string& key, float default_value) const;
+    bool GetBool(const std::string& tag, const std::string& key, bool default_value) const;
+
+    /* Global value ("key" only. e.g. options for main) */
+    std::string GetString(const std::string& key, const std::string& default_value) const;
+    int32_t GetInt(const std::string& key, int32_t default_value) const;
+
+    /* Auto tune: benchmark all candidates and return the fastest one */
+    /* The result is cached in a file (key "auto_tune_cache") per (model file, machine), so benchmark runs only for the first time */
+    /* The model file is identified by its path, size and modification time, so replacing the file invalidates the cache */
+    std::string AutoTune(const std::string& model_name, const std::vector<std::string>& candidate_list, const BenchmarkFunction& benchmark);
+    static std::vector<int32_t> GetNumThreadsCandidateList();
+
+private:
+    EngineConfig() {}
+    bool Find(const std::string& tag, const std::string& key, std::string& value) const;
+    bool Find(const std::string& key, std::string& value) const;
+    static int32_t ConvertInt(const std::string& key, const std::string& value, int32_t default_value);
+    static std::string GetMachineName();
+    static std::string GetModelId(const std::string& model_filename);
+
+private:
+    std::map<std::string, std::string> value_map_;
+    mutable std::mutex mutex_;
+};
+
+#endif
@@ -0,0 +1,299 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+/* for My modules */
+#include "common_helper.h"
+#include "inference_helper.h"
+#include "compute_resource_manager.h"
+#include "inference_pipeline.h"
+
+/*** Macro ***/
+#define TAG "InferencePipeline"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Function ***/
+static int32_t GetElementSize(int32_t tensor_type)
+{
+    switch (tensor_type) {
+    case TensorInfo::kTensorTypeUint8:
+    case TensorInfo::kTensorTypeInt8:
+        return 1;
+    case TensorInfo::kTensorTypeInt64:
+        return 8;
+    case TensorInfo::kTensorTypeFp32:
+    case TensorInfo::kTensorTypeInt32:
+    default:
+        return 4;
+    }
+}
+
+static int32_t GetDataSize(const InputTensorInfo& input_tensor_info)
+{
+    if (input_tensor_info.data_type == InputTensorInfo::kDataTypeImage) {
+        return input_tensor_info.image_info.width * input_tensor_info.image_info.height * input_tensor_info.image_info.channel;
+    }
+    return input_tensor_info.GetElementNum() * GetElementSize(input_tensor_info.tensor_type);
+}
+
+std::string InferencePipeline::GetSegmentModelFilename(const std::string& filename_base, int32_t index, int32_t num)
+{
+    return filename_base + "_segment_" + std::to_string(index) + "_of_" + std::to_string(num) + ".tflite";
+}
+
+int32_t InferencePipeline::Initialize(const std::vector<Segment>& segment_list, int32_t queue_size)
+{
+    if (!stage_list_.empty()) {
+        PRINT_E("Already initialized\n");
+        return kRetErr;
+    }
+    if (segment_list.empty()) {
+        PRINT_E("No segment\n");
+        return kRetErr;
+    }
+    if (queue_size <= 0) {
+        queue_size = static_cast<int32_t>(segment_list.size());     /* enough to keep all segments busy */
+    }
+
+    for (size_t i = 0; i < segment_list.size(); i++) {
+        const Segment& segment = segment_list[i];
+        std::unique_ptr<Stage> stage(new Stage());
+        stage->input_tensor_info_list = segment.input_tensor_info_list;
+        stage->output_tensor_info_list = segment.output_tensor_info_list;
+        stage->cpu_list = segment.cpu_list;
+        if (i > 0) {
+            /* Fed with the raw output of the previous segment */
+            if (stage->input_tensor_info_list.size() != stage_list_.back()->output_tensor_info_list.size()) {
+                PRINT_E("The number of input tensors of segment %d doesn't match the previous output\n", static_cast<int32_t>(i));
+                stage_list_.clear();
+                return kRetErr;
+            }
+            for (auto& input_tensor_info : stage->input_tensor_info_list) {
+                input_tensor_info.data_type = input_tensor_info.is_nchw ? InputTensorInfo::kDataTypeBlobNchw : InputTensorInfo::kDataTypeBlobNhwc;
+            }
+        }
+
+        /* Worker threads of the interpreter inherit the affinity of this thread */
+        ComputeResourceManager::ScopedAffinity affinity(segment.cpu_list);
+        stage->inference_helper.reset(InferenceHelper::Create(segment.helper_type));
+        if (!stage->inference_helper) {
+            stage_list_.clear();
+            return kRetErr;
+        }
+        if (stage->inference_helper->SetNumThreads(segment.num_threads) != InferenceHelper::kRetOk) {
+            stage_list_.clear();
+            return kRetErr;
+        }
+        if (stage->inference_helper->Initialize(segment.model_filename, stage->input_tensor_info_list, stage->output_tensor_info_list) != InferenceHelper::kRetOk) {
+            PRINT_E("Failed to initialize segment %d (%s)\n", static_cast<int32_t>(i), segment.model_filename.c_str());
+            stage_list_.clear();
+            return kRetErr;
+        }
+        stage_list_.push_back(std::move(stage));
+    }
+
+    slot_list_.resize(queue_size);
+    free_slot_queue_.clear();
+    done_slot_queue_.clear();
+    for (int32_t i = 0; i < queue_size; i++) {
+        free_slot_queue_.push_back(i);
+    }
+    frame_id_ = 0;
+    num_in_flight_ = 0;
+
+    is_running_ = true;
+    for (int32_t i = 0; i < static_cast<int32_t>(stage_list_.size()); i++) {
+        stage_list_[i]->thread = std::thread(&InferencePipeline::ThreadStage, this, i);
+    }
+    return kRetOk;
+}
+
+int32_t InferencePipeline::Finalize(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        is_running_ = false;
+    }
+    cv_.notify_all();
+    for (auto& stage : stage_list_) {
+        if (stage->thread.joinable()) stage->thread.join();
+        stage->inference_helper->Finalize();
+    }
+    stage_list_.clear();
+    slot_list_.clear();
+    free_slot_queue_.clear();
+    done_slot_queue_.clear();
+    num_in_flight_ = 0;
+    return kRetOk;
+}
+
+int64_t InferencePipeline::Push(const std::vector<InputTensorInfo>& input_tensor_info_list)
+{
+    if (stage_list_.empty()) {
+        PRINT_E("Not initialized\n");
+        return kRetErr;
+    }
+    const auto& stage_input_tensor_info_list = stage_list_[0]->input_tensor_info_list;
+    if (input_tensor_info_list.size() != stage_input_tensor_info_list.size()) {
+        PRINT_E("Invalid input tensor num\n");
+        return kRetErr;
+    }
+
+    int32_t slot_index = -1;
+    int64_t frame_id = -1;
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return !is_running_ || !free_slot_queue_.empty(); });
+        if (!is_running_) return kRetErr;
+        slot_index = free_slot_queue_.front();
+        free_slot_queue_.pop_front();
+        frame_id = frame_id_++;
+    }
+
+    /* Copy input data into the slot, so that the caller can reuse its buffer */
+    Slot& slot = slot_list_[slot_index];
+    slot.frame_id = frame_id;
+    slot.time_inference = 0;
+    slot.input_tensor_info_list = input_tensor_info_list;
+    slot.data_list.resize(input_tensor_info_list.size());
+    for (size_t i = 0; i < input_tensor_info_list.size(); i++) {
+        const uint8_t* src = static_cast<const uint8_t*>(input_tensor_info_list[i].data);
+        slot.data_list[i].assign(src, src + GetDataSize(input_tensor_info_list[i]));
+        slot.input_tensor_info_list[i].id = stage_input_tensor_info_list[i].id;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stage_list_[0]->queue.push_back(slot_index);
+        num_in_flight_++;
+    }
+    cv_.notify_all();
+    return frame_id;
+}
+
+int32_t InferencePipeline::Pop(Output& output)
+{
+    int32_t slot_index = -1;
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (num_in_flight_ == 0) {
+            PRINT_E("No frame in the pipeline\n");
+            return kRetErr;
+        }
+        cv_.wait(lock, [this] { return !is_running_ || !done_slot_queue_.empty(); });
+        if (!is_running_) return kRetErr;
+        slot_index = done_slot_queue_.front();
+        done_slot_queue_.pop_front();
+    }
+
+    /* Swap instead of copy. The buffers given back to the slot are reused for the next frame */
+    Slot& slot = slot_list_[slot_index];
+    output.frame_id = slot.frame_id;
+    output.time_inference = slot.time_inference;
+    output.data_list.swap(slot.data_list);
+    const bool is_ok = !output.data_list.empty();
+
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        free_slot_queue_.push_back(slot_index);
+        num_in_flight_--;
+    }
+    cv_.notify_all();
+    return is_ok ? kRetOk : kRetErr;
+}
+
+int32_t InferencePipeline::GetNumInFlight()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return num_in_flight_;
+}
+
+void InferencePipeline::ThreadStage(int32_t stage_index)
+{
+    Stage& stage = *stage_list_[stage_index];
+    const bool is_first = (stage_index == 0);
+    const bool is_last = (stage_index == static_cast<int32_t>(stage_list_.size()) - 1);
+    ComputeResourceManager::SetCurrentThreadAffinity(stage.cpu_list);
+
+    while (true) {
+        int32_t slot_index = -1;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this, &stage] { return !is_running_ || !stage.queue.empty(); });
+            if (!is_running_) break;
+            slot_index = stage.queue.front();
+            stage.queue.pop_front();
+        }
+
+        /* The slot is owned by this stage until it's passed to the next stage */
+        Slot& slot = slot_list_[slot_index];
+        if (!slot.data_list.empty() && ProcessStage(stage, slot, is_first) != kRetOk) {
+            PRINT_E("Failed in segment %d (frame %lld)\n", stage_index, static_cast<long long>(slot.frame_id));
+            slot.data_list.clear();     /* error is returned by Pop */
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (is_last) {
+                done_slot_queue_.push_back(slot_index);
+            } else {
+                stage_list_[stage_index + 1]->queue.push_back(slot_index);
+            }
+        }
+        cv_.notify_all();
+    }
+}
+
+int32_t InferencePipeline::ProcessStage(Stage& stage, Slot& slot, bool is_first)
+{
+    const auto& t0 = std::chrono::steady_clock::now();
+    std::vector<InputTensorInfo>& input_tensor_info_list = is_first ? slot.input_tensor_info_list : stage.input_tensor_info_list;
+    if (slot.data_list.size() != input_tensor_info_list.size()) {
+        return kRetErr;
+    }
+    for (size_t i = 0; i < input_tensor_info_list.size(); i++) {
+        input_tensor_info_list[i].data = slot.data_list[i].data();
+    }
+    if (stage.inference_helper->PreProcess(input_tensor_info_list) != InferenceHelper::kRetOk) {
+        return kRetErr;
+    }
+    if (stage.inference_helper->Process(stage.output_tensor_info_list) != InferenceHelper::kRetOk) {
+        return kRetErr;
+    }
+
+    /* The input is no longer needed, so the output overwrites it (capacity is kept across frames) */
+    slot.data_list.resize(stage.output_tensor_info_list.size());
+    for (size_t i = 0; i < stage.output_tensor_info_list.size(); i++) {
+        const OutputTensorInfo& output_tensor_info = stage.output_tensor_info_list[i];
+        const uint8_t* src = static_cast<const uint8_t*>(output_tensor_info.data);
+        slot.data_list[i].assign(src, src + output_tensor_info.GetElementNum() * GetElementSize(output_tensor_info.tensor_type));
+    }
+    const auto& t1 = std::chrono::steady_clock::now();
+    slot.time_inference += static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000.0;
+    return kRetOk;
+}
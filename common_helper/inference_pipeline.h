@@ -0,0 +1,118 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef INFERENCE_PIPELINE_
+#define INFERENCE_PIPELINE_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* for My modules */
+#include "inference_helper.h"
+
+/***
+* Pipeline parallel inference on CPU
+*   - a large model is split into N segments in advance (e.g. seg_0_of_2.tflite, seg_1_of_2.tflite)
+*   - each segment has its own InferenceHelper, thread and cores, and frames are streamed through them
+*   - intermediate tensors are copied into a ring of slots (queue_size), so segment[i] works on frame[n] while segment[i+1] works on frame[n-1]
+*   - output tensors of segment[i] are fed to input tensors of segment[i+1] in the same order (the split must keep the tensor types / quantization)
+*   - throughput becomes roughly max(segment time) instead of sum(segment time). latency is not reduced
+* Usage:
+*   pipeline.Initialize(segment_list, queue_size);
+*   pipeline.Push(input_tensor_info_list);   // input of the first segment. data is copied, so it can be reused after return
+*   pipeline.Pop(output);                    // output of the last segment, in the pushed order
+* Note:
+*   Requires InferenceHelper. Enable COMMON_HELPER_WITH_INFERENCE_HELPER in CMake
+***/
+class InferencePipeline {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+    typedef struct Segment_ {
+        std::string                    model_filename;
+        InferenceHelper::HelperType    helper_type;
+        int32_t                        num_threads;
+        std::vector<int32_t>           cpu_list;                    // cores to run this segment (empty = no affinity. Linux only). see ComputeResourceManager
+        std::vector<InputTensorInfo>   input_tensor_info_list;      // for the first segment, the same as a single model. for others, data is set by the pipeline
+        std::vector<OutputTensorInfo>  output_tensor_info_list;
+        Segment_() : helper_type(InferenceHelper::kTensorflowLite), num_threads(1) {}
+    } Segment;
+
+    typedef struct Output_ {
+        int64_t                            frame_id;
+        std::vector<std::vector<uint8_t>>  data_list;               // raw data of the output tensors of the last segment. see GetOutputTensorInfoList for type and quantization
+        double                             time_inference;          // [msec] sum of all segments
+        Output_() : frame_id(-1), time_inference(0) {}
+    } Output;
+
+public:
+    InferencePipeline() : is_running_(false), frame_id_(0), num_in_flight_(0) {}
+    ~InferencePipeline() { Finalize(); }
+    int32_t Initialize(const std::vector<Segment>& segment_list, int32_t queue_size);
+    int32_t Finalize(void);
+
+    /* Returns frame id. Blocks while all slots are in use */
+    int64_t Push(const std::vector<InputTensorInfo>& input_tensor_info_list);
+    /* Blocks until the oldest frame is done */
+    int32_t Pop(Output& output);
+    int32_t GetNumInFlight();
+    int32_t GetSegmentNum() const { return static_cast<int32_t>(stage_list_.size()); }
+    const std::vector<OutputTensorInfo>& GetOutputTensorInfoList() const { return stage_list_.back()->output_tensor_info_list; }
+
+    /* e.g. "model/midas" -> "model/midas_segment_0_of_2.tflite" */
+    static std::string GetSegmentModelFilename(const std::string& filename_base, int32_t index, int32_t num);
+
+private:
+    typedef struct Slot_ {
+        int64_t                            frame_id;
+        std::vector<InputTensorInfo>       input_tensor_info_list;  // for the first segment
+        std::vector<std::vector<uint8_t>>  data_list;               // input data of the current segment. overwritten by its output
+        double                             time_inference;
+    } Slot;
+
+    typedef struct Stage_ {
+        std::unique_ptr<InferenceHelper>  inference_helper;
+        std::vector<InputTensorInfo>      input_tensor_info_list;
+        std::vector<OutputTensorInfo>     output_tensor_info_list;
+        std::vector<int32_t>              cpu_list;
+        std::deque<int32_t>               queue;                    // slot index to be processed
+        std::thread                       thread;
+    } Stage;
+
+    void ThreadStage(int32_t stage_index);
+    int32_t ProcessStage(Stage& stage, Slot& slot, bool is_first);
+
+private:
+    std::vector<std::unique_ptr<Stage>> stage_list_;
+    std::vector<Slot>   slot_list_;
+    std::deque<int32_t> free_slot_queue_;
+    std::deque<int32_t> done_slot_queue_;
+    std::mutex              mtx_;
+    std::condition_variable cv_;
+    bool    is_running_;
+    int64_t frame_id_;
+    int32_t num_in_flight_;
+};
+
+#endif
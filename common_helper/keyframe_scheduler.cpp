@@ -0,0 +1,210 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <chrono>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "common_helper.h"
+#include "keyframe_scheduler.h"
+
+/*** Macro ***/
+#define TAG "KeyframeScheduler"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+
+KeyframeScheduler::KeyframeScheduler(int32_t keyframe_interval, float threshold_motion, float threshold_scene_change, int32_t flow_width)
+{
+    keyframe_interval_ = (std::max)(1, keyframe_interval);
+    threshold_motion_ = threshold_motion;
+    threshold_scene_change_ = threshold_scene_change;
+    flow_width_ = flow_width;
+    dis_ = cv::DISOpticalFlow::create(cv::DISOpticalFlow::PRESET_ULTRAFAST);
+    Reset();
+}
+
+void KeyframeScheduler::Reset()
+{
+    frame_size_ = cv::Size();
+    gray_prev_.release();
+    flow_.release();
+    is_flow_valid_ = false;
+    motion_energy_ = 0.0f;
+    scene_change_energy_ = 0.0f;
+    frame_cnt_from_keyframe_ = 0;
+    result_list_.clear();
+    interpolation_ = cv::INTER_LINEAR;
+    crop_ = cv::Rect();
+    time_check_ = 0;
+    time_propagate_ = 0;
+}
+
+int32_t KeyframeScheduler::Process(const cv::Mat& frame, const InferenceFunction& inference, std::vector<cv::Mat>& result_list, int32_t interpolation)
+{
+    time_check_ = 0;
+    time_propagate_ = 0;
+    const auto& t0 = std::chrono::steady_clock::now();
+    const bool is_keyframe = CheckKeyframe(frame);
+    const auto& t1 = std::chrono::steady_clock::now();
+    time_check_ = static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000.0;
+
+    if (is_keyframe) {
+        cv::Rect crop;
+        if (inference(result_list, crop) != 0) {
+            return -1;
+        }
+        SetKeyframeResult(result_list, interpolation, crop);
+    } else {
+        Propagate(result_list);
+        time_propagate_ = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - t1).count() * 1000.0;
+        if (result_list.empty()) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void KeyframeScheduler::CreateGray(const cv::Mat& frame, cv::Mat& gray)
+{
+    /* Resize first, then convert color, to reduce calculation */
+    cv::Mat small;
+    const int32_t width = (std::min)(flow_width_, frame.cols);
+    const int32_t height = (std::max)(1, frame.rows * width / frame.cols);
+    cv::resize(frame, small, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+    if (small.channels() == 3) {
+        cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+    } else if (small.channels() == 4) {
+        cv::cvtColor(small, gray, cv::COLOR_BGRA2GRAY);
+    } else {
+        gray = small;
+    }
+}
+
+bool KeyframeScheduler::CheckKeyframe(const cv::Mat& frame)
+{
+    if (keyframe_interval_ <= 1) {
+        /* Every frame is a keyframe. Nothing to calculate */
+        return true;
+    }
+
+    cv::Mat gray;
+    CreateGray(frame, gray);
+
+    bool is_keyframe = false;
+    is_flow_valid_ = false;
+    if (result_list_.empty() || gray_prev_.empty() || frame.size() != frame_size_) {
+        /* No prediction to propagate */
+        is_keyframe = true;
+    } else if (frame_cnt_from_keyframe_ + 1 >= keyframe_interval_) {
+        is_keyframe = true;
+    } else {
+        /* Scene change is checked first because it's cheaper than optical flow */
+        scene_change_energy_ = static_cast<float>(cv::norm(gray, gray_prev_, cv::NORM_L1) / gray.total());
+        if (scene_change_energy_ > threshold_scene_change_) {
+            is_keyframe = true;
+        } else {
+            dis_->calc(gray, gray_prev_, flow_);
+            const cv::Scalar flow_mean = cv::mean(cv::abs(flow_));
+            motion_energy_ = static_cast<float>(flow_mean[0] + flow_mean[1]);
+            if (motion_energy_ > threshold_motion_) {
+                is_keyframe = true;
+            } else {
+                is_flow_valid_ = true;
+            }
+        }
+    }
+
+    frame_size_ = frame.size();
+    gray_prev_ = gray;
+    if (is_keyframe) {
+        frame_cnt_from_keyframe_ = 0;
+    } else {
+        frame_cnt_from_keyframe_++;
+    }
+    return is_keyframe;
+}
+
+void KeyframeScheduler::SetKeyframeResult(const std::vector<cv::Mat>& result_list, int32_t interpolation, const cv::Rect& crop)
+{
+    if (keyframe_interval_ <= 1) {
+        /* Never propagated. Don't copy */
+        crop_ = crop;
+        return;
+    }
+
+    result_list_.resize(result_list.size());
+    for (size_t i = 0; i < result_list.size(); i++) {
+        result_list[i].copyTo(result_list_[i]);     /* the result may refer to the output tensor */
+    }
+    interpolation_ = interpolation;
+    crop_ = crop.area() > 0 ? crop : cv::Rect(0, 0, frame_size_.width, frame_size_.height);
+}
+
+void KeyframeScheduler::Propagate(std::vector<cv::Mat>& result_list)
+{
+    if (!is_flow_valid_) {
+        PRINT_E("Flow is not calculated. Inference is required for this frame\n");
+        result_list.clear();
+        return;
+    }
+
+    /* Create map for each prediction size (usually all the predictions have the same size) */
+    cv::Size map_size;
+    cv::Mat map;
+    for (auto& result : result_list_) {
+        if (result.size() != map_size) {
+            map_size = result.size();
+            /* Position of each prediction pixel in the flow image */
+            const float scale_x = static_cast<float>(crop_.width) / map_size.width * flow_.cols / frame_size_.width;
+            const float scale_y = static_cast<float>(crop_.height) / map_size.height * flow_.rows / frame_size_.height;
+            const float offset_x = static_cast<float>(crop_.x) * flow_.cols / frame_size_.width;
+            const float offset_y = static_cast<float>(crop_.y) * flow_.rows / frame_size_.height;
+            cv::Mat map_to_flow(map_size, CV_32FC2);
+            for (int32_t y = 0; y < map_size.height; y++) {
+                cv::Vec2f* p = map_to_flow.ptr<cv::Vec2f>(y);
+                for (int32_t x = 0; x < map_size.width; x++) {
+                    p[x] = cv::Vec2f((x + 0.5f) * scale_x + offset_x - 0.5f, (y + 0.5f) * scale_y + offset_y - 0.5f);
+                }
+            }
+
+            /* Flow at each prediction pixel, then convert to the previous position in the prediction */
+            cv::remap(flow_, map, map_to_flow, cv::Mat(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+            for (int32_t y = 0; y < map_size.height; y++) {
+                cv::Vec2f* p = map.ptr<cv::Vec2f>(y);
+                for (int32_t x = 0; x < map_size.width; x++) {
+                    p[x] = cv::Vec2f(x + p[x][0] / scale_x, y + p[x][1] / scale_y);
+                }
+            }
+        }
+        cv::Mat warped;
+        cv::remap(result, warped, map, cv::Mat(), interpolation_, cv::BORDER_REPLICATE);
+        result = warped;
+    }
+
+    /* The propagated prediction is used for the next frame. Return copies because the caller may modify them */
+    result_list.resize(result_list_.size());
+    for (size_t i = 0; i < result_list_.size(); i++) {
+        result_list[i] = result_list_[i].clone();
+    }
+}
@@ -0,0 +1,101 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef KEYFRAME_SCHEDULER_
+#define KEYFRAME_SCHEDULER_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <array>
+#include <functional>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/***
+* Run dense prediction (segmentation, depth, edge, ...) only on keyframes, and propagate the last prediction with optical flow on the other frames
+*   - keyframe: every keyframe_interval frames, or when the scene changes / moves more than threshold
+*   - optical flow (DIS) is calculated on downsampled gray images
+*   - keyframe_interval = 1 (default): every frame is a keyframe and nothing is calculated nor copied
+* Usage:
+*   std::vector<cv::Mat> result_list;
+*   scheduler.Process(frame, [&](std::vector<cv::Mat>& keyframe_result_list, cv::Rect& crop) {
+*       if (engine->Process(frame, result) != kRetOk) return -1;
+*       keyframe_result_list = { result.mat_out };
+*       return 0;
+*   }, result_list);
+*   result.mat_out = result_list[0];    // prediction of the keyframe, or propagated one
+***/
+class KeyframeScheduler {
+public:
+    /* Run inference for the keyframe, and set the prediction to register. Set the area in frame that the prediction covers to crop (keep it empty for whole frame). Returns 0 on success */
+    typedef std::function<int32_t(std::vector<cv::Mat>& result_list, cv::Rect& crop)> InferenceFunction;
+
+public:
+    KeyframeScheduler(int32_t keyframe_interval = 1, float threshold_motion = 1.0f, float threshold_scene_change = 20.0f, int32_t flow_width = 160);
+    ~KeyframeScheduler() {}
+    void Reset();
+
+    /* CheckKeyframe, then inference and SetKeyframeResult for keyframe, or Propagate for the other frames. Returns 0 on success */
+    /*   result_list: prediction for the frame */
+    int32_t Process(const cv::Mat& frame, const InferenceFunction& inference, std::vector<cv::Mat>& result_list, int32_t interpolation = cv::INTER_LINEAR);
+
+    /* Call for every frame. Returns true if inference needs to be run for the frame */
+    bool CheckKeyframe(const cv::Mat& frame);
+
+    /* Register the prediction of the keyframe. The list is copied */
+    /*   interpolation: cv::INTER_NEAREST for label map, cv::INTER_LINEAR for score/depth */
+    /*   crop: area in frame that the prediction covers (it can be out of the frame when padding is used). empty = whole frame */
+    void SetKeyframeResult(const std::vector<cv::Mat>& result_list, int32_t interpolation = cv::INTER_LINEAR, const cv::Rect& crop = cv::Rect());
+
+    /* Warp the last prediction to the current frame. Call instead of inference when CheckKeyframe returns false */
+    void Propagate(std::vector<cv::Mat>& result_list);
+
+    float GetMotionEnergy() const { return motion_energy_; }            /* mean flow magnitude [px in the downsampled image] */
+    float GetSceneChangeEnergy() const { return scene_change_energy_; } /* mean absolute difference [0 - 255] */
+    int32_t GetFrameCountFromKeyframe() const { return frame_cnt_from_keyframe_; }
+    const cv::Rect& GetKeyframeCrop() const { return crop_; }
+    double GetTimeCheck() const { return time_check_; }             /* [msec] CheckKeyframe in the last Process */
+    double GetTimePropagate() const { return time_propagate_; }     /* [msec] Propagate in the last Process */
+
+private:
+    void CreateGray(const cv::Mat& frame, cv::Mat& gray);
+
+private:
+    int32_t keyframe_interval_;
+    float threshold_motion_;
+    float threshold_scene_change_;
+    int32_t flow_width_;
+    cv::Ptr<cv::DISOpticalFlow> dis_;
+
+    cv::Size frame_size_;
+    cv::Mat gray_prev_;
+    cv::Mat flow_;      /* CV_32FC2, current -> previous in the downsampled image */
+    bool is_flow_valid_;
+    float motion_energy_;
+    float scene_change_energy_;
+    int32_t frame_cnt_from_keyframe_;
+
+    std::vector<cv::Mat> result_list_;
+    int32_t interpolation_;
+    cv::Rect crop_;
+
+    double time_check_;
+    double time_propagate_;
+};
+
+#endif
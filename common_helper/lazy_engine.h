@@ -0,0 +1,187 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef LAZY_ENGINE_
+#define LAZY_ENGINE_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <fstream>
+
+/* for My modules */
+#include "common_helper.h"
+#include "compute_resource_manager.h"
+
+/***
+* Lazy initialization of an engine which is needed only sometimes (the second stage of a cascade)
+*   - nothing is loaded at Setup. It only checks that the model file is readable, so that a missing model is reported by ImageProcessor::Initialize
+*   - the engine is created and initialized when it's needed for the first time (Get or Prepare)
+*   - is_async (default: true): initialization runs on a background thread while the first stage keeps running. Get returns nullptr until it's ready
+*   - idle_timeout [msec] (default: 0 = keep loaded): the engine is finalized (interpreter, arena and threads are released) when it's not used for this time
+*   - when the initialization fails at the first use, Get returns nullptr and IsError returns true
+*   - the loader thread runs on the cores of the budget, so worker threads of the interpreter get the same affinity as when created in Initialize
+*   - T needs Finalize(), kRetOk and static GetModelFilename(work_dir), and Initialize(work_dir, num_threads) unless an initialize function is given
+*   - not thread safe. Call from one thread (or under a mutex)
+* Usage:
+*   LazyEngine<FacemeshEngine> s_facemesh_engine;
+*   if (s_facemesh_engine.Setup(work_dir, resource_manager.Reserve("FacemeshEngine", num_threads)) != LazyEngine<FacemeshEngine>::kRetOk) return -1;  // ImageProcessor::Initialize
+*   FacemeshEngine* engine = face_list.empty() ? nullptr : s_facemesh_engine.Get();   // ImageProcessor::Process
+*   if (s_facemesh_engine.IsError()) return -1;
+*   if (engine) engine->Process(...);
+*   s_facemesh_engine.CheckIdle();      // once per frame
+*   s_facemesh_engine.Release();        // ImageProcessor::Finalize
+***/
+template <typename T>
+class LazyEngine {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+    typedef enum {
+        kStateUnloaded,
+        kStateLoading,
+        kStateLoaded,
+        kStateError,
+    } State;
+
+    /* Returns T::kRetOk on success */
+    typedef std::function<int32_t(T& engine)> InitializeFunction;
+
+public:
+    LazyEngine() : idle_timeout_(0), is_async_(true), is_setup_(false), state_(kStateUnloaded) {}
+    ~LazyEngine() { Release(); }
+
+    int32_t Setup(const std::string& work_dir, const ComputeResourceManager::Budget& budget, int32_t idle_timeout = 0, bool is_async = true)
+    {
+        const int32_t num_threads = budget.num_threads;
+        return Setup([work_dir, num_threads](T& engine) { return engine.Initialize(work_dir, num_threads); }, T::GetModelFilename(work_dir), budget, idle_timeout, is_async);
+    }
+
+    /* Without affinity (the loader thread inherits it from the caller) */
+    int32_t Setup(const std::string& work_dir, int32_t num_threads, int32_t idle_timeout = 0, bool is_async = true)
+    {
+        ComputeResourceManager::Budget budget;
+        budget.num_threads = num_threads;
+        return Setup(work_dir, budget, idle_timeout, is_async);
+    }
+
+    int32_t Setup(const InitializeFunction& initialize, const std::string& model_filename, const ComputeResourceManager::Budget& budget, int32_t idle_timeout = 0, bool is_async = true)
+    {
+        Release();
+        if (!std::ifstream(model_filename, std::ios::binary).good()) {
+            COMMON_HELPER_PRINT_E("LazyEngine", "Model file not found: %s\n", model_filename.c_str());
+            return kRetErr;
+        }
+        initialize_ = initialize;
+        budget_ = budget;
+        idle_timeout_ = idle_timeout;
+        is_async_ = is_async;
+        is_setup_ = true;
+        return kRetOk;
+    }
+
+    bool IsSetup() const { return is_setup_; }
+    bool IsLoaded() const { return state_ == kStateLoaded; }
+    /* Initialization failed at the first use. It's not retried */
+    bool IsError() const { return state_ == kStateError; }
+
+    /* Start loading if not loaded yet (e.g. when the first stage finds a candidate, before the engine is actually used) */
+    void Prepare()
+    {
+        if (!is_setup_ || state_ != kStateUnloaded) return;
+        state_ = kStateLoading;
+        if (is_async_) {
+            loader_ = std::thread(&LazyEngine::Load, this);
+        } else {
+            Load();
+        }
+    }
+
+    /* Returns nullptr while loading (is_async) or when initialization failed */
+    T* Get()
+    {
+        Prepare();
+        if (state_ == kStateLoading) return nullptr;
+        if (loader_.joinable()) loader_.join();
+        if (state_ != kStateLoaded) return nullptr;
+        time_last_used_ = std::chrono::steady_clock::now();
+        return engine_.get();
+    }
+
+    /* Call once per frame. Unloads the engine after idle_timeout */
+    void CheckIdle()
+    {
+        if (idle_timeout_ <= 0 || state_ != kStateLoaded) return;
+        const auto& time_now = std::chrono::steady_clock::now();
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(time_now - time_last_used_).count() > idle_timeout_) {
+            COMMON_HELPER_PRINT("LazyEngine", "Unload engine after %d [msec] idle\n", idle_timeout_);
+            Unload();
+        }
+    }
+
+    /* Waits for loading, and finalizes the engine */
+    void Release()
+    {
+        Unload();
+        is_setup_ = false;
+    }
+
+private:
+    void Load()
+    {
+        ComputeResourceManager::ScopedAffinity affinity(budget_.cpu_list);
+        std::unique_ptr<T> engine(new T());
+        if (initialize_(*engine) != T::kRetOk) {
+            COMMON_HELPER_PRINT_E("LazyEngine", "Engine initialization error\n");
+            engine->Finalize();
+            state_ = kStateError;
+            return;
+        }
+        engine_ = std::move(engine);
+        time_last_used_ = std::chrono::steady_clock::now();
+        state_ = kStateLoaded;
+    }
+
+    void Unload()
+    {
+        if (loader_.joinable()) loader_.join();
+        if (engine_) {
+            engine_->Finalize();
+            engine_.reset();
+        }
+        state_ = kStateUnloaded;
+    }
+
+private:
+    InitializeFunction initialize_;
+    ComputeResourceManager::Budget budget_;
+    int32_t idle_timeout_;
+    bool is_async_;
+    bool is_setup_;
+
+    std::unique_ptr<T> engine_;
+    std::thread loader_;
+    std::atomic<int32_t> state_;
+    std::chrono::steady_clock::time_point time_last_used_;
+};
+
+#endif
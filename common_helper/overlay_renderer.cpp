@@ -0,0 +1,277 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "common_helper.h"
+#include "common_helper_cv.h"
+#include "overlay_renderer.h"
+
+/*** Macro ***/
+#define TAG "OverlayRenderer"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Function ***/
+void OverlayRenderer::DrawList::Clear()
+{
+    overlay_list.clear();
+    shape_list.clear();
+    text_list.clear();
+}
+
+void OverlayRenderer::DrawList::AddOverlay(const cv::Mat& image, const cv::Rect& area, BlendType blend_type, float alpha)
+{
+    if (image.empty() || image.type() != CV_8UC3 || area.area() <= 0) {
+        PRINT_E("Invalid overlay\n");
+        return;
+    }
+    overlay_list.push_back({ image, area, blend_type, alpha });
+}
+
+void OverlayRenderer::DrawList::AddRect(const cv::Rect& rect, const cv::Scalar& color, int32_t thickness)
+{
+    shape_list.push_back({ 0, rect.tl(), rect.br() - cv::Point(1, 1), color, thickness });
+}
+
+void OverlayRenderer::DrawList::AddLine(const cv::Point& p0, const cv::Point& p1, const cv::Scalar& color, int32_t thickness)
+{
+    shape_list.push_back({ 1, p0, p1, color, thickness });
+}
+
+void OverlayRenderer::DrawList::AddCircle(const cv::Point& center, int32_t radius, const cv::Scalar& color, int32_t thickness)
+{
+    shape_list.push_back({ 2, center, cv::Point(radius, 0), color, thickness });
+}
+
+void OverlayRenderer::DrawList::AddText(const std::string& text, const cv::Point& pos, double font_scale, int32_t thickness, const cv::Scalar& color_front, const cv::Scalar& color_back, bool is_text_on_rect)
+{
+    text_list.push_back({ text, pos, font_scale, thickness, color_front, color_back, is_text_on_rect });
+}
+
+
+OverlayRenderer::Mode OverlayRenderer::ParseMode(const std::string& str)
+{
+    if (str == "off") return kModeOff;
+    if (str == "thread") return kModeThread;
+    return kModeInline;
+}
+
+int32_t OverlayRenderer::Initialize(Mode mode)
+{
+    Finalize();
+    mode_ = mode;
+    has_job_ = false;
+    has_rendered_ = false;
+    if (mode_ == kModeThread) {
+        is_running_ = true;
+        thread_ = std::thread(&OverlayRenderer::ThreadRender, this);
+    }
+    return kRetOk;
+}
+
+int32_t OverlayRenderer::Finalize(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        is_running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    job_frame_.release();
+    job_draw_list_.Clear();
+    return kRetOk;
+}
+
+void OverlayRenderer::Submit(cv::Mat& frame, DrawList& draw_list)
+{
+    switch (mode_) {
+    case kModeOff:
+        break;
+    case kModeInline:
+        Render(frame, draw_list);
+        break;
+    case kModeThread:
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        job_frame_ = frame;     /* share the buffer. the render thread doesn't write into it */
+        std::swap(job_draw_list_, draw_list);
+        has_job_ = true;
+    }
+        cv_.notify_all();
+        break;
+    }
+    draw_list.Clear();
+}
+
+bool OverlayRenderer::GetRendered(cv::Mat& mat)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!has_rendered_) return false;
+    mat = mat_rendered_.clone();    /* new buffer, so that it's safe even if mat shares the buffer of a submitted frame */
+    return true;
+}
+
+void OverlayRenderer::ThreadRender()
+{
+    DrawList draw_list;
+    while (true) {
+        cv::Mat frame;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [this] { return !is_running_ || has_job_; });
+            if (!is_running_) break;
+            frame = job_frame_;
+            job_frame_.release();
+            std::swap(draw_list, job_draw_list_);
+            has_job_ = false;
+        }
+
+        /* Render into own buffer (allocation is reused), then swap it with the rendered one */
+        frame.copyTo(mat_work_);
+        frame.release();
+        Render(mat_work_, draw_list);
+        draw_list.Clear();
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            cv::swap(mat_work_, mat_rendered_);
+            has_rendered_ = true;
+        }
+    }
+}
+
+void OverlayRenderer::Render(cv::Mat& mat, const DrawList& draw_list)
+{
+    if (mat.empty()) return;
+    BlendOverlayList(mat, draw_list.overlay_list);
+
+    for (const auto& shape : draw_list.shape_list) {
+        switch (shape.type) {
+        case 0:
+            cv::rectangle(mat, shape.p0, shape.p1, shape.color, shape.thickness);
+            break;
+        case 1:
+            cv::line(mat, shape.p0, shape.p1, shape.color, shape.thickness);
+            break;
+        case 2:
+            cv::circle(mat, shape.p0, shape.p1.x, shape.color, shape.thickness);
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (const auto& text : draw_list.text_list) {
+        CommonHelper::DrawText(mat, text.text, text.pos, text.font_scale, text.thickness, text.color_front, text.color_back, text.is_text_on_rect);
+    }
+}
+
+/* All overlays are blended row by row in one pass, sampling each overlay bilinearly (fixed point) without creating resized images */
+void OverlayRenderer::BlendOverlayList(cv::Mat& mat, const std::vector<DrawList::Overlay>& overlay_list)
+{
+    static constexpr int32_t kShift = 8;
+    static constexpr int32_t kOne = 1 << kShift;
+    typedef struct {
+        const DrawList::Overlay* overlay;
+        cv::Rect area;          // clipped by the frame
+        int32_t alpha;          // [0, kOne]
+        std::vector<int32_t> x0_list;
+        std::vector<int32_t> x1_list;
+        std::vector<int32_t> wx_list;
+        std::vector<int32_t> y0_list;
+        std::vector<int32_t> y1_list;
+        std::vector<int32_t> wy_list;
+    } Sampler;
+
+    if (overlay_list.empty() || mat.type() != CV_8UC3) return;
+    const cv::Rect frame_area(0, 0, mat.cols, mat.rows);
+
+    /* Sampling position of the overlay for each column/row in the frame */
+    auto create_table = [](int32_t dst_start, int32_t dst_end, int32_t area_start, int32_t area_size, int32_t src_size,
+        std::vector<int32_t>& i0_list, std::vector<int32_t>& i1_list, std::vector<int32_t>& w_list) {
+        const float scale = static_cast<float>(src_size) / area_size;
+        for (int32_t d = dst_start; d < dst_end; d++) {
+            float s = (d - area_start + 0.5f) * scale - 0.5f;
+            s = (std::max)(0.0f, (std::min)(static_cast<float>(src_size - 1), s));
+            const int32_t i0 = static_cast<int32_t>(s);
+            i0_list.push_back(i0);
+            i1_list.push_back((std::min)(i0 + 1, src_size - 1));
+            w_list.push_back(static_cast<int32_t>((s - i0) * kOne));
+        }
+    };
+
+    std::vector<Sampler> sampler_list;
+    int32_t y_start = mat.rows;
+    int32_t y_end = 0;
+    for (const auto& overlay : overlay_list) {
+        Sampler sampler;
+        sampler.overlay = &overlay;
+        sampler.area = overlay.area & frame_area;
+        if (sampler.area.area() <= 0) continue;
+        sampler.alpha = static_cast<int32_t>((std::max)(0.0f, (std::min)(1.0f, overlay.alpha)) * kOne);
+        create_table(sampler.area.x, sampler.area.br().x, overlay.area.x, overlay.area.width, overlay.image.cols, sampler.x0_list, sampler.x1_list, sampler.wx_list);
+        create_table(sampler.area.y, sampler.area.br().y, overlay.area.y, overlay.area.height, overlay.image.rows, sampler.y0_list, sampler.y1_list, sampler.wy_list);
+        y_start = (std::min)(y_start, sampler.area.y);
+        y_end = (std::max)(y_end, sampler.area.br().y);
+        sampler_list.push_back(std::move(sampler));
+    }
+
+#pragma omp parallel for
+    for (int32_t y = y_start; y < y_end; y++) {
+        uint8_t* dst_row = mat.ptr<uint8_t>(y);
+        for (const auto& sampler : sampler_list) {
+            if (y < sampler.area.y || y >= sampler.area.br().y) continue;
+            const int32_t iy = y - sampler.area.y;
+            const uint8_t* src_row0 = sampler.overlay->image.ptr<uint8_t>(sampler.y0_list[iy]);
+            const uint8_t* src_row1 = sampler.overlay->image.ptr<uint8_t>(sampler.y1_list[iy]);
+            const int32_t wy = sampler.wy_list[iy];
+            const bool is_add = sampler.overlay->blend_type == kBlendAdd;
+            for (int32_t ix = 0; ix < sampler.area.width; ix++) {
+                const int32_t x0 = sampler.x0_list[ix] * 3;
+                const int32_t x1 = sampler.x1_list[ix] * 3;
+                const int32_t wx = sampler.wx_list[ix];
+                uint8_t* dst = dst_row + (sampler.area.x + ix) * 3;
+                int32_t color[3];
+                for (int32_t c = 0; c < 3; c++) {
+                    const int32_t top = src_row0[x0 + c] * (kOne - wx) + src_row0[x1 + c] * wx;
+                    const int32_t bottom = src_row1[x0 + c] * (kOne - wx) + src_row1[x1 + c] * wx;
+                    color[c] = (top * (kOne - wy) + bottom * wy) >> (kShift * 2);
+                }
+                if (is_add) {
+                    for (int32_t c = 0; c < 3; c++) {
+                        dst[c] = static_cast<uint8_t>((std::min)(255, dst[c] + color[c]));
+                    }
+                } else if (color[0] | color[1] | color[2]) {
+                    for (int32_t c = 0; c < 3; c++) {
+                        dst[c] = static_cast<uint8_t>((dst[c] * (kOne - sampler.alpha) + color[c] * sampler.alpha) >> kShift);
+                    }
+                }
+            }
+        }
+    }
+}
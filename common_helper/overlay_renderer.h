@@ -0,0 +1,141 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef OVERLAY_RENDERER_
+#define OVERLAY_RENDERER_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/***
+* Rendering layer separated from image processing
+*   - ImageProcessor records what to draw into DrawList (cheap), instead of drawing on the frame
+*   - OverlayRenderer draws it on the frame: inline, on its own thread, or not at all (headless)
+*   - overlays (segmentation mask etc.) are composited in one pass over the frame, sampling the low resolution overlay image directly (bilinear)
+* Usage:
+*   draw_list.AddOverlay(mat_color_mask_model_size, crop, OverlayRenderer::kBlendAdd);
+*   draw_list.AddRect(rect, color, 2);
+*   renderer.Submit(frame, draw_list);          // kModeInline: frame is drawn here
+*   renderer.GetRendered(mat_display);          // kModeThread: the latest rendered frame
+***/
+class OverlayRenderer {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+    typedef enum {
+        kModeOff,
+        kModeInline,
+        kModeThread,
+    } Mode;
+
+    typedef enum {
+        kBlendAdd,      // dst = saturate(dst + overlay)
+        kBlendAlpha,    // dst = dst * (1 - alpha) + overlay * alpha. black (0, 0, 0) in overlay is transparent
+    } BlendType;
+
+    class DrawList {
+    public:
+        typedef struct {
+            int32_t    type;        // 0: rect, 1: line, 2: circle
+            cv::Point  p0;
+            cv::Point  p1;          // rect: bottom right (inclusive), circle: (radius, 0)
+            cv::Scalar color;
+            int32_t    thickness;
+        } Shape;
+
+        typedef struct {
+            std::string text;
+            cv::Point   pos;
+            double      font_scale;
+            int32_t     thickness;
+            cv::Scalar  color_front;
+            cv::Scalar  color_back;
+            bool        is_text_on_rect;
+        } Text;
+
+        typedef struct {
+            cv::Mat     image;      // CV_8UC3. any size. it's resized to area while compositing. shared, not copied
+            cv::Rect    area;       // area in the frame
+            BlendType   blend_type;
+            float       alpha;
+        } Overlay;
+
+    public:
+        void Clear();
+        bool Empty() const { return overlay_list.empty() && shape_list.empty() && text_list.empty(); }
+        void AddOverlay(const cv::Mat& image, const cv::Rect& area, BlendType blend_type, float alpha = 1.0f);
+        void AddRect(const cv::Rect& rect, const cv::Scalar& color, int32_t thickness = 1);
+        void AddLine(const cv::Point& p0, const cv::Point& p1, const cv::Scalar& color, int32_t thickness = 1);
+        void AddCircle(const cv::Point& center, int32_t radius, const cv::Scalar& color, int32_t thickness = 1);
+        void AddText(const std::string& text, const cv::Point& pos, double font_scale, int32_t thickness, const cv::Scalar& color_front, const cv::Scalar& color_back, bool is_text_on_rect = true);
+
+    public:
+        /* drawn in this order */
+        std::vector<Overlay> overlay_list;
+        std::vector<Shape>   shape_list;
+        std::vector<Text>    text_list;
+    };
+
+public:
+    OverlayRenderer() : mode_(kModeInline), is_running_(false), has_job_(false), has_rendered_(false) {}
+    ~OverlayRenderer() { Finalize(); }
+    int32_t Initialize(Mode mode);
+    int32_t Finalize(void);
+    Mode GetMode() const { return mode_; }
+
+    /* kModeInline: draw on frame. kModeThread: frame is not modified. It's shared with the render thread, so don't overwrite it afterwards. kModeOff: do nothing */
+    /* draw_list is moved (cleared) */
+    void Submit(cv::Mat& frame, DrawList& draw_list);
+    /* kModeThread: clone the latest rendered frame (some frames behind, and frames can be skipped when rendering is slower). Returns false if not available */
+    bool GetRendered(cv::Mat& mat);
+
+    /* Compositor */
+    static void Render(cv::Mat& mat, const DrawList& draw_list);
+
+    /* "off", "inline", "thread" */
+    static Mode ParseMode(const std::string& str);
+
+private:
+    void ThreadRender();
+    static void BlendOverlayList(cv::Mat& mat, const std::vector<DrawList::Overlay>& overlay_list);
+
+private:
+    Mode mode_;
+    std::thread thread_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool is_running_;
+
+    /* the latest submitted job (an older one which is not started yet is dropped) */
+    bool     has_job_;
+    cv::Mat  job_frame_;
+    DrawList job_draw_list_;
+
+    cv::Mat  mat_work_;         // used by the render thread only
+    cv::Mat  mat_rendered_;
+    bool     has_rendered_;
+};
+
+#endif
@@ -0,0 +1,75 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef QUANTIZATION_UTILS_
+#define QUANTIZATION_UTILS_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+/***
+* Post process helpers which work on raw uint8/int8 output tensors, without dequantizing the whole tensor
+*   value_float = (value_quantized - zero_point) * scale  (scale > 0, so the order is the same in both domains)
+* Usage:
+*   QuantizationUtils::ArgMaxTensor(output_tensor_info_list[0], max_index, max_score);
+***/
+namespace QuantizationUtils
+{
+    template<typename T>
+    inline float Dequantize(T value, float scale, int32_t zero_point)
+    {
+        return (static_cast<int32_t>(value) - zero_point) * scale;
+    }
+
+    /* Index of the max value (the first one if there are several) */
+    template<typename T>
+    inline int32_t ArgMax(const T* data, int32_t num)
+    {
+        if (num <= 0) return -1;
+        /* Find the max value first (simple reduction, vectorized by compiler), then its index */
+        T value_max = data[0];
+        for (int32_t i = 1; i < num; i++) {
+            value_max = (std::max)(value_max, data[i]);
+        }
+        for (int32_t i = 0; i < num; i++) {
+            if (data[i] == value_max) return i;
+        }
+        return 0;
+    }
+
+    /* ArgMax of an output tensor (OutputTensorInfo of InferenceHelper). Only the max value is dequantized */
+    template<typename TENSOR_INFO>
+    inline void ArgMaxTensor(TENSOR_INFO& tensor, int32_t& max_index, float& max_score)
+    {
+        const int32_t num = tensor.GetElementNum();
+        if (tensor.tensor_type == TENSOR_INFO::kTensorTypeUint8) {
+            const uint8_t* data = static_cast<const uint8_t*>(tensor.data);
+            max_index = ArgMax(data, num);
+            max_score = Dequantize(data[max_index], tensor.quant.scale, tensor.quant.zero_point);
+        } else if (tensor.tensor_type == TENSOR_INFO::kTensorTypeInt8) {
+            const int8_t* data = static_cast<const int8_t*>(tensor.data);
+            max_index = ArgMax(data, num);
+            max_score = Dequantize(data[max_index], tensor.quant.scale, tensor.quant.zero_point);
+        } else {
+            const float* data = tensor.GetDataAsFloat();
+            max_index = ArgMax(data, num);
+            max_score = data[max_index];
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,76 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef RING_BUFFER_
+#define RING_BUFFER_
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+/* Fixed capacity FIFO. All elements are allocated at construction and push_back overwrites the oldest element when full */
+/* Index 0 is the oldest and size() - 1 is the latest, so it can be used in place of std::deque for a history */
+template <typename T, int32_t N>
+class RingBuffer {
+public:
+    RingBuffer() : head_(0), size_(0) {}
+    ~RingBuffer() {}
+
+    void push_back(const T& data)
+    {
+        if (size_ < N) {
+            buffer_[Wrap(head_ + size_)] = data;
+            size_++;
+        } else {
+            buffer_[head_] = data;
+            head_ = Wrap(head_ + 1);
+        }
+    }
+
+    void pop_front()
+    {
+        if (size_ > 0) {
+            head_ = Wrap(head_ + 1);
+            size_--;
+        }
+    }
+
+    void clear()
+    {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    T& operator[](size_t i) { return buffer_[Wrap(head_ + static_cast<int32_t>(i))]; }
+    const T& operator[](size_t i) const { return buffer_[Wrap(head_ + static_cast<int32_t>(i))]; }
+    T& front() { return buffer_[head_]; }
+    const T& front() const { return buffer_[head_]; }
+    T& back() { return buffer_[Wrap(head_ + size_ - 1)]; }
+    const T& back() const { return buffer_[Wrap(head_ + size_ - 1)]; }
+
+    size_t size() const { return static_cast<size_t>(size_); }
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ == N; }
+    static constexpr size_t capacity() { return static_cast<size_t>(N); }
+
+private:
+    static int32_t Wrap(int32_t i) { return (i >= N) ? i - N : i; }
+
+private:
+    std::array<T, N> buffer_;
+    int32_t head_;
+    int32_t size_;
+};
+
+#endif
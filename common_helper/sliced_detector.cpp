@@ -0,0 +1,225 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "common_helper.h"
+#include "sliced_detector.h"
+
+/*** Macro ***/
+#define TAG "SlicedDetector"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Setting ***/
+static constexpr float kThresholdNmsIou = 0.5f;
+static constexpr int32_t kBorderMargin = 2;     /* [px] a box within this distance from a tile border (not a frame border) is regarded as cut */
+
+
+SlicedDetector::SlicedDetector(int32_t tile_width, int32_t tile_height, float overlap_ratio, bool use_full_frame, int32_t idle_interval, float threshold_fusion)
+{
+    tile_width_ = (std::max)(1, tile_width);
+    tile_height_ = (std::max)(1, tile_height);
+    overlap_ratio_ = (std::min)((std::max)(0.0f, overlap_ratio), 0.9f);
+    use_full_frame_ = use_full_frame;
+    idle_interval_ = (std::max)(1, idle_interval);
+    threshold_fusion_ = threshold_fusion;
+    Reset();
+}
+
+void SlicedDetector::Reset()
+{
+    frame_size_ = cv::Size();
+    tile_list_.clear();
+    tile_active_cnt_list_.clear();
+    is_processed_list_.clear();
+    frame_cnt_ = 0;
+}
+
+/* Tiles are placed evenly so that the first and the last tiles touch the frame border, and the overlap is at least overlap_ratio */
+static void CreatePositionList(int32_t frame_size, int32_t tile_size, float overlap_ratio, std::vector<int32_t>& position_list)
+{
+    position_list.clear();
+    if (frame_size <= tile_size) {
+        position_list.push_back(0);
+        return;
+    }
+    const int32_t step = (std::max)(1, static_cast<int32_t>(tile_size * (1.0f - overlap_ratio)));
+    const int32_t num = (frame_size - tile_size + step - 1) / step + 1;
+    for (int32_t i = 0; i < num; i++) {
+        position_list.push_back(static_cast<int32_t>(static_cast<int64_t>(frame_size - tile_size) * i / (num - 1)));
+    }
+}
+
+void SlicedDetector::CreateTileList()
+{
+    std::vector<int32_t> x_list;
+    std::vector<int32_t> y_list;
+    CreatePositionList(frame_size_.width, tile_width_, overlap_ratio_, x_list);
+    CreatePositionList(frame_size_.height, tile_height_, overlap_ratio_, y_list);
+    tile_list_.clear();
+    for (int32_t y : y_list) {
+        for (int32_t x : x_list) {
+            tile_list_.push_back(cv::Rect(x, y, (std::min)(tile_width_, frame_size_.width), (std::min)(tile_height_, frame_size_.height)));
+        }
+    }
+    tile_active_cnt_list_.assign(tile_list_.size(), frame_cnt_ - idle_interval_ + 1);    /* all tiles run in the first call */
+    is_processed_list_.assign(tile_list_.size(), false);
+}
+
+int32_t SlicedDetector::Process(const cv::Mat& frame, int32_t worker_num, const DetectFunc& detect_func, std::vector<BoundingBox>& bbox_list)
+{
+    bbox_list.clear();
+    if (frame.empty()) return kRetErr;
+    if (frame.size() != frame_size_) {
+        frame_size_ = frame.size();
+        CreateTileList();
+        PRINT("%d tiles (%d x %d) for %d x %d\n", static_cast<int32_t>(tile_list_.size()), tile_width_, tile_height_, frame_size_.width, frame_size_.height);
+    }
+
+    /*** Select tiles to run ***/
+    std::vector<cv::Rect> job_list;
+    const bool is_sliced = tile_list_.size() > 1;
+    if (!is_sliced || use_full_frame_) {
+        job_list.push_back(cv::Rect(0, 0, frame_size_.width, frame_size_.height));
+    }
+    if (is_sliced) {
+        for (size_t i = 0; i < tile_list_.size(); i++) {
+            const bool is_active = frame_cnt_ - tile_active_cnt_list_[i] < idle_interval_;
+            const bool is_round_robin = (frame_cnt_ + static_cast<int32_t>(i)) % idle_interval_ == 0;
+            is_processed_list_[i] = is_active || is_round_robin;
+            if (is_processed_list_[i]) job_list.push_back(tile_list_[i]);
+        }
+    }
+
+    /*** Run tiles on workers ***/
+    /* job j is processed by worker (j % worker_num), so each detector is used by one thread */
+    worker_num = (std::max)(1, (std::min)(worker_num, static_cast<int32_t>(job_list.size())));
+    std::vector<std::vector<BoundingBox>> job_bbox_list(job_list.size());
+    std::vector<int32_t> worker_ret_list(worker_num, kRetOk);
+    auto run_worker = [&](int32_t worker_id) {
+        for (size_t j = worker_id; j < job_list.size(); j += worker_num) {
+            if (detect_func(worker_id, frame(job_list[j]), job_bbox_list[j]) != 0) {
+                worker_ret_list[worker_id] = kRetErr;
+                return;
+            }
+        }
+    };
+    std::vector<std::thread> thread_list;
+    for (int32_t worker_id = 1; worker_id < worker_num; worker_id++) {
+        thread_list.push_back(std::thread(run_worker, worker_id));
+    }
+    run_worker(0);
+    for (auto& t : thread_list) t.join();
+    for (int32_t ret : worker_ret_list) {
+        if (ret != kRetOk) return kRetErr;
+    }
+
+    /*** Merge ***/
+    MergeBbox(job_list, job_bbox_list, bbox_list);
+
+    /* Tiles which have a box run in the next calls */
+    for (const auto& bbox : bbox_list) {
+        const cv::Point center(bbox.x + bbox.w / 2, bbox.y + bbox.h / 2);
+        for (size_t i = 0; i < tile_list_.size(); i++) {
+            if (tile_list_[i].contains(center)) tile_active_cnt_list_[i] = frame_cnt_;
+        }
+    }
+    frame_cnt_++;
+
+    return kRetOk;
+}
+
+static float CalculateIoS(const BoundingBox& obj0, const BoundingBox& obj1)
+{
+    int32_t interx0 = (std::max)(obj0.x, obj1.x);
+    int32_t intery0 = (std::max)(obj0.y, obj1.y);
+    int32_t interx1 = (std::min)(obj0.x + obj0.w, obj1.x + obj1.w);
+    int32_t intery1 = (std::min)(obj0.y + obj0.h, obj1.y + obj1.h);
+    if (interx1 < interx0 || intery1 < intery0) return 0;
+
+    int32_t area_min = (std::max)(1, (std::min)(obj0.w * obj0.h, obj1.w * obj1.h));
+    int32_t area_inter = (interx1 - interx0) * (intery1 - intery0);
+    return static_cast<float>(area_inter) / area_min;
+}
+
+void SlicedDetector::MergeBbox(const std::vector<cv::Rect>& job_list, const std::vector<std::vector<BoundingBox>>& job_bbox_list, std::vector<BoundingBox>& bbox_list)
+{
+    /* Map to the frame coordinate, and check if a box is cut by a tile border */
+    std::vector<BoundingBox> candidate_list;
+    std::vector<bool> is_cut_list;
+    for (size_t j = 0; j < job_list.size(); j++) {
+        const cv::Rect& job = job_list[j];
+        for (auto bbox : job_bbox_list[j]) {
+            bool is_cut = false;
+            if (job.x > 0 && bbox.x <= kBorderMargin) is_cut = true;
+            if (job.y > 0 && bbox.y <= kBorderMargin) is_cut = true;
+            if (job.x + job.width < frame_size_.width && bbox.x + bbox.w >= job.width - kBorderMargin) is_cut = true;
+            if (job.y + job.height < frame_size_.height && bbox.y + bbox.h >= job.height - kBorderMargin) is_cut = true;
+            bbox.x += job.x;
+            bbox.y += job.y;
+            candidate_list.push_back(bbox);
+            is_cut_list.push_back(is_cut);
+        }
+    }
+
+    std::vector<int32_t> index_list(candidate_list.size());
+    for (size_t i = 0; i < index_list.size(); i++) index_list[i] = static_cast<int32_t>(i);
+    std::sort(index_list.begin(), index_list.end(), [&candidate_list](int32_t lhs, int32_t rhs) {
+        return candidate_list[lhs].score > candidate_list[rhs].score;
+        });
+
+    /* NMS per class. A box cut by a tile border is fused (union) into the higher score box which contains most of it */
+    std::vector<bool> is_merged(candidate_list.size(), false);
+    for (size_t i = 0; i < index_list.size(); i++) {
+        const int32_t index_high = index_list[i];
+        if (is_merged[index_high]) continue;
+        const BoundingBox& bbox_high = candidate_list[index_high];
+        int32_t x0 = bbox_high.x;
+        int32_t y0 = bbox_high.y;
+        int32_t x1 = bbox_high.x + bbox_high.w;
+        int32_t y1 = bbox_high.y + bbox_high.h;
+        for (size_t k = i + 1; k < index_list.size(); k++) {
+            const int32_t index_low = index_list[k];
+            if (is_merged[index_low]) continue;
+            const BoundingBox& bbox_low = candidate_list[index_low];
+            if (bbox_high.class_id != bbox_low.class_id) continue;
+            if (BoundingBoxUtils::CalculateIoU(bbox_high, bbox_low) > kThresholdNmsIou) {
+                is_merged[index_low] = true;
+            } else if ((is_cut_list[index_high] || is_cut_list[index_low]) && CalculateIoS(bbox_high, bbox_low) > threshold_fusion_) {
+                x0 = (std::min)(x0, bbox_low.x);
+                y0 = (std::min)(y0, bbox_low.y);
+                x1 = (std::max)(x1, bbox_low.x + bbox_low.w);
+                y1 = (std::max)(y1, bbox_low.y + bbox_low.h);
+                is_merged[index_low] = true;
+            }
+        }
+        BoundingBox bbox = bbox_high;
+        bbox.x = x0;
+        bbox.y = y0;
+        bbox.w = x1 - x0;
+        bbox.h = y1 - y0;
+        bbox_list.push_back(bbox);
+    }
+}
@@ -0,0 +1,175 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef SLICED_DETECTOR_
+#define SLICED_DETECTOR_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "bounding_box.h"
+
+/***
+* Sliced (tiled) inference to detect small objects in a high resolution frame
+*   - the frame is divided into overlapping tiles (+ optional full frame pass for large objects). Each tile is given to the detector as an image (ROI, not copied)
+*   - tiles run concurrently on a pool of detectors (worker_id = index of the detector. Each detector has its own interpreter)
+*   - boxes are mapped back to the frame, and merged across tiles per class: NMS, and box fusion (union) for a box cut by a tile border
+*   - adaptive: a tile with a detection in the last idle_interval calls runs every call. The other tiles run every idle_interval calls in round robin
+* Usage:
+*   sliced_detector.Process(frame, worker_num, [&](int32_t worker_id, const cv::Mat& tile, std::vector<BoundingBox>& bbox_list) {
+*       engine_list[worker_id]->Process(tile, det_result);   // bbox is in the tile coordinate
+*       bbox_list = det_result.bbox_list;
+*       return 0;
+*   }, bbox_list);
+***/
+class SlicedDetector {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+    typedef std::function<int32_t(int32_t worker_id, const cv::Mat& tile, std::vector<BoundingBox>& bbox_list)> DetectFunc;
+
+public:
+    SlicedDetector(int32_t tile_width = 640, int32_t tile_height = 640, float overlap_ratio = 0.2f, bool use_full_frame = true, int32_t idle_interval = 4, float threshold_fusion = 0.5f);
+    ~SlicedDetector() {}
+    void Reset();
+
+    /* detect_func is called from worker_num threads at the same time (with different worker_id). bbox_list is in the frame coordinate */
+    int32_t Process(const cv::Mat& frame, int32_t worker_num, const DetectFunc& detect_func, std::vector<BoundingBox>& bbox_list);
+    const std::vector<cv::Rect>& GetTileList() const { return tile_list_; }
+    /* Tiles run in the last Process (full frame pass is not included) */
+    const std::vector<bool>& GetProcessedTileList() const { return is_processed_list_; }
+
+private:
+    void CreateTileList();
+    void MergeBbox(const std::vector<cv::Rect>& job_list, const std::vector<std::vector<BoundingBox>>& job_bbox_list, std::vector<BoundingBox>& bbox_list);
+
+private:
+    int32_t tile_width_;
+    int32_t tile_height_;
+    float overlap_ratio_;
+    bool use_full_frame_;
+    int32_t idle_interval_;
+    float threshold_fusion_;
+
+    cv::Size frame_size_;
+    std::vector<cv::Rect> tile_list_;
+    std::vector<int32_t> tile_active_cnt_list_;     /* frame_cnt_ when a box was found in the tile */
+    std::vector<bool> is_processed_list_;
+    int32_t frame_cnt_;
+};
+
+/***
+* SlicedDetector with a pool of detectors of the same type
+*   - worker 0 is the main engine (owned by the caller, and also used without slicing). The other workers are created and owned here
+*   - ENGINE needs Initialize(work_dir, num_threads), Finalize(), Process(mat, result), and Result with bbox_list, crop and processing time
+*   - processing time in the result is the one of the slowest worker
+* Usage:
+*   s_sliced_engine.Initialize(s_engine.get(), work_dir, num_threads, worker_num, SlicedDetector(640, 640));
+*   s_sliced_engine.Process(mat, det_result);
+*   s_sliced_engine.Finalize();
+***/
+template <typename ENGINE>
+class SlicedEngine {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+public:
+    SlicedEngine() : engine_(nullptr) {}
+    ~SlicedEngine() { Finalize(); }
+
+    int32_t Initialize(ENGINE* engine, const std::string& work_dir, int32_t num_threads, int32_t worker_num, const SlicedDetector& sliced_detector)
+    {
+        Finalize();
+        for (int32_t i = 1; i < worker_num; i++) {
+            std::unique_ptr<ENGINE> worker_engine(new ENGINE());
+            if (worker_engine->Initialize(work_dir, num_threads) != ENGINE::kRetOk) {
+                worker_engine->Finalize();
+                Finalize();
+                return kRetErr;
+            }
+            engine_list_.push_back(std::move(worker_engine));
+        }
+        engine_ = engine;
+        sliced_detector_ = sliced_detector;
+        return kRetOk;
+    }
+
+    void Finalize()
+    {
+        for (auto& worker_engine : engine_list_) worker_engine->Finalize();
+        engine_list_.clear();
+        engine_ = nullptr;
+        sliced_detector_.Reset();
+    }
+
+    int32_t Process(const cv::Mat& mat, typename ENGINE::Result& det_result)
+    {
+        if (!engine_) return kRetErr;
+        const int32_t worker_num = static_cast<int32_t>(engine_list_.size()) + 1;
+        std::vector<typename ENGINE::Result> worker_result_list(worker_num);     /* only for processing time */
+        auto detect_func = [this, &worker_result_list](int32_t worker_id, const cv::Mat& tile, std::vector<BoundingBox>& bbox_list) {
+            ENGINE* engine = (worker_id == 0) ? engine_ : engine_list_[worker_id - 1].get();
+            typename ENGINE::Result tile_result;
+            if (engine->Process(tile, tile_result) != ENGINE::kRetOk) {
+                return -1;
+            }
+            bbox_list = tile_result.bbox_list;
+            worker_result_list[worker_id].time_pre_process += tile_result.time_pre_process;
+            worker_result_list[worker_id].time_inference += tile_result.time_inference;
+            worker_result_list[worker_id].time_post_process += tile_result.time_post_process;
+            return 0;
+        };
+        if (sliced_detector_.Process(mat, worker_num, detect_func, det_result.bbox_list) != SlicedDetector::kRetOk) {
+            return kRetErr;
+        }
+        det_result.crop.x = 0;
+        det_result.crop.y = 0;
+        det_result.crop.w = mat.cols;
+        det_result.crop.h = mat.rows;
+
+        /* the slowest worker */
+        for (const auto& worker_result : worker_result_list) {
+            det_result.time_pre_process = (std::max)(det_result.time_pre_process, worker_result.time_pre_process);
+            det_result.time_inference = (std::max)(det_result.time_inference, worker_result.time_inference);
+            det_result.time_post_process = (std::max)(det_result.time_post_process, worker_result.time_post_process);
+        }
+        return kRetOk;
+    }
+
+private:
+    SlicedEngine(const SlicedEngine&) = delete;
+    SlicedEngine& operator=(const SlicedEngine&) = delete;
+
+private:
+    ENGINE* engine_;
+    std::vector<std::unique_ptr<ENGINE>> engine_list_;
+    SlicedDetector sliced_detector_;
+};
+
+#endif
@@ -0,0 +1,79 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <mutex>
+
+/* for My modules */
+#include "startup_profiler.h"
+
+/*** Global variable ***/
+static std::mutex s_mutex;
+static std::vector<std::pair<std::string, StartupProfiler::PhaseList>> s_record_list;
+
+/*** Function ***/
+StartupProfiler::StartupProfiler(const std::string& name)
+{
+    name_ = name;
+    time_last_ = std::chrono::steady_clock::now();
+}
+
+void StartupProfiler::Mark(const std::string& phase)
+{
+    const auto& time_now = std::chrono::steady_clock::now();
+    phase_list_.push_back(std::make_pair(phase, static_cast<std::chrono::duration<double>>(time_now - time_last_).count() * 1000.0));
+    time_last_ = time_now;
+}
+
+void StartupProfiler::Finish()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_record_list.push_back(std::make_pair(name_, phase_list_));
+}
+
+double StartupProfiler::GetTotalTime() const
+{
+    double time_total = 0;
+    for (const auto& phase : phase_list_) time_total += phase.second;
+    return time_total;
+}
+
+void StartupProfiler::PrintAll()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_record_list.empty()) return;
+    printf("=== Startup time ===\n");
+    for (const auto& record : s_record_list) {
+        double time_total = 0;
+        for (const auto& phase : record.second) time_total += phase.second;
+        printf("%-21s%9.3lf [msec]\n", (record.first + ":").c_str(), time_total);
+        for (const auto& phase : record.second) {
+            printf("  %-19s%9.3lf [msec]\n", (phase.first + ":").c_str(), phase.second);
+        }
+    }
+    printf("\n");
+}
+
+void StartupProfiler::ClearAll()
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_record_list.clear();
+}
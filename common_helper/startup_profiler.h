@@ -0,0 +1,60 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef STARTUP_PROFILER_
+#define STARTUP_PROFILER_
+
+/* for general */
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+
+/***
+* Startup time breakdown of engines
+*   - each engine measures the phases of its Initialize (auto tune, model load, delegate init, warmup, ...)
+*   - InferenceHelper::Initialize loads the model, applies the delegate and packs the weights (XNNPACK) in one call, so they are one phase
+*   - the first invocations are slow (lazy allocation, weight packing, cold cache). Running them as warmup in Initialize keeps the first frame as fast as others
+*   - records of all engines are kept process-wide, and printed by PrintAll
+* Usage:
+*   StartupProfiler profiler(TAG);
+*   inference_helper_->Initialize(...);  profiler.Mark("initialize");
+*   Warmup(kWarmupNum);                  profiler.Mark("warmup");
+*   profiler.Finish();
+*   StartupProfiler::PrintAll();         // in main, after ImageProcessor::Initialize
+***/
+class StartupProfiler {
+public:
+    typedef std::vector<std::pair<std::string, double>> PhaseList;     /* (phase, time [msec]) */
+
+public:
+    StartupProfiler(const std::string& name);
+    /* Time since the previous Mark (or construction) is recorded as the phase */
+    void Mark(const std::string& phase);
+    /* Add the record to the process-wide list */
+    void Finish();
+    double GetTotalTime() const;
+    const PhaseList& GetPhaseList() const { return phase_list_; }
+
+    static void PrintAll();
+    static void ClearAll();
+
+private:
+    std::string name_;
+    std::chrono::steady_clock::time_point time_last_;
+    PhaseList phase_list_;
+};
+
+#endif
@@ -0,0 +1,258 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__ANDROID__)
+#define TENSOR_TRACE_USE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* for My modules */
+#include "common_helper.h"
+#include "tensor_trace.h"
+
+/*** Macro ***/
+#define TAG "TensorTrace"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+/*** Setting ***/
+static constexpr char kFileMagic[4] = { 'T', 'T', 'R', 'C' };
+static constexpr uint32_t kFileVersion = 1;
+static constexpr int32_t kNameLength = 64;
+static constexpr size_t kAlignment = 8;
+
+/*** Global variable ***/
+/* All headers are multiple of 8 bytes so that tensor data is aligned */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int32_t frame_num;      /* updated at Close */
+    uint32_t reserved;
+} FileHeader;
+
+typedef struct {
+    uint64_t frame_size;    /* [byte] including this header */
+    int32_t frame_id;
+    int32_t original_width;
+    int32_t original_height;
+    int32_t crop_x;
+    int32_t crop_y;
+    int32_t crop_w;
+    int32_t crop_h;
+    int32_t tensor_num;
+} FrameHeader;
+
+typedef struct {
+    char name[kNameLength];
+    int32_t tensor_type;
+    int32_t dim_num;
+    int32_t dims[TensorTrace::kMaxDimNum];
+    float scale;
+    int32_t zero_point;
+    uint64_t data_size;     /* [byte] without padding */
+} TensorHeader;
+
+/*** Function ***/
+static size_t Align(size_t size)
+{
+    return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+int32_t TensorTraceWriter::Open(const std::string& filename)
+{
+    Close();
+    fp_ = fopen(filename.c_str(), "wb");
+    if (!fp_) {
+        PRINT_E("Failed to open %s\n", filename.c_str());
+        return kRetErr;
+    }
+    FileHeader file_header;
+    memset(&file_header, 0, sizeof(file_header));
+    memcpy(file_header.magic, kFileMagic, sizeof(kFileMagic));
+    file_header.version = kFileVersion;
+    fwrite(&file_header, sizeof(file_header), 1, fp_);
+    frame_num_ = 0;
+    PRINT("Record: %s\n", filename.c_str());
+    return kRetOk;
+}
+
+int32_t TensorTraceWriter::Write(const TensorTrace::Frame& frame)
+{
+    if (!fp_) return kRetErr;
+
+    FrameHeader frame_header;
+    memset(&frame_header, 0, sizeof(frame_header));
+    frame_header.frame_size = sizeof(FrameHeader);
+    for (const auto& tensor : frame.tensor_list) {
+        if (tensor.tensor_dims.size() > TensorTrace::kMaxDimNum) {
+            PRINT_E("Too many dims: %s\n", tensor.name.c_str());
+            return kRetErr;
+        }
+        frame_header.frame_size += sizeof(TensorHeader) + Align(tensor.data_size);
+    }
+    frame_header.frame_id = frame.frame_id;
+    frame_header.original_width = frame.original_width;
+    frame_header.original_height = frame.original_height;
+    frame_header.crop_x = frame.crop_x;
+    frame_header.crop_y = frame.crop_y;
+    frame_header.crop_w = frame.crop_w;
+    frame_header.crop_h = frame.crop_h;
+    frame_header.tensor_num = static_cast<int32_t>(frame.tensor_list.size());
+    fwrite(&frame_header, sizeof(frame_header), 1, fp_);
+
+    static const uint8_t kPadding[kAlignment] = { 0 };
+    for (const auto& tensor : frame.tensor_list) {
+        TensorHeader tensor_header;
+        memset(&tensor_header, 0, sizeof(tensor_header));
+        snprintf(tensor_header.name, sizeof(tensor_header.name), "%s", tensor.name.c_str());
+        tensor_header.tensor_type = tensor.tensor_type;
+        tensor_header.dim_num = static_cast<int32_t>(tensor.tensor_dims.size());
+        for (size_t i = 0; i < tensor.tensor_dims.size(); i++) tensor_header.dims[i] = tensor.tensor_dims[i];
+        tensor_header.scale = tensor.scale;
+        tensor_header.zero_point = tensor.zero_point;
+        tensor_header.data_size = tensor.data_size;
+        fwrite(&tensor_header, sizeof(tensor_header), 1, fp_);
+        if (tensor.data_size > 0) fwrite(tensor.data, 1, tensor.data_size, fp_);
+        fwrite(kPadding, 1, Align(tensor.data_size) - tensor.data_size, fp_);
+    }
+    frame_num_++;
+    return kRetOk;
+}
+
+void TensorTraceWriter::Close()
+{
+    if (!fp_) return;
+    /* Write the number of frames to the file header */
+    fseek(fp_, offsetof(FileHeader, frame_num), SEEK_SET);
+    fwrite(&frame_num_, sizeof(frame_num_), 1, fp_);
+    fclose(fp_);
+    fp_ = nullptr;
+    PRINT("Recorded %d frames\n", frame_num_);
+}
+
+
+int32_t TensorTraceReader::Open(const std::string& filename)
+{
+    Close();
+#ifdef TENSOR_TRACE_USE_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+        PRINT_E("Failed to open %s\n", filename.c_str());
+        if (fd >= 0) close(fd);
+        return kRetErr;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        PRINT_E("Failed to map %s\n", filename.c_str());
+        return kRetErr;
+    }
+    mapped_ = static_cast<const uint8_t*>(mapped);
+    mapped_size_ = st.st_size;
+#else
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp) {
+        PRINT_E("Failed to open %s\n", filename.c_str());
+        return kRetErr;
+    }
+    fseek(fp, 0, SEEK_END);
+    buffer_.resize(ftell(fp));
+    fseek(fp, 0, SEEK_SET);
+    size_t read_size = fread(buffer_.data(), 1, buffer_.size(), fp);
+    fclose(fp);
+    if (read_size != buffer_.size() || buffer_.size() < sizeof(FileHeader)) {
+        PRINT_E("Failed to read %s\n", filename.c_str());
+        buffer_.clear();
+        return kRetErr;
+    }
+    mapped_ = buffer_.data();
+    mapped_size_ = buffer_.size();
+#endif
+
+    const FileHeader* file_header = reinterpret_cast<const FileHeader*>(mapped_);
+    if (memcmp(file_header->magic, kFileMagic, sizeof(kFileMagic)) != 0 || file_header->version != kFileVersion) {
+        PRINT_E("Invalid file: %s\n", filename.c_str());
+        Close();
+        return kRetErr;
+    }
+
+    /* Build frame index. A truncated last frame (e.g. the app was killed while recording) is ignored */
+    size_t offset = sizeof(FileHeader);
+    while (offset + sizeof(FrameHeader) <= mapped_size_) {
+        const FrameHeader* frame_header = reinterpret_cast<const FrameHeader*>(mapped_ + offset);
+        if (frame_header->frame_size < sizeof(FrameHeader) || offset + frame_header->frame_size > mapped_size_) break;
+        frame_offset_list_.push_back(offset);
+        offset += static_cast<size_t>(frame_header->frame_size);
+    }
+    PRINT("Replay: %s (%d frames)\n", filename.c_str(), GetFrameNum());
+    return kRetOk;
+}
+
+void TensorTraceReader::Close()
+{
+#ifdef TENSOR_TRACE_USE_MMAP
+    if (mapped_) munmap(const_cast<uint8_t*>(mapped_), mapped_size_);
+#endif
+    buffer_.clear();
+    mapped_ = nullptr;
+    mapped_size_ = 0;
+    frame_offset_list_.clear();
+}
+
+int32_t TensorTraceReader::Read(int32_t index, TensorTrace::Frame& frame) const
+{
+    if (!mapped_ || index < 0 || index >= GetFrameNum()) return kRetErr;
+
+    const uint8_t* p = mapped_ + frame_offset_list_[index];
+    const FrameHeader* frame_header = reinterpret_cast<const FrameHeader*>(p);
+    const uint8_t* p_end = p + frame_header->frame_size;
+    frame.frame_id = frame_header->frame_id;
+    frame.original_width = frame_header->original_width;
+    frame.original_height = frame_header->original_height;
+    frame.crop_x = frame_header->crop_x;
+    frame.crop_y = frame_header->crop_y;
+    frame.crop_w = frame_header->crop_w;
+    frame.crop_h = frame_header->crop_h;
+    frame.tensor_list.resize(frame_header->tensor_num);
+    p += sizeof(FrameHeader);
+
+    for (auto& tensor : frame.tensor_list) {
+        if (p + sizeof(TensorHeader) > p_end) return kRetErr;
+        const TensorHeader* tensor_header = reinterpret_cast<const TensorHeader*>(p);
+        p += sizeof(TensorHeader);
+        if (tensor_header->dim_num < 0 || tensor_header->dim_num > TensorTrace::kMaxDimNum || p + tensor_header->data_size > p_end) return kRetErr;
+        tensor.name.assign(tensor_header->name, strnlen(tensor_header->name, kNameLength));
+        tensor.tensor_type = tensor_header->tensor_type;
+        tensor.tensor_dims.assign(tensor_header->dims, tensor_header->dims + tensor_header->dim_num);
+        tensor.scale = tensor_header->scale;
+        tensor.zero_point = tensor_header->zero_point;
+        tensor.data = p;
+        tensor.data_size = static_cast<size_t>(tensor_header->data_size);
+        p += Align(tensor.data_size);
+    }
+    return kRetOk;
+}
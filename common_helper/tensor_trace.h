@@ -0,0 +1,110 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSOR_TRACE_
+#define TENSOR_TRACE_
+
+/* for general */
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/***
+* Record / replay of output tensors, to run post process (decoder, NMS, tracker) without interpreter, camera and GUI
+*   - one frame = output tensors + crop information (Result.crop) + original image size
+*   - the file is memory-mapped at replay, and tensor data is used in place (no copy, 8 byte aligned)
+*   - file format (little endian)
+*       FileHeader, { FrameHeader, { TensorHeader, data (padded to 8 bytes) } x num_tensor } x num_frame
+* Usage:
+*   TensorTraceWriter writer; writer.Open("trace.bin");
+*   writer.Write(frame);    // after inference
+*   TensorTraceReader reader; reader.Open("trace.bin");
+*   reader.Read(i, frame);  // frame.tensor_list[j].data points into the mapped file
+***/
+namespace TensorTrace
+{
+    static constexpr int32_t kMaxDimNum = 8;
+
+    typedef struct Tensor_ {
+        std::string name;
+        int32_t tensor_type;        /* TensorInfo::kTensorType* */
+        std::vector<int32_t> tensor_dims;
+        float scale;                /* quantization parameters. 0 if not quantized */
+        int32_t zero_point;
+        const void* data;
+        size_t data_size;           /* [byte] */
+        Tensor_() : tensor_type(0), scale(0), zero_point(0), data(nullptr), data_size(0) {}
+    } Tensor;
+
+    typedef struct Frame_ {
+        int32_t frame_id;
+        int32_t original_width;
+        int32_t original_height;
+        int32_t crop_x;
+        int32_t crop_y;
+        int32_t crop_w;
+        int32_t crop_h;
+        std::vector<Tensor> tensor_list;
+        Frame_() : frame_id(0), original_width(0), original_height(0), crop_x(0), crop_y(0), crop_w(0), crop_h(0) {}
+    } Frame;
+}
+
+
+class TensorTraceWriter {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+public:
+    TensorTraceWriter() : fp_(nullptr), frame_num_(0) {}
+    ~TensorTraceWriter() { Close(); }
+    int32_t Open(const std::string& filename);
+    int32_t Write(const TensorTrace::Frame& frame);
+    void Close();
+    bool IsOpened() const { return fp_ != nullptr; }
+
+private:
+    FILE* fp_;
+    int32_t frame_num_;
+};
+
+
+class TensorTraceReader {
+public:
+    enum {
+        kRetOk = 0,
+        kRetErr = -1,
+    };
+
+public:
+    TensorTraceReader() : mapped_(nullptr), mapped_size_(0) {}
+    ~TensorTraceReader() { Close(); }
+    int32_t Open(const std::string& filename);
+    void Close();
+    bool IsOpened() const { return mapped_ != nullptr; }
+    int32_t GetFrameNum() const { return static_cast<int32_t>(frame_offset_list_.size()); }
+    /* Pointers in frame are valid until Close */
+    int32_t Read(int32_t index, TensorTrace::Frame& frame) const;
+
+private:
+    const uint8_t* mapped_;
+    size_t mapped_size_;
+    std::vector<uint8_t> buffer_;       /* used instead of mmap on the platform without mmap */
+    std::vector<size_t> frame_offset_list_;
+};
+
+#endif
@@ -31,6 +31,12 @@ limitations under the License.
 
 Track::Track(const int32_t id, const BoundingBox& bbox_det)
 {
+    Initialize(id, bbox_det);
+}
+
+void Track::Initialize(const int32_t id, const BoundingBox& bbox_det)
+{
+    data_history_.clear();
     Data data;
     data.bbox = bbox_det;
     data.bbox_raw = bbox_det;
@@ -62,10 +68,7 @@ BoundingBox Track::Predict()
     Data data = GetLatestData();
     data.bbox = bbox;
     data.bbox_raw = bbox;
-    data_history_.push_back(data);
-    if (data_history_.size() > kMaxHistoryNum) {
-        data_history_.pop_front();
-    }
+    data_history_.push_back(data);   /* the oldest data is overwritten when full */
 
     return bbox;
 }
@@ -97,7 +100,19 @@ void Track::UpdateNoDetect()
     cnt_undetected_++;
 }
 
-std::deque<Track::Data>& Track::GetDataHistory()
+void Track::Correct(const BoundingBox& bbox)
+{
+    kf_.Update(Bbox2KalmanObserved(bbox));
+
+    BoundingBox& bbox_latest = data_history_.back().bbox;
+    BoundingBox bbox_est = KalmanStatus2Bbox(kf_.X);   // w, y, w, h only
+    bbox_latest.w = bbox_est.w;
+    bbox_latest.h = bbox_est.h;
+    bbox_latest.x = bbox_est.x;
+    bbox_latest.y = bbox_est.y;
+}
+
+Track::DataHistory& Track::GetDataHistory()
 {
     return data_history_;
 }
@@ -127,6 +142,16 @@ const int32_t Track::GetDetectedCount() const
     return cnt_detected_;
 }
 
+float Track::GetPositionUncertainty() const
+{
+    return static_cast<float>(std::sqrt((kf_.P(0, 0) + kf_.P(1, 1)) / 2));
+}
+
+float Track::GetSpeed() const
+{
+    return static_cast<float>(std::sqrt(kf_.X(4, 0) * kf_.X(4, 0) + kf_.X(5, 0) * kf_.X(5, 0)));
+}
+
 
 static constexpr int32_t kNumObserve = 4;   /* (cx, cy, area, aspect) */
 static constexpr int32_t kNumStatus = 7;    /* (cx, cy, area, aspect, vx, vy, vz)   (v = speed)*/
@@ -231,6 +256,7 @@ BoundingBox Track::KalmanStatus2Bbox(const SimpleMatrix& X)
 
 constexpr float Tracker::kCostMax;  // for link error in Android Studio (clang)
 Tracker::Tracker(int32_t threshold_frame_to_delete)
+    : track_list_(slot_list_, active_slot_list_)
 {
     track_sequence_num_ = 0;
     threshold_frame_to_delete_ = threshold_frame_to_delete;
@@ -242,64 +268,118 @@ Tracker::~Tracker()
 
 void Tracker::Reset()
 {
-    track_list_.clear();
+    slot_list_.clear();
+    free_slot_list_.clear();
+    active_slot_list_.clear();
     track_sequence_num_ = 0;
 }
 
 
-std::vector<Track>& Tracker::GetTrackList()
+TrackList& Tracker::GetTrackList()
 {
     return track_list_;
 }
 
-float Tracker::CalculateCost(Track& track, const BoundingBox& det_bbox)
+void Tracker::Predict()
 {
-    const auto& track_bbox = track.GetLatestBoundingBox();
-    float iou = BoundingBoxUtils::CalculateIoU(track_bbox, det_bbox);
-    if (iou > 0.9) {
-        /* must be the same object (do not check class id because class id may be mistaken) */
-    } else if (iou < 0.3) {
-        /* cannot be the same object */
-        iou = 0;
-    } else {
-        if (track_bbox.class_id == det_bbox.class_id) {
-            /* can be the same object */
-        } else {
-            /* cannot be the same object */
-            iou = 0;
-        }
+    for (auto& track : track_list_) {
+        float score = track.GetLatestBoundingBox().score;
+        track.Predict();
+        track.GetLatestData().bbox.score = score;   /* bbox_raw keeps score = 0 (not detected) */
+    }
+}
+
+int32_t Tracker::AllocateSlot(const int32_t id, const BoundingBox& bbox_det)
+{
+    if (!free_slot_list_.empty()) {
+        int32_t slot = free_slot_list_.back();
+        free_slot_list_.pop_back();
+        slot_list_[slot].Initialize(id, bbox_det);   /* reuse the memory of the deleted track */
+        return slot;
     }
+    slot_list_.push_back(Track(id, bbox_det));      /* std::deque doesn't move the existing elements */
+    return static_cast<int32_t>(slot_list_.size()) - 1;
+}
 
-    return kCostMax - iou;
+/* Cost b/w one detected bbox and all the predicted bboxes. Written without branch so that the loop is vectorized */
+void Tracker::CalculateCost(const BoundingBox& det_bbox, float* cost_list)
+{
+    const int32_t num_track = static_cast<int32_t>(active_slot_list_.size());
+    const int32_t* pred_x0 = pred_x0_list_.data();
+    const int32_t* pred_y0 = pred_y0_list_.data();
+    const int32_t* pred_x1 = pred_x1_list_.data();
+    const int32_t* pred_y1 = pred_y1_list_.data();
+    const int32_t* pred_area = pred_area_list_.data();
+    const int32_t* pred_class_id = pred_class_id_list_.data();
+    const int32_t det_x0 = det_bbox.x;
+    const int32_t det_y0 = det_bbox.y;
+    const int32_t det_x1 = det_bbox.x + det_bbox.w;
+    const int32_t det_y1 = det_bbox.y + det_bbox.h;
+    const int32_t det_area = det_bbox.w * det_bbox.h;
+    const int32_t det_class_id = det_bbox.class_id;
+
+    for (int32_t i = 0; i < num_track; i++) {
+        /* The same as BoundingBoxUtils::CalculateIoU */
+        int32_t inter_w = (std::min)(pred_x1[i], det_x1) - (std::max)(pred_x0[i], det_x0);
+        int32_t inter_h = (std::min)(pred_y1[i], det_y1) - (std::max)(pred_y0[i], det_y0);
+        inter_w = (std::max)(inter_w, 0);
+        inter_h = (std::max)(inter_h, 0);
+        int32_t area_inter = inter_w * inter_h;
+        int32_t area_sum = pred_area[i] + det_area - area_inter;
+        float iou = (area_sum > 0) ? static_cast<float>(area_inter) / area_sum : 0.0F;
+
+        /* iou > 0.9: must be the same object (do not check class id because class id may be mistaken) */
+        /* iou < 0.3: cannot be the same object */
+        /* otherwise: can be the same object if class id is the same */
+        bool is_same = (iou > 0.9F) || (iou >= 0.3F && pred_class_id[i] == det_class_id);
+        cost_list[i] = kCostMax - (is_same ? iou : 0.0F);
+    }
 }
 
 void Tracker::Update(const std::vector<BoundingBox>& det_list)
 {
+    const size_t num_track = active_slot_list_.size();
+
     /*** Predict the position at the current frame using the previous status for all tracked bbox ***/
-    for (auto& track : track_list_) {
-        track.Predict();
+    pred_x0_list_.resize(num_track);
+    pred_y0_list_.resize(num_track);
+    pred_x1_list_.resize(num_track);
+    pred_y1_list_.resize(num_track);
+    pred_area_list_.resize(num_track);
+    pred_class_id_list_.resize(num_track);
+    for (size_t i_track = 0; i_track < num_track; i_track++) {
+        Track& track = slot_list_[active_slot_list_[i_track]];
+        const BoundingBox bbox = track.Predict();
+        pred_x0_list_[i_track] = bbox.x;
+        pred_y0_list_[i_track] = bbox.y;
+        pred_x1_list_[i_track] = bbox.x + bbox.w;
+        pred_y1_list_[i_track] = bbox.y + bbox.h;
+        pred_area_list_[i_track] = bbox.w * bbox.h;
+        pred_class_id_list_[i_track] = bbox.class_id;
     }
 
     /*** Association ***/
     /* Calculate IoU b/w predicted position and detected position */
-    size_t size_cost_matrix = (std::max)(track_list_.size(), det_list.size());  /* workaround: my hungarian algorithm sometimes outputs wrong result when the input matrix is not squared */
+    size_t size_cost_matrix = (std::max)(num_track, det_list.size());  /* workaround: my hungarian algorithm sometimes outputs wrong result when the input matrix is not squared */
     std::vector<std::vector<float>> cost_matrix(size_cost_matrix, std::vector<float>(size_cost_matrix, kCostMax));
-    for (size_t i_track = 0; i_track < track_list_.size(); i_track++) {
-        for (size_t i_det = 0; i_det < det_list.size(); i_det++) {
-            cost_matrix[i_track][i_det] = CalculateCost(track_list_[i_track], det_list[i_det]);
+    std::vector<float> cost_list(num_track);
+    for (size_t i_det = 0; i_det < det_list.size(); i_det++) {
+        CalculateCost(det_list[i_det], cost_list.data());
+        for (size_t i_track = 0; i_track < num_track; i_track++) {
+            cost_matrix[i_track][i_det] = cost_list[i_track];
         }
     }
 
     /* Assign track and det */
     std::vector<int32_t> det_index_for_track(size_cost_matrix, -1);
     std::vector<int32_t> track_index_for_det(size_cost_matrix, -1);
-    if (track_list_.size() > 0 && det_list.size() > 0) {
+    if (num_track > 0 && det_list.size() > 0) {
         HungarianAlgorithm<float> solver(cost_matrix);
         solver.Solve(det_index_for_track, track_index_for_det);
     }
 
 #if 0
-    for (size_t i_track = 0; i_track < track_list_.size(); i_track++) {
+    for (size_t i_track = 0; i_track < num_track; i_track++) {
         for (size_t i_det = 0; i_det < det_list.size(); i_det++) {
             printf("%.3f  ", cost_matrix[i_track][i_det]);
         }
@@ -318,31 +398,35 @@ void Tracker::Update(const std::vector<BoundingBox>& det_list)
 
     /*** Update track ***/
     std::vector<bool> is_det_assigned_list(size_cost_matrix, false);
-    for (size_t i_track = 0; i_track < track_list_.size(); i_track++) {
+    for (size_t i_track = 0; i_track < num_track; i_track++) {
+        Track& track = slot_list_[active_slot_list_[i_track]];
         int32_t assigned_det_index = det_index_for_track[i_track];
         if (assigned_det_index >= 0 && assigned_det_index < static_cast<int32_t>(det_list.size()) && cost_matrix[i_track][assigned_det_index] < kCostMax) {
-            track_list_[i_track].Update(det_list[assigned_det_index]);
+            track.Update(det_list[assigned_det_index]);
             is_det_assigned_list[assigned_det_index] = true;
         } else{
-            track_list_[i_track].UpdateNoDetect();
+            track.UpdateNoDetect();
         }
     }
 
     /*** Delete tracks ***/
-    for (auto it = track_list_.begin(); it != track_list_.end();) {
-        if (it->GetUndetectedCount() >= threshold_frame_to_delete_) {
-            it = track_list_.erase(it);
+    /* Only the slot index is removed from the active list (the order is kept). Track itself stays in the slot */
+    size_t num_alive = 0;
+    for (size_t i_track = 0; i_track < num_track; i_track++) {
+        int32_t slot = active_slot_list_[i_track];
+        if (slot_list_[slot].GetUndetectedCount() >= threshold_frame_to_delete_) {
+            free_slot_list_.push_back(slot);
         } else {
-            it++;
+            active_slot_list_[num_alive++] = slot;
         }
     }
+    active_slot_list_.resize(num_alive);
 
     /*** Add new tracks ***/
     for (size_t i = 0; i < det_list.size(); i++) {
         if (is_det_assigned_list[i] == false) {
-            track_list_.push_back(Track(track_sequence_num_, det_list[i]));
+            active_slot_list_.push_back(AllocateSlot(track_sequence_num_, det_list[i]));
             track_sequence_num_++;
         }
     }
 }
-
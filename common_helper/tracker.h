@@ -28,6 +28,7 @@ limitations under the License.
 /* for My modules */
 #include "bounding_box.h"
 #include "kalman_filter.h"
+#include "ring_buffer.h"
 
 
 class Track {
@@ -39,22 +40,28 @@ public:
         BoundingBox bbox;
         BoundingBox bbox_raw;
     } Data;
+    typedef RingBuffer<Data, kMaxHistoryNum> DataHistory;
 
 public:
     Track(const int32_t id, const BoundingBox& bbox_det);
     ~Track();
+    void Initialize(const int32_t id, const BoundingBox& bbox_det);
 
     BoundingBox Predict();
     void Update(const BoundingBox& bbox_det);
     void UpdateNoDetect();
+    /* Correct the predicted position with a measurement which is not a detection (e.g. optical flow). Counters are not changed */
+    void Correct(const BoundingBox& bbox);
 
-    std::deque<Data>& GetDataHistory();
+    DataHistory& GetDataHistory();
     Data& GetLatestData() ;
     BoundingBox& GetLatestBoundingBox();
 
     const int32_t GetId() const;
     const int32_t GetUndetectedCount() const;
     const int32_t GetDetectedCount() const;
+    float GetPositionUncertainty() const;   /* standard deviation of the center position in Kalman filter [px] */
+    float GetSpeed() const;                 /* speed of the center position in Kalman filter [px/frame] */
 
 private:
     KalmanFilter CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start);
@@ -63,7 +70,7 @@ private:
     BoundingBox KalmanStatus2Bbox(const SimpleMatrix& X);
 
 private:
-    std::deque<Data> data_history_;
+    DataHistory data_history_;
     KalmanFilter kf_;
     int32_t id_;
     int32_t cnt_detected_;
@@ -71,6 +78,36 @@ private:
 };
 
 
+/* Active tracks in the order of creation. Tracks are stored in slots which never move, so this is just a list of slot indices */
+class TrackList {
+public:
+    class iterator {
+    public:
+        iterator(std::deque<Track>* slot_list, std::vector<int32_t>::const_iterator it) : slot_list_(slot_list), it_(it) {}
+        Track& operator*() const { return (*slot_list_)[*it_]; }
+        Track* operator->() const { return &(*slot_list_)[*it_]; }
+        iterator& operator++() { ++it_; return *this; }
+        bool operator==(const iterator& rhs) const { return it_ == rhs.it_; }
+        bool operator!=(const iterator& rhs) const { return it_ != rhs.it_; }
+    private:
+        std::deque<Track>* slot_list_;
+        std::vector<int32_t>::const_iterator it_;
+    };
+
+public:
+    TrackList(std::deque<Track>& slot_list, std::vector<int32_t>& active_slot_list) : slot_list_(slot_list), active_slot_list_(active_slot_list) {}
+    iterator begin() { return iterator(&slot_list_, active_slot_list_.cbegin()); }
+    iterator end() { return iterator(&slot_list_, active_slot_list_.cend()); }
+    Track& operator[](size_t i) { return slot_list_[active_slot_list_[i]]; }
+    size_t size() const { return active_slot_list_.size(); }
+    bool empty() const { return active_slot_list_.empty(); }
+
+private:
+    std::deque<Track>& slot_list_;
+    std::vector<int32_t>& active_slot_list_;
+};
+
+
 class Tracker {
 private:
     static constexpr float kCostMax = 1.0F;
@@ -81,16 +118,35 @@ public:
     void Reset();
 
     void Update(const std::vector<BoundingBox>& det_list);
+    /* For the frame where detection is not run. All tracks move by prediction only, keep the score of the last detection and are not deleted */
+    void Predict();
 
-    std::vector<Track>& GetTrackList();
+    TrackList& GetTrackList();
 
 private:
-    float CalculateCost(Track& track, const BoundingBox& det_bbox);
+    /* track_list_ refers to the members */
+    Tracker(const Tracker&) = delete;
+    Tracker& operator=(const Tracker&) = delete;
+
+    void CalculateCost(const BoundingBox& det_bbox, float* cost_list);
+    int32_t AllocateSlot(const int32_t id, const BoundingBox& bbox_det);
 
 private:
-    std::vector<Track> track_list_;
+    /* Slot map. A deleted track leaves its slot in the free list and the slot is reused by a new track */
+    std::deque<Track> slot_list_;
+    std::vector<int32_t> free_slot_list_;
+    std::vector<int32_t> active_slot_list_;
+    TrackList track_list_;
     int32_t track_sequence_num_;
 
+    /* Predicted boxes of the active tracks (SoA, the same order as active_slot_list_) for association */
+    std::vector<int32_t> pred_x0_list_;
+    std::vector<int32_t> pred_y0_list_;
+    std::vector<int32_t> pred_x1_list_;
+    std::vector<int32_t> pred_y1_list_;
+    std::vector<int32_t> pred_area_list_;
+    std::vector<int32_t> pred_class_id_list_;
+
     int32_t threshold_frame_to_delete_;
 };
 
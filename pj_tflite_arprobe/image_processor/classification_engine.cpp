@@ -24,6 +24,7 @@ limitations under the License.
 #include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <thread>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -31,6 +32,7 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "inference_helper.h"
+#include "quantization_utils.h"
 #include "classification_engine.h"
 
 /*** Macro ***/
@@ -44,14 +46,19 @@ limitations under the License.
 
 
 /*** Function ***/
-int32_t ClassificationEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
+std::string ClassificationEngine::GetModelFilename(const std::string& work_dir)
+{
+    return work_dir + "/model/" + MODEL_NAME;
+}
+
+int32_t ClassificationEngine::Initialize(const std::string& work_dir, const int32_t num_threads, const int32_t num_interpreters)
 {
     /* Set model information */
-    std::string model_filename = work_dir + "/model/" + MODEL_NAME;
+    std::string model_filename = GetModelFilename(work_dir);
     std::string labelFilename = work_dir + "/model/" + LABEL_NAME;
 
     /* Set input tensor info */
-    input_tensor_info_list_.clear();
+    std::vector<InputTensorInfo> input_tensor_info_list;
     InputTensorInfo input_tensor_info("images", TensorInfo::kTensorTypeUint8, false);
     input_tensor_info.tensor_dims = { 1, 280, 280, 3 };
     input_tensor_info.data_type = InputTensorInfo::kDataTypeImage;
@@ -61,33 +68,43 @@ int32_t ClassificationEngine::Initialize(const std::string& work_dir, const int3
     input_tensor_info.normalize.norm[0] = 1.0f;
     input_tensor_info.normalize.norm[1] = 1.0f;
     input_tensor_info.normalize.norm[2] = 1.0f;
-    input_tensor_info_list_.push_back(input_tensor_info);
+    input_tensor_info_list.push_back(input_tensor_info);
 
     /* Set output tensor info */
-    output_tensor_info_list_.clear();
-    output_tensor_info_list_.push_back(OutputTensorInfo("Softmax", TensorInfo::kTensorTypeUint8));
-
-    /* Create and Initialize Inference Helper */
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::OPEN_CV));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::TENSOR_RT));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::NCNN));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::MNN));
-    inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLite));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteEdgetpu));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteGpu));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteXnnpack));
-    // inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteNnapi));
-
-    if (!inference_helper_) {
-        return kRetErr;
-    }
-    if (inference_helper_->SetNumThreads(num_threads) != InferenceHelper::kRetOk) {
-        inference_helper_.reset();
-        return kRetErr;
-    }
-    if (inference_helper_->Initialize(model_filename, input_tensor_info_list_, output_tensor_info_list_) != InferenceHelper::kRetOk) {
-        inference_helper_.reset();
-        return kRetErr;
+    std::vector<OutputTensorInfo> output_tensor_info_list;
+    output_tensor_info_list.push_back(OutputTensorInfo("Softmax", TensorInfo::kTensorTypeUint8));
+
+    /* Create and Initialize Inference Helper for each interpreter */
+    /* The number of threads is shared by the interpreters because they run concurrently */
+    const int32_t num_threads_per_interpreter = (std::max)(1, num_threads / (std::max)(1, num_interpreters));
+    interpreter_list_.clear();
+    interpreter_list_.resize((std::max)(1, num_interpreters));
+    for (auto& interpreter : interpreter_list_) {
+        interpreter.input_tensor_info_list = input_tensor_info_list;
+        interpreter.output_tensor_info_list = output_tensor_info_list;
+
+        //interpreter.inference_helper.reset(InferenceHelper::Create(InferenceHelper::OPEN_CV));
+        //interpreter.inference_helper.reset(InferenceHelper::Create(InferenceHelper::TENSOR_RT));
+        //interpreter.inference_helper.reset(InferenceHelper::Create(InferenceHelper::NCNN));
+        //interpreter.inference_helper.reset(InferenceHelper::Create(InferenceHelper::MNN));
+        interpreter.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLite));
+        //interpreter.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteEdgetpu));
+        //interpreter.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteGpu));
+        //interpreter.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteXnnpack));
+        // interpreter.inference_helper.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteNnapi));
+
+        if (!interpreter.inference_helper) {
+            interpreter_list_.clear();
+            return kRetErr;
+        }
+        if (interpreter.inference_helper->SetNumThreads(num_threads_per_interpreter) != InferenceHelper::kRetOk) {
+            interpreter_list_.clear();
+            return kRetErr;
+        }
+        if (interpreter.inference_helper->Initialize(model_filename, interpreter.input_tensor_info_list, interpreter.output_tensor_info_list) != InferenceHelper::kRetOk) {
+            interpreter_list_.clear();
+            return kRetErr;
+        }
     }
 
     /* read label */
@@ -101,24 +118,75 @@ int32_t ClassificationEngine::Initialize(const std::string& work_dir, const int3
 
 int32_t ClassificationEngine::Finalize()
 {
-    if (!inference_helper_) {
+    if (interpreter_list_.empty()) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
     }
-    inference_helper_->Finalize();
+    for (auto& interpreter : interpreter_list_) {
+        interpreter.inference_helper->Finalize();
+    }
+    interpreter_list_.clear();
     return kRetOk;
 }
 
 
 int32_t ClassificationEngine::Process(const cv::Mat& original_mat, Result& result)
 {
-    if (!inference_helper_) {
+    if (interpreter_list_.empty()) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    return ProcessWithInterpreter(interpreter_list_[0], original_mat, result);
+}
+
+
+int32_t ClassificationEngine::Process(const cv::Mat& original_mat, const std::vector<cv::Rect>& roi_list, std::vector<Result>& result_list)
+{
+    if (interpreter_list_.empty()) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
     }
+    result_list.clear();
+    result_list.resize(roi_list.size());
+    if (roi_list.empty()) return kRetOk;
+
+    /* ROI[i] is processed by interpreter[i % num_interpreters]. Interpreter[0] runs on the caller thread */
+    const int32_t num_workers = (std::min)(static_cast<int32_t>(interpreter_list_.size()), static_cast<int32_t>(roi_list.size()));
+    std::vector<int32_t> ret_list(num_workers, kRetOk);
+    auto worker = [&](int32_t index_worker) {
+        for (size_t i = index_worker; i < roi_list.size(); i += num_workers) {
+            const cv::Rect roi = roi_list[i] & cv::Rect(0, 0, original_mat.cols, original_mat.rows);
+            if (roi.width <= 0 || roi.height <= 0) {
+                ret_list[index_worker] = kRetErr;
+                continue;
+            }
+            if (ProcessWithInterpreter(interpreter_list_[index_worker], original_mat(roi), result_list[i]) != kRetOk) {
+                ret_list[index_worker] = kRetErr;
+            }
+        }
+    };
+
+    std::vector<std::thread> thread_list;
+    for (int32_t index_worker = 1; index_worker < num_workers; index_worker++) {
+        thread_list.push_back(std::thread(worker, index_worker));
+    }
+    worker(0);
+    for (auto& th : thread_list) {
+        th.join();
+    }
+
+    for (const auto& ret : ret_list) {
+        if (ret != kRetOk) return kRetErr;
+    }
+    return kRetOk;
+}
+
+
+int32_t ClassificationEngine::ProcessWithInterpreter(Interpreter& interpreter, const cv::Mat& original_mat, Result& result)
+{
     /*** PreProcess ***/
     const auto& t_pre_process0 = std::chrono::steady_clock::now();
-    InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    InputTensorInfo& input_tensor_info = interpreter.input_tensor_info_list[0];
     /* do resize and color conversion here because some inference engine doesn't support these operations */
     cv::Mat img_src;
     cv::resize(original_mat, img_src, cv::Size(input_tensor_info.GetWidth(), input_tensor_info.GetHeight()));
@@ -137,31 +205,25 @@ int32_t ClassificationEngine::Process(const cv::Mat& original_mat, Result& resul
     input_tensor_info.image_info.is_bgr = false;
     input_tensor_info.image_info.swap_color = false;
 
-    if (inference_helper_->PreProcess(input_tensor_info_list_) != InferenceHelper::kRetOk) {
+    if (interpreter.inference_helper->PreProcess(interpreter.input_tensor_info_list) != InferenceHelper::kRetOk) {
         return kRetErr;
     }
     const auto& t_pre_process1 = std::chrono::steady_clock::now();
 
     /*** Inference ***/
     const auto& t_inference0 = std::chrono::steady_clock::now();
-    if (inference_helper_->Process(output_tensor_info_list_) != InferenceHelper::kRetOk) {
+    if (interpreter.inference_helper->Process(interpreter.output_tensor_info_list) != InferenceHelper::kRetOk) {
         return kRetErr;
     }
     const auto& t_inference1 = std::chrono::steady_clock::now();
 
     /*** PostProcess ***/
     const auto& t_post_process0 = std::chrono::steady_clock::now();
-    /* Retrieve the result */
-    std::vector<float> output_score_list;
-    output_score_list.resize(output_tensor_info_list_[0].GetElementNum());
-    const float* val_float = output_tensor_info_list_[0].GetDataAsFloat();
-    for (int32_t i = 0; i < (int32_t)output_score_list.size(); i++) {
-        output_score_list[i] = val_float[i];
-    }
-
     /* Find the max score */
-    int32_t max_index = (int32_t)(std::max_element(output_score_list.begin(), output_score_list.end()) - output_score_list.begin());
-    auto max_score = *std::max_element(output_score_list.begin(), output_score_list.end());
+    /* For quantized model, search in quantized domain and dequantize only the max value (the order is the same) */
+    int32_t max_index = 0;
+    float max_score = 0;
+    QuantizationUtils::ArgMaxTensor(interpreter.output_tensor_info_list[0], max_index, max_score);
     PRINT("Result = %s (%d) (%.3f)\n", label_list_[max_index].c_str(), max_index, max_score);
     const auto& t_post_process1 = std::chrono::steady_clock::now();
 
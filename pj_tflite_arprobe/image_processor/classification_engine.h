@@ -51,20 +51,29 @@ public:
 private:
     static constexpr bool with_background_ = false;
 
+    /* Each interpreter has its own tensors, so that ROIs can be processed concurrently */
+    typedef struct Interpreter_ {
+        std::unique_ptr<InferenceHelper> inference_helper;
+        std::vector<InputTensorInfo> input_tensor_info_list;
+        std::vector<OutputTensorInfo> output_tensor_info_list;
+    } Interpreter;
+
 public:
     ClassificationEngine() {}
     ~ClassificationEngine() {}
-    int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
+    int32_t Initialize(const std::string& work_dir, const int32_t num_threads, const int32_t num_interpreters = 1);
+    static std::string GetModelFilename(const std::string& work_dir);
     int32_t Finalize(void);
     int32_t Process(const cv::Mat& original_mat, Result& result);
+    /* Classify multiple ROIs in original_mat. ROIs are distributed to the interpreters and processed concurrently */
+    int32_t Process(const cv::Mat& original_mat, const std::vector<cv::Rect>& roi_list, std::vector<Result>& result_list);
 
 private:
+    int32_t ProcessWithInterpreter(Interpreter& interpreter, const cv::Mat& original_mat, Result& result);
     int32_t ReadLabel(const std::string& filename, std::vector<std::string>& label_list);
 
 private:
-    std::unique_ptr<InferenceHelper> inference_helper_;
-    std::vector<InputTensorInfo> input_tensor_info_list_;
-    std::vector<OutputTensorInfo> output_tensor_info_list_;
+    std::vector<Interpreter> interpreter_list_;
     std::vector<std::string> label_list_;
 };
 
@@ -25,6 +25,8 @@ limitations under the License.
 #include <chrono>
 #include <fstream>
 #include <memory>
+#include <future>
+#include <mutex>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -33,6 +35,8 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "lazy_engine.h"
+#include "compute_resource_manager.h"
 #include "palm_detection_engine.h"
 #include "hand_landmark_engine.h"
 #include "classification_engine.h"
@@ -47,6 +51,12 @@ limitations under the License.
 
 /*** Setting ***/
 #define INTERVAL_TO_ENFORCE_PALM_DET 5
+#define TRACKER_TARGET_SIZE_MAX      96     /* [px] target is tracked on the pyramid level where its longer side fits this size */
+#define TRACKER_PYRAMID_LEVEL_MAX    3
+#define TRACKER_HUGE_AREA_RATIO      0.1    /* use median flow for huge object because KCF becomes slow when the object size is huge */
+#define TRACKER_TINY_SIZE            24     /* [px] use MOSSE for tiny object because KCF doesn't have enough features */
+#define CLASSIFICATION_INTERPRETER_NUM 2    /* to classify the target with and without padding concurrently */
+#define CLASSIFICATION_IDLE_TIMEOUT    0    /* [msec] ClassificationEngine is loaded at the first classification (in the classification task) and unloaded after this time without it. 0 = keep loaded */
 
 class Rect {
 public:
@@ -68,20 +78,29 @@ public:
 
 typedef struct {
     cv::Ptr<cv::Tracker> tracker;
+    std::string trackerName;
+    int32_t pyramidLevel;
     int32_t numLost;
+    bool isTracked;
+    cv::Rect2d rectTracked;     /* in the original image coordinate */
+    double sizeAtInit;          /* longer side when the tracker is created */
     std::string class_name;
+    std::shared_future<std::string> class_name_future;     /* valid while classification is running */
     Rect rectFirst;
 } OBJECT_TRACKER;
 
 /*** Global variable ***/
 static std::unique_ptr<PalmDetectionEngine> s_palm_detection_engine;
 static std::unique_ptr<HandLandmarkEngine> s_hand_landmark_engine;
-static std::unique_ptr<ClassificationEngine> s_classification_engine;
+static LazyEngine<ClassificationEngine> s_classification_engine;     /* guarded by s_classification_mutex */
+static std::mutex s_classification_mutex;
 AreaSelector s_areaSelector;
 static int32_t s_frame_cnt;
 static Rect s_palm_by_lm;
 static bool s_is_palm_by_lm_valid = false;
 static std::vector<OBJECT_TRACKER> s_objectList;
+static std::vector<std::shared_future<std::string>> s_orphanFutureList;     /* classification of deleted objects. kept until it finishes, because the destructor of std::async future waits for it */
+static std::vector<cv::Mat> s_trackingPyramid;
 static int32_t s_animCount = 0;
 static bool s_isDebug = true;
 
@@ -124,6 +143,93 @@ static inline cv::Ptr<cv::Tracker> createTrackerByName(cv::String name)
     return tracker;
 }
 
+static void selectTrackerPolicy(const cv::Rect2d& rect, int32_t image_width, int32_t image_height, std::string& tracker_name, int32_t& pyramid_level)
+{
+    /* Track large objects on a downscaled image so that the cost doesn't depend on the object size */
+    pyramid_level = 0;
+    double size = (std::max)(rect.width, rect.height);
+    while (size > TRACKER_TARGET_SIZE_MAX && pyramid_level < TRACKER_PYRAMID_LEVEL_MAX) {
+        size /= 2;
+        pyramid_level++;
+    }
+
+    if (rect.width * rect.height > image_width * image_height * TRACKER_HUGE_AREA_RATIO) {
+        tracker_name = "MEDIAN_FLOW";
+    } else if (size < TRACKER_TINY_SIZE) {
+        tracker_name = "MOSSE";
+    } else {
+        tracker_name = "KCF";
+    }
+}
+
+static void updateTrackingPyramid(const cv::Mat& mat)
+{
+    /* Create only the levels which are used by the current trackers */
+    int32_t level_max = 0;
+    for (const auto& object : s_objectList) {
+        level_max = (std::max)(level_max, object.pyramidLevel);
+    }
+    s_trackingPyramid.resize(level_max + 1);
+    s_trackingPyramid[0] = mat;
+    for (int32_t level = 1; level <= level_max; level++) {
+        cv::pyrDown(s_trackingPyramid[level - 1], s_trackingPyramid[level]);
+    }
+}
+
+static cv::Rect2d scaleRect(const cv::Rect2d& rect, double scale)
+{
+    return cv::Rect2d(rect.x * scale, rect.y * scale, rect.width * scale, rect.height * scale);
+}
+
+static void initObjectTracker(OBJECT_TRACKER& object, const cv::Mat& mat, const cv::Rect2d& rect)
+{
+    selectTrackerPolicy(rect, mat.cols, mat.rows, object.trackerName, object.pyramidLevel);
+    object.tracker = createTrackerByName(object.trackerName);
+    object.rectTracked = rect;
+    object.sizeAtInit = (std::max)(rect.width, rect.height);
+    object.isTracked = true;
+
+    cv::Mat image = mat;
+    for (int32_t level = 0; level < object.pyramidLevel; level++) {
+        cv::pyrDown(image, image);
+    }
+    object.tracker->init(image, scaleRect(rect, 1.0 / (1 << object.pyramidLevel)));
+}
+
+static void updateObjectTrackers(const cv::Mat& mat)
+{
+    updateTrackingPyramid(mat);
+
+    /* Each tracker is independent, so update them in parallel to keep frame time flat as objects are added */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int32_t i = 0; i < static_cast<int32_t>(s_objectList.size()); i++) {
+        auto& object = s_objectList[i];
+        cv::Rect2d rect;
+        object.isTracked = object.tracker->update(s_trackingPyramid[object.pyramidLevel], rect);
+        if (object.isTracked) {
+            object.rectTracked = scaleRect(rect, 1 << object.pyramidLevel);
+        }
+    }
+
+    /* Re-create the tracker when the object size changes a lot and another tracker / pyramid level suits better */
+    for (auto& object : s_objectList) {
+        if (!object.isTracked || object.rectTracked.width <= 0 || object.rectTracked.height <= 0) continue;
+        double size_ratio = (std::max)(object.rectTracked.width, object.rectTracked.height) / object.sizeAtInit;
+        if (size_ratio > 0.5 && size_ratio < 2.0) continue;    /* hysteresis to avoid re-creating the tracker every frame */
+        std::string tracker_name;
+        int32_t pyramid_level;
+        selectTrackerPolicy(object.rectTracked, mat.cols, mat.rows, tracker_name, pyramid_level);
+        if (tracker_name != object.trackerName || pyramid_level != object.pyramidLevel) {
+            cv::Rect2d rect = object.rectTracked & cv::Rect2d(0, 0, mat.cols, mat.rows);
+            if (rect.width > 0 && rect.height > 0) {
+                initObjectTracker(object, mat, rect);
+            }
+        }
+    }
+}
+
 static void drawRing(cv::Mat &mat, Rect rect, cv::Scalar color, int animCount)
 {
     /* Reference: https://github.com/Kazuhito00/object-detection-bbox-art */
@@ -163,10 +269,11 @@ static void drawRing(cv::Mat &mat, Rect rect, cv::Scalar color, int animCount)
     cv::ellipse(mat, cv::Point(center), radius, 0 + animCount, 0, 50, color, ring_thickness);
 }
 
-static std::string classify(cv::Mat &mat, const cv::Rect &selectedArea)
+static std::shared_future<std::string> classifyAsync(const cv::Mat &mat, const cv::Rect &selectedArea)
 {
-    /* Classify the selected area */
-    cv::Rect targetArea = s_areaSelector.m_selectedArea;
+    /* Classify the selected area with and without padding, and use the better one */
+    std::vector<cv::Rect> roi_list;
+    cv::Rect targetArea = selectedArea;
     const int centerX = targetArea.x + targetArea.width / 2;
     const int centerY = targetArea.y + targetArea.height / 2;
     int width = (int)(targetArea.width * 1.2); // expand
@@ -175,9 +282,7 @@ static std::string classify(cv::Mat &mat, const cv::Rect &selectedArea)
     targetArea.y = std::max(centerY - height / 2, 0);
     targetArea.width = std::min(width, mat.cols - targetArea.x);
     targetArea.height = std::min(height, mat.rows - targetArea.y);
-    cv::Mat targetImage = mat(targetArea);
-    ClassificationEngine::Result resultWithoutPadding;
-    s_classification_engine->Process(targetImage, resultWithoutPadding);
+    roi_list.push_back(targetArea);
 
     width = std::max(targetArea.width, targetArea.height);
     height = std::max(targetArea.width, targetArea.height);
@@ -185,58 +290,128 @@ static std::string classify(cv::Mat &mat, const cv::Rect &selectedArea)
     targetArea.y = std::max(centerY - height / 2, 0);
     targetArea.width = std::min(width, mat.cols - targetArea.x);
     targetArea.height = std::min(height, mat.rows - targetArea.y);
-    cv::Mat targetImageWithPadding = mat(targetArea);
+    roi_list.push_back(targetArea);
+
+    /* Copy only the area covering the ROIs because mat is overwritten by the next frame */
+    const cv::Rect copyArea = roi_list[0] | roi_list[1];
+    cv::Mat image = mat(copyArea).clone();
+    for (auto& roi : roi_list) {
+        roi.x -= copyArea.x;
+        roi.y -= copyArea.y;
+    }
 
-    ClassificationEngine::Result resultWithPadding;
-    s_classification_engine->Process(targetImageWithPadding, resultWithPadding);
+    /* Run classification and merge the results off the render thread */
+    return std::async(std::launch::async, [image, roi_list]() -> std::string {
+        std::lock_guard<std::mutex> lock(s_classification_mutex);
+        ComputeResourceManager::Budget budget;
+        if (ComputeResourceManager::GetInstance().GetBudget("ClassificationEngine", budget)) {
+            ComputeResourceManager::SetCurrentThreadAffinity(budget.cpu_list);
+        }
+        ClassificationEngine* classification_engine = s_classification_engine.Get();     /* loaded here at the first time */
+        if (s_classification_engine.IsError()) {
+            PRINT_E("Failed to load ClassificationEngine\n");
+            return "";
+        }
+        std::vector<ClassificationEngine::Result> result_list;
+        if (!classification_engine || classification_engine->Process(image, roi_list, result_list) != ClassificationEngine::kRetOk) {
+            return "";
+        }
+        const auto& resultWithoutPadding = result_list[0];
+        const auto& resultWithPadding = result_list[1];
+        return (resultWithoutPadding.score > resultWithPadding.score) ? resultWithoutPadding.class_name : resultWithPadding.class_name;
+    }).share();
+}
+
+static void waitClassification(void)
+{
+    for (auto& object : s_objectList) {
+        if (object.class_name_future.valid()) {
+            object.class_name_future.wait();
+        }
+    }
+    for (auto& future : s_orphanFutureList) {
+        future.wait();
+    }
+    s_orphanFutureList.clear();
+}
 
-    return (resultWithoutPadding.score > resultWithPadding.score) ? resultWithoutPadding.class_name : resultWithPadding.class_name;
+static void reapClassification(void)
+{
+    s_orphanFutureList.erase(std::remove_if(s_orphanFutureList.begin(), s_orphanFutureList.end(), [](const std::shared_future<std::string>& future) {
+        return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), s_orphanFutureList.end());
+}
+
+static std::vector<OBJECT_TRACKER>::iterator eraseObject(std::vector<OBJECT_TRACKER>::iterator it)
+{
+    /* Don't block the render thread until the pending classification finishes */
+    if (it->class_name_future.valid()) {
+        s_orphanFutureList.push_back(it->class_name_future);
+    }
+    return s_objectList.erase(it);
 }
 
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
-    if (s_palm_detection_engine || s_hand_landmark_engine || s_classification_engine) {
+    if (s_palm_detection_engine || s_hand_landmark_engine || s_classification_engine.IsSetup()) {
         PRINT_E("Already initialized\n");
         return -1;
     }
 
+    /* Classification runs in parallel with the frame loop, so it gets its own cores. Reserve it first so that the others don't use its cores */
+    auto& resource_manager = ComputeResourceManager::GetInstance();
+    const auto budget_classification = resource_manager.Reserve("ClassificationEngine", CLASSIFICATION_INTERPRETER_NUM, ComputeResourceManager::kConcurrent);
+    const int32_t num_threads_main = resource_manager.ConfigureMainThread(input_param.num_threads);
+
     s_palm_detection_engine.reset(new PalmDetectionEngine());
-    if (s_palm_detection_engine->Initialize(input_param.work_dir, input_param.num_threads) != PalmDetectionEngine::kRetOk) {
+    if (s_palm_detection_engine->Initialize(input_param.work_dir, resource_manager.Reserve("PalmDetectionEngine", input_param.num_threads).num_threads) != PalmDetectionEngine::kRetOk) {
         return -1;
     }
     s_hand_landmark_engine.reset(new HandLandmarkEngine());
-    if (s_hand_landmark_engine->Initialize(input_param.work_dir, input_param.num_threads) != HandLandmarkEngine::kRetOk) {
+    if (s_hand_landmark_engine->Initialize(input_param.work_dir, resource_manager.Reserve("HandLandmarkEngine", input_param.num_threads).num_threads) != HandLandmarkEngine::kRetOk) {
         return -1;
     }
-    s_classification_engine.reset(new ClassificationEngine());
-    if (s_classification_engine->Initialize(input_param.work_dir, input_param.num_threads) != HandLandmarkEngine::kRetOk) {
-        return -1;
+    {
+        /* Not loaded here. It's loaded synchronously in the classification task, which already runs off the render thread on the cores of the budget */
+        const std::string work_dir = input_param.work_dir;
+        const int32_t num_threads = budget_classification.num_threads;
+        std::lock_guard<std::mutex> lock(s_classification_mutex);
+        if (s_classification_engine.Setup([work_dir, num_threads](ClassificationEngine& engine) {
+            return engine.Initialize(work_dir, num_threads, CLASSIFICATION_INTERPRETER_NUM);
+        }, ClassificationEngine::GetModelFilename(work_dir), budget_classification, CLASSIFICATION_IDLE_TIMEOUT, false) != LazyEngine<ClassificationEngine>::kRetOk) {
+            return -1;
+        }
     }
 
-    cv::setNumThreads(input_param.num_threads);
+    cv::setNumThreads(num_threads_main);
 
     return 0;
 }
 
 int32_t ImageProcessor::Finalize(void)
 {
-    if (!s_palm_detection_engine || !s_hand_landmark_engine || !s_classification_engine) {
+    if (!s_palm_detection_engine || !s_hand_landmark_engine || !s_classification_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
 
+    waitClassification();
+    s_objectList.clear();
+
     if (s_palm_detection_engine->Finalize() != PalmDetectionEngine::kRetOk) {
         return -1;
     }
     if (s_hand_landmark_engine->Finalize() != HandLandmarkEngine::kRetOk) {
         return -1;
     }
-    if (s_classification_engine->Finalize() != HandLandmarkEngine::kRetOk) {
-        return -1;
+    {
+        std::lock_guard<std::mutex> lock(s_classification_mutex);
+        s_classification_engine.Release();
     }
     s_palm_detection_engine.reset();
     s_hand_landmark_engine.reset();
-    s_classification_engine.reset();
+
+    ComputeResourceManager::GetInstance().Reset();
 
     return 0;
 }
@@ -244,7 +419,7 @@ int32_t ImageProcessor::Finalize(void)
 
 int32_t ImageProcessor::Command(int32_t cmd)
 {
-    if (!s_palm_detection_engine || !s_hand_landmark_engine || !s_classification_engine) {
+    if (!s_palm_detection_engine || !s_hand_landmark_engine || !s_classification_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -263,13 +438,21 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
 int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
 {
-    if (!s_palm_detection_engine || !s_hand_landmark_engine || !s_classification_engine) {
+    if (!s_palm_detection_engine || !s_hand_landmark_engine || !s_classification_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
 
     s_frame_cnt++;
 
+    {
+        /* Don't wait for the running classification */
+        std::unique_lock<std::mutex> lock(s_classification_mutex, std::try_to_lock);
+        if (lock.owns_lock()) {
+            s_classification_engine.CheckIdle();
+        }
+    }
+
     bool enforce_palm_det = (s_frame_cnt % INTERVAL_TO_ENFORCE_PALM_DET) == 0;		// to increase accuracy
     //bool enforce_palm_det = false;
     bool is_palm_valid = false;
@@ -358,18 +541,12 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
             break;
         case AreaSelector::STATUS_AREA_SELECT_SELECTED:
         {
-            std::string class_name = classify(mat, s_areaSelector.m_selectedArea);
-
-            /* Add a new tracker for the selected area */
+            /* Add a new tracker for the selected area (tracker type and pyramid level are selected by the object size) */
             OBJECT_TRACKER object;
-            if (s_areaSelector.m_selectedArea.width * s_areaSelector.m_selectedArea.height > mat.cols * mat.rows * 0.1) {
-                //object.tracker = createTrackerByName("MEDIAN_FLOW");	// Use median flow for hube object because KCF becomes slow when the object size is huge
-            } else {
-                //object.tracker = createTrackerByName("KCF");
-            }
-            object.tracker->init(mat, cv::Rect(s_areaSelector.m_selectedArea));
+            initObjectTracker(object, mat, cv::Rect2d(s_areaSelector.m_selectedArea));
             object.numLost = 0;
-            object.class_name = class_name;
+            object.class_name = "...";
+            object.class_name_future = classifyAsync(mat, s_areaSelector.m_selectedArea);
             //object.rectFirst = s_selectedArea;
             s_objectList.push_back(object);
         }
@@ -382,22 +559,27 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     /* Track and display tracked objects */
 
     s_animCount++;
+    updateObjectTrackers(mat);
+    reapClassification();
     for (auto it = s_objectList.begin(); it != s_objectList.end();) {
         auto tracker = it->tracker;
-        cv::Rect2d trackedRect;
-        if (tracker->update(mat, trackedRect)) {
-            //cv::rectangle(mat, trackedRect, cv::Scalar(255, 0, 0), 2, 1);
+        if (it->class_name_future.valid() && it->class_name_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            it->class_name = it->class_name_future.get();
+            it->class_name_future = std::shared_future<std::string>();
+        }
+        if (it->isTracked) {
+            //cv::rectangle(mat, it->rectTracked, cv::Scalar(255, 0, 0), 2, 1);
             Rect rect;
-            rect.x = (int)trackedRect.x;
-            rect.y = (int)trackedRect.y;
-            rect.width = (int)trackedRect.width;
-            rect.height = (int)trackedRect.height;
+            rect.x = (int)it->rectTracked.x;
+            rect.y = (int)it->rectTracked.y;
+            rect.width = (int)it->rectTracked.width;
+            rect.height = (int)it->rectTracked.height;
             drawRing(mat, rect, CommonHelper::CreateCvColor(255, 255, 205), s_animCount);
-            CommonHelper::DrawText(mat, rect, CommonHelper::CreateCvColor(207, 161, 69), it->class_name, s_animCount);
+            CommonHelper::DrawText(mat, it->class_name, cv::Point(rect.x, rect.y), 0.8, 2, CommonHelper::CreateCvColor(207, 161, 69), CommonHelper::CreateCvColor(255, 255, 255), false);
             it->numLost = 0;
             if (rect.width > mat.cols * 0.9) {	// in case median flow outputs crazy result
                 PRINT("delete due to too big result\n");
-                it = s_objectList.erase(it);
+                it = eraseObject(it);
                 tracker.release();
             } else {
                 it++;
@@ -406,7 +588,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
             PRINT("lost\n");
             if (++(it->numLost) > 20) {
                 PRINT("delete\n");
-                it = s_objectList.erase(it);
+                it = eraseObject(it);
                 tracker.release();
             } else {
                 it++;
@@ -162,4 +162,20 @@ namespace mediapipe {
 		return 0;
 	}
 
+	int GenerateAnchors(AnchorsSoA* anchors, const SsdAnchorsCalculatorOptions& options) {
+		std::vector<Anchor> anchor_list;
+		int ret = GenerateAnchors(&anchor_list, options);
+		anchors->x_center.resize(anchor_list.size());
+		anchors->y_center.resize(anchor_list.size());
+		anchors->h.resize(anchor_list.size());
+		anchors->w.resize(anchor_list.size());
+		for (size_t i = 0; i < anchor_list.size(); ++i) {
+			anchors->x_center[i] = anchor_list[i].x_center();
+			anchors->y_center[i] = anchor_list[i].y_center();
+			anchors->h[i] = anchor_list[i].h();
+			anchors->w[i] = anchor_list[i].w();
+		}
+		return ret;
+	}
+
 }  // namespace mediapipe
@@ -72,5 +72,6 @@ public:
 
 
 namespace mediapipe {
-	int Process(const TfLiteTensorsToDetectionsCalculatorOptions &options, const float* raw_boxes, const float* raw_scores, const std::vector<Anchor>& anchors, std::vector<Detection>& output_detections);
+	// Editor: scores are checked first, and boxes/keypoints are decoded only for the boxes whose score passes min_score_thresh
+	int Process(const TfLiteTensorsToDetectionsCalculatorOptions &options, const float* raw_boxes, const float* raw_scores, const AnchorsSoA& anchors, std::vector<Detection>& output_detections);
 }
\ No newline at end of file
@@ -50,7 +50,7 @@ limitations under the License.
 static float CalculateRotation(const Detection& det);
 static void Nms(std::vector<Detection>& detection_list, std::vector<Detection>& detection_list_nms, bool use_weight);
 static void RectTransformationCalculator(const Detection& det, const float rotation, float& x, float& y, float& width, float& height);
-static std::vector<Anchor> s_anchors;
+static AnchorsSoA s_anchors;
 
 /*** Function ***/
 int32_t PalmDetectionEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
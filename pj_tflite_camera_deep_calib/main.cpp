@@ -33,7 +33,7 @@ limitations under the License.
 #define LOOP_NUM_FOR_TIME_MEASUREMENT 3
 
 /*** Function ***/
-static bool InputKeyCommand(cv::VideoCapture& cap)
+static bool InputKeyCommand(CommonHelper::VideoSource& cap)
 {
     bool ret_to_quit = false;
     static bool is_pause = false;
@@ -45,7 +45,7 @@ static bool InputKeyCommand(cv::VideoCapture& cap)
             ImageProcessor::Command(0);
             break;
         case 'q':
-            cap.release();
+            cap.Release();
             ret_to_quit = true;
             break;
         case 'p':
@@ -55,17 +55,17 @@ static bool InputKeyCommand(cv::VideoCapture& cap)
             if (is_pause) {
                 is_process_one_frame = true;
             } else {
-                int32_t current_frame = static_cast<int32_t>(cap.get(cv::CAP_PROP_POS_FRAMES));
-                cap.set(cv::CAP_PROP_POS_FRAMES, current_frame + 100);
+                int32_t current_frame = static_cast<int32_t>(cap.Get(cv::CAP_PROP_POS_FRAMES));
+                cap.Set(cv::CAP_PROP_POS_FRAMES, current_frame + 100);
             }
             break;
         case '<':
-            int32_t current_frame = static_cast<int32_t>(cap.get(cv::CAP_PROP_POS_FRAMES));
+            int32_t current_frame = static_cast<int32_t>(cap.Get(cv::CAP_PROP_POS_FRAMES));
             if (is_pause) {
                 is_process_one_frame = true;
-                cap.set(cv::CAP_PROP_POS_FRAMES, current_frame - 2);
+                cap.Set(cv::CAP_PROP_POS_FRAMES, current_frame - 2);
             } else {
-                cap.set(cv::CAP_PROP_POS_FRAMES, current_frame - 100);
+                cap.Set(cv::CAP_PROP_POS_FRAMES, current_frame - 100);
             }
             break;
         }
@@ -87,14 +87,14 @@ int32_t main(int argc, char* argv[])
 
     /* Find source image */
     std::string input_name = (argc > 1) ? argv[1] : DEFAULT_INPUT_IMAGE;
-    cv::VideoCapture cap;   /* if cap is not opened, src is still image */
-    if (!CommonHelper::FindSourceImage(input_name, cap)) {
+    CommonHelper::VideoSource cap;   /* decoded on a background thread. if cap is not video, src is still image */
+    if (!cap.Open(input_name)) {
         return -1;
     }
 
     /* Create video writer to save output video */
-    cv::VideoWriter writer;
-    // writer = cv::VideoWriter("out.mp4", cv::VideoWriter::fourcc('M', 'P', '4', 'V'), (std::max)(10.0, cap.get(cv::CAP_PROP_FPS)), cv::Size(static_cast<int32_t>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int32_t>(cap.get(cv::CAP_PROP_FRAME_HEIGHT))));
+    CommonHelper::VideoSink writer;   /* frames are encoded on a background thread */
+    // writer.Open("out.mp4", cap);
 
     /* Initialize image processor library */
     ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
@@ -105,16 +105,12 @@ int32_t main(int argc, char* argv[])
 
     /*** Process for each frame ***/
     int32_t frame_cnt = 0;
-    for (frame_cnt = 0; cap.isOpened() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
+    for (frame_cnt = 0; cap.IsVideo() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
         const auto& time_all0 = std::chrono::steady_clock::now();
         /* Read image */
         const auto& time_cap0 = std::chrono::steady_clock::now();
         cv::Mat image;
-        if (cap.isOpened()) {
-            cap.read(image);
-        } else {
-            image = cv::imread(input_name);
-        }
+        cap.Read(image);
         if (image.empty()) break;
         cv::Mat image_src = image.clone();
         const auto& time_cap1 = std::chrono::steady_clock::now();
@@ -126,12 +122,12 @@ int32_t main(int argc, char* argv[])
         const auto& time_image_process1 = std::chrono::steady_clock::now();
 
         /* Display result */
-        if (writer.isOpened()) writer.write(image);
+        if (writer.IsOpened()) writer.Write(image);
         cv::imshow("src", image_src);
         cv::imshow("dst", image);
 
         /* Input key command */
-        if (cap.isOpened()) {
+        if (cap.IsVideo()) {
             /* this code needs to be before calculating processing time because cv::waitKey includes image output */
             /* however, when 'q' key is pressed (cap.released()), processing time significantly incraeases. So escape from the loop before calculating time */
             if (InputKeyCommand(cap)) break;
@@ -175,7 +171,7 @@ int32_t main(int argc, char* argv[])
 
     /* Fianlize image processor library */
     ImageProcessor::Finalize();
-    if (writer.isOpened()) writer.release();
+    if (writer.IsOpened()) writer.Release();
     cv::waitKey(-1);
 
     return 0;
@@ -32,6 +32,7 @@ limitations under the License.
 #include "common_helper.h"
 #include "common_helper_cv.h"
 #include "inference_helper.h"
+#include "quantization_utils.h"
 #include "classification_engine.h"
 
 /*** Macro ***/
@@ -199,17 +200,11 @@ int32_t ClassificationEngine::Process(const cv::Mat& original_mat, Result& resul
 
     /*** PostProcess ***/
     const auto& t_post_process0 = std::chrono::steady_clock::now();
-    /* Retrieve the result */
-    std::vector<float> output_score_list;
-    output_score_list.resize(output_tensor_info_list_[0].GetElementNum());
-    const float* val_float = output_tensor_info_list_[0].GetDataAsFloat();
-    for (int32_t i = 0; i < (int32_t)output_score_list.size(); i++) {
-        output_score_list[i] = val_float[i];
-    }
-
     /* Find the max score */
-    int32_t max_index = (int32_t)(std::max_element(output_score_list.begin(), output_score_list.end()) - output_score_list.begin());
-    auto max_score = *std::max_element(output_score_list.begin(), output_score_list.end());
+    /* For quantized model, search in quantized domain and dequantize only the max value (the order is the same) */
+    int32_t max_index = 0;
+    float max_score = 0;
+    QuantizationUtils::ArgMaxTensor(output_tensor_info_list_[0], max_index, max_score);
     PRINT("Result = %s (%d) (%.3f)\n", label_list_[max_index].c_str(), max_index, max_score);
     const auto& t_post_process1 = std::chrono::steady_clock::now();
 
@@ -32,6 +32,9 @@ limitations under the License.
 #include "common_helper.h"
 #include "common_helper_cv.h"
 #include "inference_helper.h"
+#include "inference_pipeline.h"
+#include "compute_resource_manager.h"
+#include "startup_profiler.h"
 #include "depth_engine.h"
 
 /*** Macro ***/
@@ -72,9 +75,22 @@ limitations under the License.
 #define TENSORTYPE  TensorInfo::kTensorTypeFp32
 #endif
 
+/* Pipeline parallel mode (TFLite only)
+ *   The model is split in advance into MODEL_SEGMENT_NUM files (MODEL_SEGMENT_NAME_BASE + "_segment_i_of_N.tflite"),
+ *   and each segment runs on its own thread and cores. SEGMENT_BOUNDARY_NAME_LIST is the names of tensors between segments (N - 1 boundaries. the names here are an example and depend on how the model is split)
+ *   0 = use MODEL_NAME as a single model */
+#define MODEL_SEGMENT_NUM           0
+#define MODEL_SEGMENT_NAME_BASE     "lite-model_midas_v2_1_small_1_lite_1"
+#define SEGMENT_BOUNDARY_NAME_LIST  { { "midas_net_custom/sequential/re_lu_4/Relu" } }
+
+/* Number of inferences in Initialize to make the first frame as fast as others (single model only) */
+static constexpr int32_t kWarmupNum = 1;
+
 /*** Function ***/
 int32_t DepthEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
 {
+    StartupProfiler profiler(TAG);
+
     /* Set model information */
     std::string model_filename = work_dir + "/model/" + MODEL_NAME;
 
@@ -95,6 +111,17 @@ int32_t DepthEngine::Initialize(const std::string& work_dir, const int32_t num_t
     output_tensor_info_list_.clear();
     output_tensor_info_list_.push_back(OutputTensorInfo(OUTPUT_NAME, TENSORTYPE));
 
+#if defined(MODEL_TYPE_TFLITE)
+    if (MODEL_SEGMENT_NUM > 1) {
+        if (InitializePipeline(work_dir, num_threads) != kRetOk) {
+            return kRetErr;
+        }
+        profiler.Mark("initialize");
+        profiler.Finish();
+        return kRetOk;
+    }
+#endif
+
     /* Create and Initialize Inference Helper */
 #if defined(MODEL_TYPE_TFLITE)
     //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLite));
@@ -118,12 +145,83 @@ int32_t DepthEngine::Initialize(const std::string& work_dir, const int32_t num_t
         inference_helper_.reset();
         return kRetErr;
     }
+    profiler.Mark("initialize");    /* model load, delegate init and weight packing */
+
+    /* The first invocations are slow (XNNPACK packs weights, buffers are allocated). Do them here instead of at the first frame */
+    if (Warmup(kWarmupNum) != kRetOk) {
+        return kRetErr;
+    }
+    profiler.Mark("warmup");
+    profiler.Finish();
 
     return kRetOk;
 }
 
+/* Run inference on a gray image so that lazy allocation and weight packing are done before the first frame */
+int32_t DepthEngine::Warmup(int32_t warmup_num)
+{
+    cv::Mat img_src = cv::Mat(input_tensor_info_list_[0].GetHeight(), input_tensor_info_list_[0].GetWidth(), CV_8UC3, cv::Scalar(128, 128, 128));
+    for (int32_t i = 0; i < warmup_num; i++) {
+        Result result;
+        if (Process(img_src, result) != kRetOk) {
+            return kRetErr;
+        }
+    }
+    return kRetOk;
+}
+
+int32_t DepthEngine::InitializePipeline(const std::string& work_dir, const int32_t num_threads)
+{
+    const int32_t segment_num = MODEL_SEGMENT_NUM;
+    const std::vector<std::vector<std::string>> boundary_name_list = SEGMENT_BOUNDARY_NAME_LIST;
+    if (static_cast<int32_t>(boundary_name_list.size()) != segment_num - 1) {
+        PRINT_E("SEGMENT_BOUNDARY_NAME_LIST must have %d boundaries\n", segment_num - 1);
+        return kRetErr;
+    }
+
+    /* Segments run in parallel, so each of them gets its own cores */
+    const int32_t num_threads_per_segment = (std::max)(1, num_threads / segment_num);
+
+    std::vector<InferencePipeline::Segment> segment_list(segment_num);
+    for (int32_t i = 0; i < segment_num; i++) {
+        InferencePipeline::Segment& segment = segment_list[i];
+        segment.model_filename = InferencePipeline::GetSegmentModelFilename(work_dir + "/model/" + MODEL_SEGMENT_NAME_BASE, i, segment_num);
+        segment.helper_type = InferenceHelper::kTensorflowLiteXnnpack;
+        const auto budget = ComputeResourceManager::GetInstance().Reserve(std::string(TAG) + ".segment" + std::to_string(i), num_threads_per_segment, ComputeResourceManager::kConcurrent);
+        segment.num_threads = budget.num_threads;
+        segment.cpu_list = budget.cpu_list;
+        if (i == 0) {
+            segment.input_tensor_info_list = input_tensor_info_list_;
+        } else {
+            for (const auto& name : boundary_name_list[i - 1]) {
+                segment.input_tensor_info_list.push_back(InputTensorInfo(name, TENSORTYPE, false));
+            }
+        }
+        if (i == segment_num - 1) {
+            segment.output_tensor_info_list = output_tensor_info_list_;
+        } else {
+            for (const auto& name : boundary_name_list[i]) {
+                segment.output_tensor_info_list.push_back(OutputTensorInfo(name, TENSORTYPE));
+            }
+        }
+    }
+
+    pipeline_.reset(new InferencePipeline());
+    if (pipeline_->Initialize(segment_list, segment_num) != InferencePipeline::kRetOk) {
+        pipeline_.reset();
+        return kRetErr;
+    }
+    pipeline_crop_queue_.clear();
+    return kRetOk;
+}
+
 int32_t DepthEngine::Finalize()
 {
+    if (pipeline_) {
+        pipeline_->Finalize();
+        pipeline_.reset();
+        return kRetOk;
+    }
     if (!inference_helper_) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
@@ -135,7 +233,7 @@ int32_t DepthEngine::Finalize()
 
 int32_t DepthEngine::Process(const cv::Mat& original_mat, Result& result)
 {
-    if (!inference_helper_) {
+    if (!inference_helper_ && !pipeline_) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
     }
@@ -163,6 +261,21 @@ int32_t DepthEngine::Process(const cv::Mat& original_mat, Result& result)
     input_tensor_info.image_info.crop_height = img_src.rows;
     input_tensor_info.image_info.is_bgr = false;
     input_tensor_info.image_info.swap_color = false;
+    if (pipeline_) {
+        /* Push the current frame and retrieve the oldest one. Pre-process and inference are done in the pipeline */
+        if (pipeline_->Push(input_tensor_info_list_) < 0) {
+            return kRetErr;
+        }
+        /* Queue the crop only for a pushed frame, so that it's popped together with the frame */
+        Result::crop_ crop;
+        crop.x = crop_x;
+        crop.y = crop_y;
+        crop.w = crop_w;
+        crop.h = crop_h;
+        pipeline_crop_queue_.push_back(crop);
+        result.time_pre_process = static_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - t_pre_process0).count() * 1000.0;
+        return ProcessPipeline(result);
+    }
     if (inference_helper_->PreProcess(input_tensor_info_list_) != InferenceHelper::kRetOk) {
         return kRetErr;
     }
@@ -184,15 +297,15 @@ int32_t DepthEngine::Process(const cv::Mat& original_mat, Result& result)
     float* values = output_tensor_info_list_[0].GetDataAsFloat();
     //printf("%f, %f, %f\n", values[0], values[100], values[400]);
     cv::Mat mat_out = cv::Mat(output_height, output_width, CV_32FC1, values);  /* value has no specific range */
-    
-    /* (255 * (prediction - depth_min) / (depth_max - depth_min)) */
-    double depth_min, depth_max;
-    cv::minMaxLoc(mat_out, &depth_min, &depth_max);
-    mat_out.convertTo(mat_out, CV_8UC1, 255. / (depth_max - depth_min), (-255. * depth_min) / (depth_max - depth_min));
+    /* Normalization is done by DepthPostProcessor, which tracks the range across frames */
     const auto& t_post_process1 = std::chrono::steady_clock::now();
 
     /* Return the results */
     result.mat_out = mat_out;
+    result.crop.x = crop_x;
+    result.crop.y = crop_y;
+    result.crop.w = crop_w;
+    result.crop.h = crop_h;
     result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
     result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
     result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;;
@@ -200,3 +313,33 @@ int32_t DepthEngine::Process(const cv::Mat& original_mat, Result& result)
     return kRetOk;
 }
 
+int32_t DepthEngine::ProcessPipeline(Result& result)
+{
+    /* Keep (segment_num - 1) frames in flight so that all segments work in parallel */
+    if (pipeline_->GetNumInFlight() < pipeline_->GetSegmentNum()) {
+        result.mat_out = cv::Mat();
+        return kRetOk;
+    }
+    if (pipeline_->Pop(pipeline_output_) != InferencePipeline::kRetOk) {
+        pipeline_crop_queue_.pop_front();
+        return kRetErr;
+    }
+
+    /*** PostProcess ***/
+    const auto& t_post_process0 = std::chrono::steady_clock::now();
+    const auto& output_tensor_info = pipeline_->GetOutputTensorInfoList()[0];
+    int32_t output_height = output_tensor_info.tensor_dims[1];
+    int32_t output_width = output_tensor_info.tensor_dims[2];
+    float* values = reinterpret_cast<float*>(pipeline_output_.data_list[0].data());
+    cv::Mat mat_out = cv::Mat(output_height, output_width, CV_32FC1, values);  /* value has no specific range */
+    const auto& t_post_process1 = std::chrono::steady_clock::now();
+
+    /* Return the results */
+    result.mat_out = mat_out;
+    result.crop = pipeline_crop_queue_.front();
+    pipeline_crop_queue_.pop_front();
+    result.time_inference = pipeline_output_.time_inference;
+    result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;
+
+    return kRetOk;
+}
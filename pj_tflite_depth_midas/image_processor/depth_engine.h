@@ -21,6 +21,7 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include <array>
+#include <deque>
 #include <memory>
 
 /* for OpenCV */
@@ -28,6 +29,7 @@ limitations under the License.
 
 /* for My modules */
 #include "inference_helper.h"
+#include "inference_pipeline.h"
 
 
 class DepthEngine {
@@ -38,7 +40,15 @@ public:
     };
 
     typedef struct Result_ {
-        cv::Mat           mat_out;              // [height, width, 1]. value is 0 - 255
+        cv::Mat           mat_out;              // [height, width, 1]. CV_32FC1, relative inverse depth (no specific range). refers to the output tensor, so valid until the next Process
+                                                // in pipeline mode, this is the result of the frame (segment_num - 1) frames before, and empty until the pipeline is filled
+        struct crop_ {                          // area in the original image which mat_out covers (can be out of the image because of padding)
+            int32_t x;
+            int32_t y;
+            int32_t w;
+            int32_t h;
+            crop_() : x(0), y(0), w(0), h(0) {}
+        } crop;
         double            time_pre_process;		// [msec]
         double            time_inference;		// [msec]
         double            time_post_process;	// [msec]
@@ -54,10 +64,20 @@ public:
     int32_t Process(const cv::Mat& original_mat, Result& result);
 
 
+private:
+    int32_t InitializePipeline(const std::string& work_dir, const int32_t num_threads);
+    int32_t Warmup(int32_t warmup_num);
+    int32_t ProcessPipeline(Result& result);
+
 private:
     std::unique_ptr<InferenceHelper> inference_helper_;
     std::vector<InputTensorInfo> input_tensor_info_list_;
     std::vector<OutputTensorInfo> output_tensor_info_list_;
+
+    /* for pipeline mode (model is split into segments) */
+    std::unique_ptr<InferencePipeline> pipeline_;
+    InferencePipeline::Output pipeline_output_;
+    std::deque<Result::crop_> pipeline_crop_queue_;
 };
 
 #endif
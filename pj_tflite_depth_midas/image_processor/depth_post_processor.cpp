@@ -0,0 +1,130 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+/*** Include ***/
+/* for general */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/* for My modules */
+#include "common_helper.h"
+#include "depth_post_processor.h"
+
+/*** Macro ***/
+#define TAG "DepthPostProcessor"
+#define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
+#define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
+
+
+/*** Function ***/
+DepthPostProcessor::DepthPostProcessor(float range_smoothing, float temporal_smoothing, int32_t colormap)
+{
+    SetRangeSmoothing(range_smoothing);
+    SetTemporalSmoothing(temporal_smoothing);
+
+    /* Create LUT (0 - 255 -> color) once, instead of calling applyColorMap for every frame */
+    std::vector<uint8_t> seq_num(256);
+    for (int32_t i = 0; i < 256; i++) seq_num[i] = static_cast<uint8_t>(i);
+    cv::Mat mat_seq = cv::Mat(256, 1, CV_8UC1, seq_num.data());
+    cv::Mat mat_colormap;
+    cv::applyColorMap(mat_seq, mat_colormap, colormap);
+    for (int32_t i = 0; i < 256; i++) {
+        color_lut_[i] = mat_colormap.at<cv::Vec3b>(i);
+    }
+
+    Reset();
+}
+
+void DepthPostProcessor::Reset()
+{
+    is_range_valid_ = false;
+    depth_min_ = 0.0f;
+    depth_max_ = 0.0f;
+    mat_depth_filtered_.release();
+}
+
+void DepthPostProcessor::SetRangeSmoothing(float range_smoothing)
+{
+    range_smoothing_ = (std::min)(1.0f, (std::max)(0.0f, range_smoothing));
+}
+
+void DepthPostProcessor::SetTemporalSmoothing(float temporal_smoothing)
+{
+    temporal_smoothing_ = (std::min)(1.0f, (std::max)(0.0f, temporal_smoothing));
+    mat_depth_filtered_.release();
+}
+
+float DepthPostProcessor::GetTemporalSmoothing() const
+{
+    return temporal_smoothing_;
+}
+
+void DepthPostProcessor::Process(const cv::Mat& mat_depth, cv::Mat& mat_color)
+{
+    if (mat_depth.type() != CV_32FC1 || !mat_depth.isContinuous()) {
+        PRINT_E("Invalid depth mat\n");
+        return;
+    }
+    const int32_t num = mat_depth.rows * mat_depth.cols;
+    mat_color.create(mat_depth.size(), CV_8UC3);
+
+    /* Temporal filter is applied to the input, so it's done in the same loop */
+    const bool use_temporal_filter = (temporal_smoothing_ > 0.0f && temporal_smoothing_ < 1.0f);
+    if (use_temporal_filter && mat_depth_filtered_.size() != mat_depth.size()) {
+        mat_depth_filtered_ = mat_depth.clone();
+    }
+
+    /* The range is unknown only at the first frame */
+    if (!is_range_valid_) {
+        double depth_min, depth_max;
+        cv::minMaxLoc(mat_depth, &depth_min, &depth_max);
+        depth_min_ = static_cast<float>(depth_min);
+        depth_max_ = static_cast<float>(depth_max);
+        is_range_valid_ = true;
+    }
+
+    /* (255 * (prediction - depth_min) / (depth_max - depth_min)) */
+    const float offset = depth_min_;
+    const float scale = 255.0f / (std::max)(depth_max_ - depth_min_, 1e-6f);
+    const float a = temporal_smoothing_;
+    const float* src = reinterpret_cast<const float*>(mat_depth.data);
+    float* filtered = use_temporal_filter ? reinterpret_cast<float*>(mat_depth_filtered_.data) : nullptr;
+    cv::Vec3b* dst = reinterpret_cast<cv::Vec3b*>(mat_color.data);
+    float frame_min = src[0];
+    float frame_max = src[0];
+    for (int32_t i = 0; i < num; i++) {
+        float depth = src[i];
+        if (filtered) {
+            depth = filtered[i] + a * (depth - filtered[i]);
+            filtered[i] = depth;
+        }
+        frame_min = (std::min)(frame_min, depth);
+        frame_max = (std::max)(frame_max, depth);
+        const float value = (std::min)(255.0f, (std::max)(0.0f, (depth - offset) * scale));
+        dst[i] = color_lut_[static_cast<uint8_t>(value)];
+    }
+
+    /* Update the range for the next frame */
+    depth_min_ += range_smoothing_ * (frame_min - depth_min_);
+    depth_max_ += range_smoothing_ * (frame_max - depth_max_);
+}
@@ -0,0 +1,60 @@
+/* Copyright 2022 iwatake2222
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef DEPTH_POST_PROCESSOR_
+#define DEPTH_POST_PROCESSOR_
+
+/* for general */
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <array>
+
+/* for OpenCV */
+#include <opencv2/opencv.hpp>
+
+/***
+* Convert relative depth (no specific range) to a colored depth map in one pass
+*   - the depth range used for normalization is tracked with EMA across frames instead of min/max of each frame,
+*     so that the output doesn't flicker. min/max of the current frame is reduced in the same loop for the next frame
+*   - optionally, depth of each pixel is smoothed across frames (temporal filter)
+***/
+class DepthPostProcessor {
+public:
+    DepthPostProcessor(float range_smoothing = 0.1f, float temporal_smoothing = 0.0f, int32_t colormap = cv::COLORMAP_JET);
+    ~DepthPostProcessor() {}
+    void Reset();
+
+    /* range_smoothing: weight of the current frame to update the depth range. 1.0 = follow min/max of the latest frame */
+    void SetRangeSmoothing(float range_smoothing);
+    /* temporal_smoothing: weight of the current frame for each pixel. 0.0 (or 1.0) = temporal filter is disabled */
+    void SetTemporalSmoothing(float temporal_smoothing);
+    float GetTemporalSmoothing() const;
+
+    /* mat_depth: CV_32FC1. mat_color: CV_8UC3 (same size as mat_depth) */
+    void Process(const cv::Mat& mat_depth, cv::Mat& mat_color);
+
+private:
+    float range_smoothing_;
+    float temporal_smoothing_;
+    std::array<cv::Vec3b, 256> color_lut_;
+
+    bool is_range_valid_;
+    float depth_min_;
+    float depth_max_;
+    cv::Mat mat_depth_filtered_;    /* CV_32FC1, depth of the previous frame for temporal filter */
+};
+
+#endif
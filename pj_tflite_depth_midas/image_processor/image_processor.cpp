@@ -32,7 +32,10 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "engine_config.h"
 #include "depth_engine.h"
+#include "depth_post_processor.h"
+#include "keyframe_scheduler.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -40,8 +43,15 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/*** Setting ***/
+#define DEPTH_RANGE_SMOOTHING    0.1f   /* weight of the current frame to update the depth range for normalization */
+#define DEPTH_TEMPORAL_SMOOTHING 0.5f   /* weight of the current frame for temporal filter (used when enabled by command) */
+#define KEYFRAME_INTERVAL        1      /* see KeyframeScheduler */
+
 /*** Global variable ***/
 std::unique_ptr<DepthEngine> s_engine;
+KeyframeScheduler s_keyframe_scheduler;
+std::unique_ptr<DepthPostProcessor> s_post_processor;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -68,6 +78,9 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         s_engine.reset();
         return -1;
     }
+    s_post_processor.reset(new DepthPostProcessor(DEPTH_RANGE_SMOOTHING, 0.0f));
+
+    s_keyframe_scheduler = KeyframeScheduler(EngineConfig::GetInstance().GetInt(TAG, "keyframe_interval", KEYFRAME_INTERVAL));
     return 0;
 }
 
@@ -81,6 +94,7 @@ int32_t ImageProcessor::Finalize(void)
     if (s_engine->Finalize() != DepthEngine::kRetOk) {
         return -1;
     }
+    s_post_processor.reset();
 
     return 0;
 }
@@ -95,6 +109,9 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
     switch (cmd) {
     case 0:
+        /* Toggle temporal filter */
+        s_post_processor->SetTemporalSmoothing(s_post_processor->GetTemporalSmoothing() > 0.0f ? 0.0f : DEPTH_TEMPORAL_SMOOTHING);
+        return 0;
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
         return -1;
@@ -110,14 +127,32 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     DepthEngine::Result ss_result;
-    if (s_engine->Process(mat, ss_result) != DepthEngine::kRetOk) {
+    std::vector<cv::Mat> result_list;
+    if (s_keyframe_scheduler.Process(mat, [&](std::vector<cv::Mat>& keyframe_result_list, cv::Rect& crop) {
+        if (s_engine->Process(mat, ss_result) != DepthEngine::kRetOk) return -1;
+        if (!ss_result.mat_out.empty()) {
+            keyframe_result_list = { ss_result.mat_out };
+            crop = cv::Rect(ss_result.crop.x, ss_result.crop.y, ss_result.crop.w, ss_result.crop.h);
+        }
+        return 0;
+    }, result_list) != 0) {
         return -1;
     }
+    if (result_list.empty()) {
+        /* The engine runs in pipeline mode and the pipeline is not filled yet */
+        cv::hconcat(mat, cv::Mat::zeros(mat.size(), CV_8UC3), mat);
+        return 0;
+    }
+    ss_result.mat_out = result_list[0];
+    ss_result.time_pre_process += s_keyframe_scheduler.GetTimeCheck();
+    ss_result.time_post_process += s_keyframe_scheduler.GetTimePropagate();
 
-    /* Convert to colored depth map */
+    /* Convert to colored depth map (normalization and color map are done in one pass) */
+    const auto& t_post_process0 = std::chrono::steady_clock::now();
     cv::Mat mat_depth;
-    cv::applyColorMap(ss_result.mat_out, mat_depth, cv::COLORMAP_JET);
-    
+    s_post_processor->Process(ss_result.mat_out, mat_depth);
+    const auto& t_post_process1 = std::chrono::steady_clock::now();
+
     /* Create result image */
     double scale = static_cast<double>(mat.rows) / mat_depth.rows;
     cv::resize(mat_depth, mat_depth, cv::Size(), scale, scale);
@@ -128,7 +163,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     /* Return the results */
     result.time_pre_process = ss_result.time_pre_process;
     result.time_inference = ss_result.time_inference;
-    result.time_post_process = ss_result.time_post_process;
+    result.time_post_process = ss_result.time_post_process + static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;
 
     return 0;
 }
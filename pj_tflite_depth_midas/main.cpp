@@ -26,6 +26,8 @@ limitations under the License.
 /* for My modules */
 #include "image_processor.h"
 #include "common_helper_cv.h"
+#include "engine_config.h"
+#include "startup_profiler.h"
 
 /*** Macro ***/
 #define WORK_DIR                      RESOURCE_DIR
@@ -44,16 +46,19 @@ int32_t main(int argc, char* argv[])
     double total_time_inference = 0;
     double total_time_post_process = 0;
 
+    /* Read runtime configuration (e.g. --keyframe_interval=3) */
+    std::vector<std::string> arg_list = EngineConfig::GetInstance().ParseCommandLine(argc, argv);
+
     /* Find source image */
-    std::string input_name = (argc > 1) ? argv[1] : DEFAULT_INPUT_IMAGE;
-    cv::VideoCapture cap;   /* if cap is not opened, src is still image */
-    if (!CommonHelper::FindSourceImage(input_name, cap)) {
+    std::string input_name = (arg_list.size() > 0) ? arg_list[0] : DEFAULT_INPUT_IMAGE;
+    CommonHelper::VideoSource cap;   /* decoded on a background thread. if cap is not video, src is still image */
+    if (!cap.Open(input_name)) {
         return -1;
     }
 
     /* Create video writer to save output video */
-    cv::VideoWriter writer;
-    // writer = cv::VideoWriter("out.mp4", cv::VideoWriter::fourcc('M', 'P', '4', 'V'), (std::max)(10.0, cap.get(cv::CAP_PROP_FPS)), cv::Size(static_cast<int32_t>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int32_t>(cap.get(cv::CAP_PROP_FRAME_HEIGHT))));
+    CommonHelper::VideoSink writer;   /* frames are encoded on a background thread */
+    // writer.Open("out.mp4", cap);
 
     /* Initialize image processor library */
     ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
@@ -61,19 +66,16 @@ int32_t main(int argc, char* argv[])
         printf("Initialization Error\n");
         return -1;
     }
+    StartupProfiler::PrintAll();
 
     /*** Process for each frame ***/
     int32_t frame_cnt = 0;
-    for (frame_cnt = 0; cap.isOpened() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
+    for (frame_cnt = 0; cap.IsVideo() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
         const auto& time_all0 = std::chrono::steady_clock::now();
         /* Read image */
         const auto& time_cap0 = std::chrono::steady_clock::now();
         cv::Mat image;
-        if (cap.isOpened()) {
-            cap.read(image);
-        } else {
-            image = cv::imread(input_name);
-        }
+        cap.Read(image);
         if (image.empty()) break;
         const auto& time_cap1 = std::chrono::steady_clock::now();
 
@@ -84,11 +86,11 @@ int32_t main(int argc, char* argv[])
         const auto& time_image_process1 = std::chrono::steady_clock::now();
 
         /* Display result */
-        if (writer.isOpened()) writer.write(image);
+        if (writer.IsOpened()) writer.Write(image);
         cv::imshow("test", image);
 
         /* Input key command */
-        if (cap.isOpened()) {
+        if (cap.IsVideo()) {
             /* this code needs to be before calculating processing time because cv::waitKey includes image output */
             /* however, when 'q' key is pressed (cap.released()), processing time significantly incraeases. So escape from the loop before calculating time */
             if (CommonHelper::InputKeyCommand(cap)) break;
@@ -132,7 +134,7 @@ int32_t main(int argc, char* argv[])
 
     /* Fianlize image processor library */
     ImageProcessor::Finalize();
-    if (writer.isOpened()) writer.release();
+    if (writer.IsOpened()) writer.Release();
     cv::waitKey(-1);
 
     return 0;
@@ -120,7 +120,7 @@ int32_t ImageProcessor::Command(int32_t cmd)
 }
 
 
-static void AnalyzeFlow(cv::Mat& mat, std::vector<Track>& track_list)
+static void AnalyzeFlow(cv::Mat& mat, TrackList& track_list)
 {
 
     constexpr int32_t kPastFrameToCalculateVelocity = 10;
@@ -34,6 +34,7 @@ limitations under the License.
 #include "common_helper_cv.h"
 #include "bounding_box.h"
 #include "detection_engine.h"
+#include "sliced_detector.h"
 #include "tracker.h"
 #include "image_processor.h"
 
@@ -42,8 +43,14 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/*** Setting ***/
+/* Sliced inference for small objects in a high resolution frame. 0: off (the whole frame is given to the model) */
+static constexpr int32_t kSliceTileSize = 0;
+static constexpr int32_t kSliceWorkerNum = 2;   /* detectors (interpreters) to run tiles concurrently */
+
 /*** Global variable ***/
 std::unique_ptr<DetectionEngine> s_engine;
+SlicedEngine<DetectionEngine> s_sliced_engine;     /* for sliced inference. worker 0 uses s_engine */
 Tracker s_tracker;
 
 /*** Function ***/
@@ -78,12 +85,23 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         return -1;
     }
 
+    /* Sliced inference: tiles run on kSliceWorkerNum detectors, and threads are divided among them */
+    const int32_t slice_worker_num = (kSliceTileSize > 0) ? kSliceWorkerNum : 1;
+    const int32_t num_threads = (std::max)(1, input_param.num_threads / slice_worker_num);
+
     s_engine.reset(new DetectionEngine());
-    if (s_engine->Initialize(input_param.work_dir, input_param.num_threads) != DetectionEngine::kRetOk) {
+    if (s_engine->Initialize(input_param.work_dir, num_threads) != DetectionEngine::kRetOk) {
         s_engine->Finalize();
         s_engine.reset();
         return -1;
     }
+    if (kSliceTileSize > 0) {
+        if (s_sliced_engine.Initialize(s_engine.get(), input_param.work_dir, num_threads, slice_worker_num, SlicedDetector(kSliceTileSize, kSliceTileSize)) != SlicedEngine<DetectionEngine>::kRetOk) {
+            s_engine->Finalize();
+            s_engine.reset();
+            return -1;
+        }
+    }
     return 0;
 }
 
@@ -94,6 +112,7 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
+    s_sliced_engine.Finalize();
     if (s_engine->Finalize() != DetectionEngine::kRetOk) {
         return -1;
     }
@@ -127,7 +146,8 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     DetectionEngine::Result det_result;
-    if (s_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
+    const int32_t ret = (kSliceTileSize > 0) ? s_sliced_engine.Process(mat, det_result) : s_engine->Process(mat, det_result);
+    if (ret != DetectionEngine::kRetOk) {
         return -1;
     }
 
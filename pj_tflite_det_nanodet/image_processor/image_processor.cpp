@@ -34,6 +34,7 @@ limitations under the License.
 #include "common_helper_cv.h"
 #include "bounding_box.h"
 #include "detection_engine.h"
+#include "sliced_detector.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -41,8 +42,18 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/*** Setting ***/
+/* Sliced inference for small objects in a high resolution frame. 0: off (the whole frame is given to the model) */
+static constexpr int32_t kSliceTileSize = 0;
+static constexpr int32_t kSliceWorkerNum = 2;   /* detectors (interpreters) to run tiles concurrently */
+/* Skip inference when nothing moves, and run it only on the moving region when a part moves (fixed camera) */
+static constexpr bool kUseMotionGate = false;
+
 /*** Global variable ***/
 std::unique_ptr<DetectionEngine> s_engine;
+SlicedEngine<DetectionEngine> s_sliced_engine;     /* for sliced inference. worker 0 uses s_engine */
+CommonHelper::MotionGate s_motion_gate;
+DetectionEngine::Result s_det_result_last;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -69,6 +80,16 @@ static cv::Scalar GetColorForId(int32_t id)
     return color_list[id % kMaxNum];
 }
 
+/* Run the detector only on the moving region. The last detections out of the region are kept */
+static int32_t ProcessRegion(const cv::Mat& mat, DetectionEngine::Result& det_result)
+{
+    if (s_engine->Process(mat(s_motion_gate.GetMotionRect()), det_result) != DetectionEngine::kRetOk) {
+        return DetectionEngine::kRetErr;
+    }
+    s_motion_gate.MapRegionResult(det_result, s_det_result_last.bbox_list);
+    return DetectionEngine::kRetOk;
+}
+
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
     if (s_engine) {
@@ -76,12 +97,25 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         return -1;
     }
 
+    /* Sliced inference: tiles run on kSliceWorkerNum detectors, and threads are divided among them */
+    const int32_t slice_worker_num = (kSliceTileSize > 0) ? kSliceWorkerNum : 1;
+    const int32_t num_threads = (std::max)(1, input_param.num_threads / slice_worker_num);
+
     s_engine.reset(new DetectionEngine());
-    if (s_engine->Initialize(input_param.work_dir, input_param.num_threads) != DetectionEngine::kRetOk) {
+    if (s_engine->Initialize(input_param.work_dir, num_threads) != DetectionEngine::kRetOk) {
         s_engine->Finalize();
         s_engine.reset();
         return -1;
     }
+    if (kSliceTileSize > 0) {
+        if (s_sliced_engine.Initialize(s_engine.get(), input_param.work_dir, num_threads, slice_worker_num, SlicedDetector(kSliceTileSize, kSliceTileSize)) != SlicedEngine<DetectionEngine>::kRetOk) {
+            s_engine->Finalize();
+            s_engine.reset();
+            return -1;
+        }
+    }
+    s_motion_gate = CommonHelper::MotionGate();
+    s_det_result_last = DetectionEngine::Result();
     return 0;
 }
 
@@ -92,6 +126,10 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
+    s_sliced_engine.Finalize();
+    if (kUseMotionGate) {
+        PRINT("Motion gate: inference was skipped in %.1f %% of frames\n", s_motion_gate.GetGatingRatio() * 100.0f);
+    }
     if (s_engine->Finalize() != DetectionEngine::kRetOk) {
         return -1;
     }
@@ -125,8 +163,24 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     DetectionEngine::Result det_result;
-    if (s_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
-        return -1;
+    const CommonHelper::MotionGate::Gate gate = kUseMotionGate ? s_motion_gate.Check(mat) : CommonHelper::MotionGate::kGateFull;
+    if (gate == CommonHelper::MotionGate::kGateSkip) {
+        /* Nothing moves. Reuse the last result */
+        det_result.bbox_list = s_det_result_last.bbox_list;
+        det_result.crop = s_det_result_last.crop;
+    } else {
+        int32_t ret = DetectionEngine::kRetOk;
+        if (kSliceTileSize > 0) {
+            ret = s_sliced_engine.Process(mat, det_result);
+        } else if (gate == CommonHelper::MotionGate::kGateRegion) {
+            ret = ProcessRegion(mat, det_result);
+        } else {
+            ret = s_engine->Process(mat, det_result);
+        }
+        if (ret != DetectionEngine::kRetOk) {
+            return -1;
+        }
+        s_det_result_last = det_result;
     }
 
     /* Display target area  */
@@ -149,6 +203,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     result.time_pre_process = det_result.time_pre_process;
     result.time_inference = det_result.time_inference;
     result.time_post_process = det_result.time_post_process;
+    result.is_result_reused = (gate == CommonHelper::MotionGate::kGateSkip);
 
     return 0;
 }
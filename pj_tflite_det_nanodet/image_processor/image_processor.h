@@ -40,6 +40,7 @@ typedef struct {
     double time_pre_process;   // [msec]
     double time_inference;    // [msec]
     double time_post_process;  // [msec]
+    bool   is_result_reused;   // true: nothing moved, and the last result is returned without inference (motion gate)
 } Result;
 
 int32_t Initialize(const InputParam& input_param);
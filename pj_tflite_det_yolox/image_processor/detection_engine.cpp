@@ -32,6 +32,8 @@ limitations under the License.
 #include "common_helper.h"
 #include "common_helper_cv.h"
 #include "inference_helper.h"
+#include "engine_config.h"
+#include "startup_profiler.h"
 #include "detection_engine.h"
 
 /*** Macro ***/
@@ -51,6 +53,8 @@ limitations under the License.
 #define IS_NCHW     false
 #define IS_RGB      true
 #define OUTPUT_NAME "Identity"
+#define DEFAULT_BACKEND    "tflite_xnnpack"
+#define BACKEND_CANDIDATES { "tflite", "tflite_xnnpack" }
 #elif defined(MODEL_TYPE_ONNX)
 #define MODEL_NAME  "yolox_nano_480x640.onnx"
 #define TENSORTYPE  TensorInfo::kTensorTypeFp32
@@ -59,6 +63,8 @@ limitations under the License.
 #define IS_NCHW     true
 #define IS_RGB      true
 #define OUTPUT_NAME "output"
+#define DEFAULT_BACKEND    "opencv"
+#define BACKEND_CANDIDATES { "opencv" }
 #endif
 
 static constexpr int32_t kGridScaleList[] = { 8, 16, 32 };
@@ -69,11 +75,130 @@ static constexpr int32_t kElementNumOfAnchor = kNumberOfClass + 5;    // x, y, w
 #define LABEL_NAME   "label_coco_80.txt"
 
 
+/* Benchmark parameters for auto tune */
+static constexpr int32_t kAutoTuneWarmupNum = 2;
+static constexpr int32_t kAutoTuneLoopNum = 5;
+
+/* Number of inferences in Initialize to make the first frame as fast as others (config: warmup_num) */
+static constexpr int32_t kWarmupNum = 1;
+
 /*** Function ***/
+static InferenceHelper* CreateInferenceHelper(const std::string& backend)
+{
+    if (backend == "tflite") return InferenceHelper::Create(InferenceHelper::kTensorflowLite);
+    if (backend == "tflite_xnnpack") return InferenceHelper::Create(InferenceHelper::kTensorflowLiteXnnpack);
+    if (backend == "tflite_gpu") return InferenceHelper::Create(InferenceHelper::kTensorflowLiteGpu);
+    if (backend == "tflite_edgetpu") return InferenceHelper::Create(InferenceHelper::kTensorflowLiteEdgetpu);
+    if (backend == "tflite_nnapi") return InferenceHelper::Create(InferenceHelper::kTensorflowLiteNnapi);
+    if (backend == "opencv") return InferenceHelper::Create(InferenceHelper::kOpencv);
+    PRINT_E("Unknown backend: %s\n", backend.c_str());
+    return nullptr;
+}
+
+static int32_t ConvertCropType(const std::string& crop_type)
+{
+    if (crop_type == "stretch") return CommonHelper::kCropTypeStretch;
+    if (crop_type == "cut") return CommonHelper::kCropTypeCut;
+    if (crop_type == "expand") return CommonHelper::kCropTypeExpand;
+    PRINT_E("Unknown crop type: %s\n", crop_type.c_str());
+    return CommonHelper::kCropTypeExpand;
+}
+
+static size_t GetElementSize(int32_t tensor_type)
+{
+    switch (tensor_type) {
+    case TensorInfo::kTensorTypeUint8:
+    case TensorInfo::kTensorTypeInt8:
+        return 1;
+    case TensorInfo::kTensorTypeInt64:
+        return 8;
+    default:
+        return 4;
+    }
+}
+
+/* Number of output elements that PostProcess reads for the input size */
+static int32_t GetOutputElementNum(const InputTensorInfo& input_tensor_info)
+{
+    int32_t element_num = 0;
+    for (const auto& grid_scale : kGridScaleList) {
+        element_num += (input_tensor_info.GetWidth() / grid_scale) * (input_tensor_info.GetHeight() / grid_scale) * kGridChannel * kElementNumOfAnchor;
+    }
+    return element_num;
+}
+
+static void SetInputImage(const cv::Mat& img_src, InputTensorInfo& input_tensor_info)
+{
+    input_tensor_info.data = img_src.data;
+    input_tensor_info.data_type = InputTensorInfo::kDataTypeImage;
+    input_tensor_info.image_info.width = img_src.cols;
+    input_tensor_info.image_info.height = img_src.rows;
+    input_tensor_info.image_info.channel = img_src.channels();
+    input_tensor_info.image_info.crop_x = 0;
+    input_tensor_info.image_info.crop_y = 0;
+    input_tensor_info.image_info.crop_width = img_src.cols;
+    input_tensor_info.image_info.crop_height = img_src.rows;
+    input_tensor_info.image_info.is_bgr = false;
+    input_tensor_info.image_info.swap_color = false;
+}
+
+/* Run inference on synthetic input and return the average inference time [msec]. Returns -1 if the backend is not available */
+double DetectionEngine::Benchmark(const std::string& model_filename, const std::string& backend, int32_t num_threads)
+{
+    std::unique_ptr<InferenceHelper> inference_helper(CreateInferenceHelper(backend));
+    if (!inference_helper) return -1;
+    std::vector<InputTensorInfo> input_tensor_info_list = input_tensor_info_list_;
+    std::vector<OutputTensorInfo> output_tensor_info_list = output_tensor_info_list_;
+    if (inference_helper->SetNumThreads(num_threads) != InferenceHelper::kRetOk
+        || inference_helper->Initialize(model_filename, input_tensor_info_list, output_tensor_info_list) != InferenceHelper::kRetOk) {
+        return -1;
+    }
+
+    cv::Mat img_src = cv::Mat(input_tensor_info_list[0].GetHeight(), input_tensor_info_list[0].GetWidth(), CV_8UC3, cv::Scalar(128, 128, 128));
+    SetInputImage(img_src, input_tensor_info_list[0]);
+    double time_total = 0;
+    for (int32_t i = 0; i < kAutoTuneWarmupNum + kAutoTuneLoopNum; i++) {
+        const auto& t0 = std::chrono::steady_clock::now();
+        if (inference_helper->PreProcess(input_tensor_info_list) != InferenceHelper::kRetOk
+            || inference_helper->Process(output_tensor_info_list) != InferenceHelper::kRetOk) {
+            inference_helper->Finalize();
+            return -1;
+        }
+        const auto& t1 = std::chrono::steady_clock::now();
+        if (i >= kAutoTuneWarmupNum) time_total += static_cast<std::chrono::duration<double>>(t1 - t0).count() * 1000.0;
+    }
+    inference_helper->Finalize();
+    return time_total / kAutoTuneLoopNum;
+}
+
+/* Run inference on a gray image so that lazy allocation and weight packing are done before the first frame */
+int32_t DetectionEngine::Warmup(int32_t warmup_num)
+{
+    cv::Mat img_src = cv::Mat(input_tensor_info_list_[0].GetHeight(), input_tensor_info_list_[0].GetWidth(), CV_8UC3, cv::Scalar(128, 128, 128));
+    for (int32_t i = 0; i < warmup_num; i++) {
+        Result result;
+        if (Process(img_src, result) != kRetOk) {
+            return kRetErr;
+        }
+    }
+    return kRetOk;
+}
+
 int32_t DetectionEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
 {
+    StartupProfiler profiler(TAG);
+
+    /* Read runtime configuration. Values not in the configuration keep the default (build time) setting */
+    const EngineConfig& config = EngineConfig::GetInstance();
+    threshold_box_confidence_ = config.GetFloat(TAG, "threshold_box_confidence", threshold_box_confidence_);
+    threshold_class_confidence_ = config.GetFloat(TAG, "threshold_class_confidence", threshold_class_confidence_);
+    threshold_nms_iou_ = config.GetFloat(TAG, "threshold_nms_iou", threshold_nms_iou_);
+    crop_type_ = ConvertCropType(config.GetString(TAG, "crop_type", "expand"));
+    std::string backend = config.GetString(TAG, "backend", DEFAULT_BACKEND);
+    int32_t num_threads_to_use = config.GetInt(TAG, "num_threads", num_threads);
+
     /* Set model information */
-    std::string model_filename = work_dir + "/model/" + MODEL_NAME;
+    std::string model_filename = work_dir + "/model/" + config.GetString(TAG, "model", MODEL_NAME);
     std::string labelFilename = work_dir + "/model/" + LABEL_NAME;
 
     /* Set input tensor info */
@@ -93,21 +218,41 @@ int32_t DetectionEngine::Initialize(const std::string& work_dir, const int32_t n
     output_tensor_info_list_.clear();
     output_tensor_info_list_.push_back(OutputTensorInfo(OUTPUT_NAME, TENSORTYPE));
 
-    /* Create and Initialize Inference Helper */
-#if defined(MODEL_TYPE_TFLITE)
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLite));
-    inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteXnnpack));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteGpu));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteEdgetpu));
-    //inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kTensorflowLiteNnapi));
-#elif defined(MODEL_TYPE_ONNX)
-    inference_helper_.reset(InferenceHelper::Create(InferenceHelper::kOpencv));
-#endif
+    /* Replay recorded output tensors. Model is not loaded */
+    std::string trace_replay = config.GetString(TAG, "trace_replay", "");
+    if (!trace_replay.empty()) {
+        trace_frame_index_ = 0;
+        if (trace_reader_.Open(trace_replay) != TensorTraceReader::kRetOk) {
+            return kRetErr;
+        }
+        return ReadLabel(labelFilename, label_list_);
+    }
+
+    /* Select the fastest combination of backend and number of threads (CPU only) */
+    if (config.GetBool(TAG, "auto_tune", false)) {
+        std::vector<std::string> candidate_list;
+        for (const auto& backend_candidate : std::vector<std::string>BACKEND_CANDIDATES) {
+            for (int32_t num_threads_candidate : EngineConfig::GetNumThreadsCandidateList()) {
+                candidate_list.push_back(backend_candidate + ":" + std::to_string(num_threads_candidate));
+            }
+        }
+        std::string best = EngineConfig::GetInstance().AutoTune(model_filename, candidate_list, [&](const std::string& candidate) {
+            size_t pos = candidate.find(':');
+            return Benchmark(model_filename, candidate.substr(0, pos), std::stoi(candidate.substr(pos + 1)));
+        });
+        size_t pos = best.find(':');
+        backend = best.substr(0, pos);
+        num_threads_to_use = std::stoi(best.substr(pos + 1));
+        profiler.Mark("auto_tune");
+    }
+    PRINT("Model: %s, Backend: %s, Threads: %d\n", model_filename.c_str(), backend.c_str(), num_threads_to_use);
 
+    /* Create and Initialize Inference Helper */
+    inference_helper_.reset(CreateInferenceHelper(backend));
     if (!inference_helper_) {
         return kRetErr;
     }
-    if (inference_helper_->SetNumThreads(num_threads) != InferenceHelper::kRetOk) {
+    if (inference_helper_->SetNumThreads(num_threads_to_use) != InferenceHelper::kRetOk) {
         inference_helper_.reset();
         return kRetErr;
     }
@@ -115,17 +260,39 @@ int32_t DetectionEngine::Initialize(const std::string& work_dir, const int32_t n
         inference_helper_.reset();
         return kRetErr;
     }
+    profiler.Mark("initialize");    /* model load, delegate init and weight packing */
 
     /* read label */
     if (ReadLabel(labelFilename, label_list_) != kRetOk) {
         return kRetErr;
     }
 
+    /* The first invocations are slow (XNNPACK packs weights, buffers are allocated). Do them here instead of at the first frame */
+    if (Warmup(config.GetInt(TAG, "warmup_num", kWarmupNum)) != kRetOk) {
+        return kRetErr;
+    }
+    profiler.Mark("warmup");
+
+    /* Record output tensors */
+    std::string trace_record = config.GetString(TAG, "trace_record", "");
+    if (!trace_record.empty()) {
+        trace_frame_index_ = 0;
+        if (trace_writer_.Open(trace_record) != TensorTraceWriter::kRetOk) {
+            return kRetErr;
+        }
+    }
+
+    profiler.Finish();
     return kRetOk;
 }
 
 int32_t DetectionEngine::Finalize()
 {
+    trace_writer_.Close();
+    if (trace_reader_.IsOpened()) {
+        trace_reader_.Close();
+        return kRetOk;
+    }
     if (!inference_helper_) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
@@ -172,6 +339,9 @@ void DetectionEngine::GetBoundingBox(const float* data, float scale_x, float  sc
 
 int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
 {
+    if (trace_reader_.IsOpened()) {
+        return ProcessReplay(result);
+    }
     if (!inference_helper_) {
         PRINT_E("Inference helper is not created\n");
         return kRetErr;
@@ -187,19 +357,39 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     cv::Mat img_src = cv::Mat::zeros(input_tensor_info.GetHeight(), input_tensor_info.GetWidth(), CV_8UC3);
     //CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeStretch);
     //CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeCut);
-    CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeExpand);
+    //CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeExpand);
+    CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, crop_type_);
+    return ProcessInputImage(img_src, original_mat.size(), crop_x, crop_y, crop_w, crop_h, t_pre_process0, result);
+}
 
-    input_tensor_info.data = img_src.data;
-    input_tensor_info.data_type = InputTensorInfo::kDataTypeImage;
-    input_tensor_info.image_info.width = img_src.cols;
-    input_tensor_info.image_info.height = img_src.rows;
-    input_tensor_info.image_info.channel = img_src.channels();
-    input_tensor_info.image_info.crop_x = 0;
-    input_tensor_info.image_info.crop_y = 0;
-    input_tensor_info.image_info.crop_width = img_src.cols;
-    input_tensor_info.image_info.crop_height = img_src.rows;
-    input_tensor_info.image_info.is_bgr = false;
-    input_tensor_info.image_info.swap_color = false;
+
+int32_t DetectionEngine::Process(const CommonHelper::Yuv420Image& yuv, Result& result)
+{
+    if (trace_reader_.IsOpened()) {
+        return ProcessReplay(result);
+    }
+    if (!inference_helper_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    /*** PreProcess ***/
+    const auto& t_pre_process0 = std::chrono::steady_clock::now();
+    const InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    const cv::Size original_size = CommonHelper::GetYuv420ImageSize(yuv);
+    int32_t crop_x = 0;
+    int32_t crop_y = 0;
+    int32_t crop_w = original_size.width;
+    int32_t crop_h = original_size.height;
+    cv::Mat img_src = cv::Mat::zeros(input_tensor_info.GetHeight(), input_tensor_info.GetWidth(), CV_8UC3);
+    CommonHelper::CropResizeCvtYuv420(yuv, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, crop_type_);
+    return ProcessInputImage(img_src, original_size, crop_x, crop_y, crop_w, crop_h, t_pre_process0, result);
+}
+
+
+int32_t DetectionEngine::ProcessInputImage(const cv::Mat& img_src, const cv::Size& original_size, int32_t crop_x, int32_t crop_y, int32_t crop_w, int32_t crop_h, const std::chrono::steady_clock::time_point& t_pre_process0, Result& result)
+{
+    InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
+    SetInputImage(img_src, input_tensor_info);
     if (inference_helper_->PreProcess(input_tensor_info_list_) != InferenceHelper::kRetOk) {
         return kRetErr;
     }
@@ -212,8 +402,25 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     }
     const auto& t_inference1 = std::chrono::steady_clock::now();
 
+    if (trace_writer_.IsOpened()) {
+        RecordTrace(original_size, crop_x, crop_y, crop_w, crop_h);
+    }
+
     /*** PostProcess ***/
+    if (PostProcess(original_size, crop_x, crop_y, crop_w, crop_h, result) != kRetOk) {
+        return kRetErr;
+    }
+    result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
+    result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
+
+    return kRetOk;
+}
+
+
+int32_t DetectionEngine::PostProcess(const cv::Size& original_size, int32_t crop_x, int32_t crop_y, int32_t crop_w, int32_t crop_h, Result& result)
+{
     const auto& t_post_process0 = std::chrono::steady_clock::now();
+    const InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
     /* Get boundig box */
     std::vector<BoundingBox> bbox_list;
     float* output_data = output_tensor_info_list_[0].GetDataAsFloat();
@@ -244,16 +451,82 @@ int32_t DetectionEngine::Process(const cv::Mat& original_mat, Result& result)
     result.bbox_list = bbox_nms_list;
     result.crop.x = (std::max)(0, crop_x);
     result.crop.y = (std::max)(0, crop_y);
-    result.crop.w = (std::min)(crop_w, original_mat.cols - result.crop.x);
-    result.crop.h = (std::min)(crop_h, original_mat.rows - result.crop.y);
-    result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
-    result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
+    result.crop.w = (std::min)(crop_w, original_size.width - result.crop.x);
+    result.crop.h = (std::min)(crop_h, original_size.height - result.crop.y);
     result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;;
 
     return kRetOk;
 }
 
 
+/* Feed the next recorded output tensors to post process. Returns kRetErr at the end of the trace */
+int32_t DetectionEngine::ProcessReplay(Result& result)
+{
+    TensorTrace::Frame frame;
+    if (trace_reader_.Read(trace_frame_index_, frame) != TensorTraceReader::kRetOk) {
+        return kRetErr;
+    }
+    trace_frame_index_++;
+    if (frame.tensor_list.size() != output_tensor_info_list_.size()) {
+        PRINT_E("Tensor num mismatch: %d\n", static_cast<int32_t>(frame.tensor_list.size()));
+        return kRetErr;
+    }
+    /* Reject a trace recorded with another model or input size, not to read past the end of the tensor data */
+    const int32_t element_num_expected = GetOutputElementNum(input_tensor_info_list_[0]);
+    for (size_t i = 0; i < frame.tensor_list.size(); i++) {
+        const TensorTrace::Tensor& tensor = frame.tensor_list[i];
+        int32_t element_num = 1;
+        for (const auto& dim : tensor.tensor_dims) element_num *= dim;
+        if (tensor.tensor_dims.empty() || tensor.tensor_dims.back() != kElementNumOfAnchor || element_num != element_num_expected
+            || tensor.data_size != static_cast<size_t>(element_num) * GetElementSize(tensor.tensor_type)) {
+            PRINT_E("Tensor size mismatch: %s\n", tensor.name.c_str());
+            return kRetErr;
+        }
+    }
+    for (size_t i = 0; i < frame.tensor_list.size(); i++) {
+        const TensorTrace::Tensor& tensor = frame.tensor_list[i];
+        OutputTensorInfo& output_tensor_info = output_tensor_info_list_[i];
+        output_tensor_info.tensor_type = tensor.tensor_type;
+        output_tensor_info.tensor_dims = tensor.tensor_dims;
+        output_tensor_info.quant.scale = tensor.scale;
+        output_tensor_info.quant.zero_point = tensor.zero_point;
+        output_tensor_info.data = const_cast<void*>(tensor.data);
+    }
+
+    if (PostProcess(cv::Size(frame.original_width, frame.original_height), frame.crop_x, frame.crop_y, frame.crop_w, frame.crop_h, result) != kRetOk) {
+        return kRetErr;
+    }
+    result.time_pre_process = 0;
+    result.time_inference = 0;
+    return kRetOk;
+}
+
+
+void DetectionEngine::RecordTrace(const cv::Size& original_size, int32_t crop_x, int32_t crop_y, int32_t crop_w, int32_t crop_h)
+{
+    TensorTrace::Frame frame;
+    frame.frame_id = trace_frame_index_++;
+    frame.original_width = original_size.width;
+    frame.original_height = original_size.height;
+    frame.crop_x = crop_x;
+    frame.crop_y = crop_y;
+    frame.crop_w = crop_w;
+    frame.crop_h = crop_h;
+    for (const auto& output_tensor_info : output_tensor_info_list_) {
+        TensorTrace::Tensor tensor;
+        tensor.name = output_tensor_info.name;
+        tensor.tensor_type = output_tensor_info.tensor_type;
+        tensor.tensor_dims = output_tensor_info.tensor_dims;
+        tensor.scale = output_tensor_info.quant.scale;
+        tensor.zero_point = output_tensor_info.quant.zero_point;
+        tensor.data = output_tensor_info.data;
+        tensor.data_size = output_tensor_info.GetElementNum() * GetElementSize(output_tensor_info.tensor_type);
+        frame.tensor_list.push_back(tensor);
+    }
+    trace_writer_.Write(frame);
+}
+
+
 int32_t DetectionEngine::ReadLabel(const std::string& filename, std::vector<std::string>& label_list)
 {
     std::ifstream ifs(filename);
@@ -22,6 +22,7 @@ limitations under the License.
 #include <vector>
 #include <array>
 #include <memory>
+#include <chrono>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -29,6 +30,8 @@ limitations under the License.
 /* for My modules */
 #include "inference_helper.h"
 #include "bounding_box.h"
+#include "common_helper_cv.h"
+#include "tensor_trace.h"
 
 
 class DetectionEngine {
@@ -59,15 +62,25 @@ public:
         threshold_box_confidence_ = threshold_box_confidence;
         threshold_class_confidence_ = threshold_class_confidence;
         threshold_nms_iou_ = threshold_nms_iou;
+        crop_type_ = 0;
+        trace_frame_index_ = 0;
     }
     ~DetectionEngine() {}
     int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
     int32_t Finalize(void);
     int32_t Process(const cv::Mat& original_mat, Result& result);
+    /* Camera buffer is converted directly into the input image of the model, without creating a full resolution image */
+    int32_t Process(const CommonHelper::Yuv420Image& yuv, Result& result);
 
 private:
+    int32_t ProcessInputImage(const cv::Mat& img_src, const cv::Size& original_size, int32_t crop_x, int32_t crop_y, int32_t crop_w, int32_t crop_h, const std::chrono::steady_clock::time_point& t_pre_process0, Result& result);
+    int32_t PostProcess(const cv::Size& original_size, int32_t crop_x, int32_t crop_y, int32_t crop_w, int32_t crop_h, Result& result);
+    int32_t ProcessReplay(Result& result);
+    void RecordTrace(const cv::Size& original_size, int32_t crop_x, int32_t crop_y, int32_t crop_w, int32_t crop_h);
     int32_t ReadLabel(const std::string& filename, std::vector<std::string>& label_list);
     void GetBoundingBox(const float* data, float scale_x, float  scale_y, int32_t grid_w, int32_t grid_h, std::vector<BoundingBox>& bbox_list);
+    double Benchmark(const std::string& model_filename, const std::string& backend, int32_t num_threads);
+    int32_t Warmup(int32_t warmup_num);
 
 private:
     std::unique_ptr<InferenceHelper> inference_helper_;
@@ -78,6 +91,12 @@ private:
     float threshold_box_confidence_;
     float threshold_class_confidence_;
     float threshold_nms_iou_;
+    int32_t crop_type_;
+
+    /* Tensor trace (config: trace_record / trace_replay). In replay mode, output tensors come from the file instead of inference */
+    TensorTraceWriter trace_writer_;
+    TensorTraceReader trace_reader_;
+    int32_t trace_frame_index_;
 };
 
 #endif
@@ -35,6 +35,10 @@ limitations under the License.
 #include "bounding_box.h"
 #include "detection_engine.h"
 #include "tracker.h"
+#include "detection_scheduler.h"
+#include "sliced_detector.h"
+#include "engine_config.h"
+#include "overlay_renderer.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -42,12 +46,31 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/*** Setting ***/
+/* Run detector every N frames (and when tracks are uncertain). Tracks are moved by Kalman filter + optical flow on the other frames. 1: every frame */
+static constexpr int32_t kDetectionInterval = 1;
+/* Sliced inference for small objects in a high resolution frame. 0: off (the whole frame is given to the model) */
+static constexpr int32_t kSliceTileSize = 0;
+static constexpr int32_t kSliceWorkerNum = 2;   /* detectors (interpreters) to run tiles concurrently */
+/* Skip inference when nothing moves, and run it only on the moving region when a part moves (fixed camera) */
+static constexpr bool kUseMotionGate = false;
+
 /*** Global variable ***/
 std::unique_ptr<DetectionEngine> s_engine;
+SlicedEngine<DetectionEngine> s_sliced_engine;     /* for sliced inference. worker 0 uses s_engine */
+bool s_use_slice = false;
+CommonHelper::MotionGate s_motion_gate;
+bool s_use_motion_gate = false;
 Tracker s_tracker;
+DetectionScheduler s_scheduler;
+cv::Rect s_crop_last;
+OverlayRenderer s_renderer;
+OverlayRenderer::DrawList s_draw_list;
+CommonHelper::VideoSink s_result_sink;
+int32_t s_result_frame_id = 0;
 
 /*** Function ***/
-static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
+static void DrawFps(OverlayRenderer::DrawList& draw_list, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
 {
     char text[64];
     static auto time_previous = std::chrono::steady_clock::now();
@@ -55,7 +78,7 @@ static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double f
     double fps = 1e9 / (time_now - time_previous).count();
     time_previous = time_now;
     snprintf(text, sizeof(text), "FPS: %.1f, Inference: %.1f [ms]", fps, time_inference);
-    CommonHelper::DrawText(mat, text, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
+    draw_list.AddText(text, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 }
 
 static cv::Scalar GetColorForId(int32_t id)
@@ -71,6 +94,123 @@ static cv::Scalar GetColorForId(int32_t id)
     return color_list[id % kMaxNum];
 }
 
+/* Run the detector only on the moving region. Tracks out of the region are added as detections to keep them */
+static int32_t ProcessRegion(const cv::Mat& mat, DetectionEngine::Result& det_result)
+{
+    if (s_engine->Process(mat(s_motion_gate.GetMotionRect()), det_result) != DetectionEngine::kRetOk) {
+        return DetectionEngine::kRetErr;
+    }
+    std::vector<BoundingBox> bbox_track_list;
+    for (auto& track : s_tracker.GetTrackList()) {
+        bbox_track_list.push_back(track.GetLatestBoundingBox());
+    }
+    s_motion_gate.MapRegionResult(det_result, bbox_track_list);
+    return DetectionEngine::kRetOk;
+}
+
+/* Record raw results instead of pixels (float32) */
+/*   "detection": [N, 6] = (class_id, score, x, y, w, h) */
+/*   "track":     [N, 7] = (id, class_id, score, x, y, w, h) */
+static void RecordResult(const cv::Mat& mat, const DetectionEngine::Result& det_result)
+{
+    std::vector<float> detection_data;
+    for (const auto& bbox : det_result.bbox_list) {
+        detection_data.insert(detection_data.end(), { static_cast<float>(bbox.class_id), bbox.score, static_cast<float>(bbox.x), static_cast<float>(bbox.y), static_cast<float>(bbox.w), static_cast<float>(bbox.h) });
+    }
+    std::vector<float> track_data;
+    for (auto& track : s_tracker.GetTrackList()) {
+        const auto& bbox = track.GetLatestData().bbox;
+        track_data.insert(track_data.end(), { static_cast<float>(track.GetId()), static_cast<float>(bbox.class_id), bbox.score, static_cast<float>(bbox.x), static_cast<float>(bbox.y), static_cast<float>(bbox.w), static_cast<float>(bbox.h) });
+    }
+
+    TensorTrace::Frame frame;
+    frame.frame_id = s_result_frame_id++;
+    frame.original_width = mat.cols;
+    frame.original_height = mat.rows;
+    frame.crop_x = det_result.crop.x;
+    frame.crop_y = det_result.crop.y;
+    frame.crop_w = det_result.crop.w;
+    frame.crop_h = det_result.crop.h;
+    frame.tensor_list.resize(2);
+    frame.tensor_list[0].name = "detection";
+    frame.tensor_list[0].tensor_type = TensorInfo::kTensorTypeFp32;
+    frame.tensor_list[0].tensor_dims = { static_cast<int32_t>(detection_data.size() / 6), 6 };
+    frame.tensor_list[0].data = detection_data.data();
+    frame.tensor_list[0].data_size = detection_data.size() * sizeof(float);
+    frame.tensor_list[1].name = "track";
+    frame.tensor_list[1].tensor_type = TensorInfo::kTensorTypeFp32;
+    frame.tensor_list[1].tensor_dims = { static_cast<int32_t>(track_data.size() / 7), 7 };
+    frame.tensor_list[1].data = track_data.data();
+    frame.tensor_list[1].data_size = track_data.size() * sizeof(float);
+    s_result_sink.WriteResult(frame);     /* copied and written on the sink thread */
+}
+
+static int32_t UpdateResult(cv::Mat& mat, const DetectionEngine::Result& det_result, ImageProcessor::Result& result)
+{
+    auto& track_list = s_tracker.GetTrackList();
+
+    /* Record what to draw. Drawing itself is done by the renderer (inline, in its own thread, or not at all) */
+    if (s_renderer.GetMode() != OverlayRenderer::kModeOff && !mat.empty()) {
+        OverlayRenderer::DrawList& draw_list = s_draw_list;
+        /* Display target area  */
+        draw_list.AddRect(cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
+
+        /* Display detection result (black rectangle) */
+        int32_t num_det = 0;
+        for (const auto& bbox : det_result.bbox_list) {
+            draw_list.AddRect(cv::Rect(bbox.x, bbox.y, bbox.w, bbox.h), CommonHelper::CreateCvColor(0, 0, 0), 1);
+            num_det++;
+        }
+
+        /* Display tracking result  */
+        int32_t num_track = 0;
+        for (auto& track : track_list) {
+            if (track.GetDetectedCount() < 2) continue;
+            const auto& bbox = track.GetLatestData().bbox;
+            /* Use white rectangle for the object which was not detected but just predicted */
+            cv::Scalar color = bbox.score == 0 ? CommonHelper::CreateCvColor(255, 255, 255) : GetColorForId(track.GetId());
+            draw_list.AddRect(cv::Rect(bbox.x, bbox.y, bbox.w, bbox.h), color, 2);
+            draw_list.AddText(std::to_string(track.GetId()) + ": " + bbox.label, cv::Point(bbox.x, bbox.y - 13), 0.35, 1, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
+
+            auto& track_history = track.GetDataHistory();
+            for (size_t i = 1; i < track_history.size(); i++) {
+                cv::Point p0(track_history[i].bbox.x + track_history[i].bbox.w / 2, track_history[i].bbox.y + track_history[i].bbox.h);
+                cv::Point p1(track_history[i - 1].bbox.x + track_history[i - 1].bbox.w / 2, track_history[i - 1].bbox.y + track_history[i - 1].bbox.h);
+                draw_list.AddLine(p0, p1, CommonHelper::CreateCvColor(255, 0, 0));
+            }
+            num_track++;
+        }
+        draw_list.AddText("DET: " + std::to_string(num_det) + ", TRACK: " + std::to_string(num_track), cv::Point(0, 20), 0.7, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
+        DrawFps(draw_list, det_result.time_inference, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
+        s_renderer.Submit(mat, draw_list);
+    }
+
+    /* Return the results */
+    int32_t bbox_num = 0;
+    for (auto& track : track_list) {
+        const auto& bbox = track.GetLatestData().bbox;
+        result.object_list[bbox_num].class_id = bbox.class_id;
+        snprintf(result.object_list[bbox_num].label, sizeof(result.object_list[bbox_num].label), "%s", bbox.label.c_str());
+        result.object_list[bbox_num].score = bbox.score;
+        result.object_list[bbox_num].x = bbox.x;
+        result.object_list[bbox_num].y = bbox.y;
+        result.object_list[bbox_num].width = bbox.w;
+        result.object_list[bbox_num].height = bbox.h;
+        bbox_num++;
+        if (bbox_num >= NUM_MAX_RESULT) break;
+    }
+    result.object_num = bbox_num;
+    result.is_detection_frame = s_scheduler.IsDetectionFrame();
+    result.is_result_reused = false;
+    if (s_result_sink.IsOpened()) RecordResult(mat, det_result);
+
+    result.time_pre_process = det_result.time_pre_process;
+    result.time_inference = det_result.time_inference;
+    result.time_post_process = det_result.time_post_process;
+
+    return 0;
+}
+
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
     if (s_engine) {
@@ -78,12 +218,46 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         return -1;
     }
 
+    /* Sliced inference: tiles run on slice_worker_num detectors, and threads are divided among them */
+    const EngineConfig& config = EngineConfig::GetInstance();
+    const int32_t slice_tile_size = config.GetInt(TAG, "slice_tile_size", kSliceTileSize);
+    int32_t slice_worker_num = (slice_tile_size > 0) ? (std::max)(1, config.GetInt(TAG, "slice_worker_num", kSliceWorkerNum)) : 1;
+    if (slice_worker_num > 1 && (!config.GetString("DetectionEngine", "trace_record", "").empty() || !config.GetString("DetectionEngine", "trace_replay", "").empty())) {
+        PRINT_E("Sliced inference runs on one detector with trace\n");
+        slice_worker_num = 1;
+    }
+    const int32_t num_threads = (std::max)(1, input_param.num_threads / slice_worker_num);
+
     s_engine.reset(new DetectionEngine());
-    if (s_engine->Initialize(input_param.work_dir, input_param.num_threads) != DetectionEngine::kRetOk) {
+    if (s_engine->Initialize(input_param.work_dir, num_threads) != DetectionEngine::kRetOk) {
         s_engine->Finalize();
         s_engine.reset();
         return -1;
     }
+    if (slice_tile_size > 0) {
+        const SlicedDetector sliced_detector(slice_tile_size, slice_tile_size, config.GetFloat(TAG, "slice_overlap", 0.2f), config.GetBool(TAG, "slice_full_frame", true), config.GetInt(TAG, "slice_idle_interval", 4));
+        if (s_sliced_engine.Initialize(s_engine.get(), input_param.work_dir, num_threads, slice_worker_num, sliced_detector) != SlicedEngine<DetectionEngine>::kRetOk) {
+            s_engine->Finalize();
+            s_engine.reset();
+            return -1;
+        }
+    }
+    s_use_slice = slice_tile_size > 0;
+
+    s_use_motion_gate = config.GetBool(TAG, "motion_gate", kUseMotionGate);
+    s_motion_gate = CommonHelper::MotionGate();
+
+    s_scheduler = DetectionScheduler(config.GetInt(TAG, "detection_interval", kDetectionInterval));
+
+    /* "inline" (default): draw on the input image, "thread": draw on a copy in the render thread (see GetRenderedImage), "off": headless */
+    s_renderer.Initialize(OverlayRenderer::ParseMode(config.GetString(TAG, "render_mode", "inline")));
+
+    /* Record detections and tracks as a compact binary side-stream (TensorTrace format). e.g. --result_record=result.bin */
+    std::string result_record = config.GetString(TAG, "result_record", "");
+    if (!result_record.empty()) {
+        s_result_sink.OpenResult(result_record);
+        s_result_frame_id = 0;
+    }
     return 0;
 }
 
@@ -94,9 +268,15 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
+    s_sliced_engine.Finalize();
     if (s_engine->Finalize() != DetectionEngine::kRetOk) {
         return -1;
     }
+    s_renderer.Finalize();
+    s_result_sink.Release();
+    if (s_use_motion_gate) {
+        PRINT("Motion gate: inference was skipped in %.1f %% of frames\n", s_motion_gate.GetGatingRatio() * 100.0f);
+    }
 
     return 0;
 }
@@ -127,63 +307,85 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     DetectionEngine::Result det_result;
-    if (s_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
-        return -1;
+    const CommonHelper::MotionGate::Gate gate = s_use_motion_gate ? s_motion_gate.Check(mat) : CommonHelper::MotionGate::kGateFull;
+    if (gate == CommonHelper::MotionGate::kGateSkip) {
+        /* Nothing moves. Tracks are kept as they are */
+        det_result.crop.x = s_crop_last.x;
+        det_result.crop.y = s_crop_last.y;
+        det_result.crop.w = s_crop_last.width;
+        det_result.crop.h = s_crop_last.height;
+    } else if (s_scheduler.CheckDetectionFrame(mat)) {
+        int32_t ret = DetectionEngine::kRetOk;
+        if (s_use_slice) {
+            ret = s_sliced_engine.Process(mat, det_result);
+        } else if (gate == CommonHelper::MotionGate::kGateRegion) {
+            ret = ProcessRegion(mat, det_result);
+        } else {
+            ret = s_engine->Process(mat, det_result);
+        }
+        if (ret != DetectionEngine::kRetOk) {
+            return -1;
+        }
+        s_tracker.Update(det_result.bbox_list);
+        s_crop_last = cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h);
+    } else {
+        /* No inference. Only tracks move */
+        s_scheduler.Interpolate(s_tracker);
+        det_result.crop.x = s_crop_last.x;
+        det_result.crop.y = s_crop_last.y;
+        det_result.crop.w = s_crop_last.width;
+        det_result.crop.h = s_crop_last.height;
     }
-
-    /* Display target area  */
-    cv::rectangle(mat, cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
-
-    /* Display detection result (black rectangle) */
-    int32_t num_det = 0;
-    for (const auto& bbox : det_result.bbox_list) {
-        cv::rectangle(mat, cv::Rect(bbox.x, bbox.y, bbox.w, bbox.h), CommonHelper::CreateCvColor(0, 0, 0), 1);
-        num_det++;
+    if (gate != CommonHelper::MotionGate::kGateSkip) {
+        s_scheduler.UpdateTrackStatus(s_tracker);
     }
 
-    /* Display tracking result  */
-    s_tracker.Update(det_result.bbox_list);
-    int32_t num_track = 0;
-    auto& track_list = s_tracker.GetTrackList();
-    for (auto& track : track_list) {
-        if (track.GetDetectedCount() < 2) continue;
-        const auto& bbox = track.GetLatestData().bbox;
-        /* Use white rectangle for the object which was not detected but just predicted */
-        cv::Scalar color = bbox.score == 0 ? CommonHelper::CreateCvColor(255, 255, 255) : GetColorForId(track.GetId());
-        cv::rectangle(mat, cv::Rect(bbox.x, bbox.y, bbox.w, bbox.h), color, 2);
-        CommonHelper::DrawText(mat, std::to_string(track.GetId()) + ": " + bbox.label, cv::Point(bbox.x, bbox.y - 13), 0.35, 1, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
-
-        auto& track_history = track.GetDataHistory();
-        for (size_t i = 1; i < track_history.size(); i++) {
-            cv::Point p0(track_history[i].bbox.x + track_history[i].bbox.w / 2, track_history[i].bbox.y + track_history[i].bbox.h);
-            cv::Point p1(track_history[i - 1].bbox.x + track_history[i - 1].bbox.w / 2, track_history[i - 1].bbox.y + track_history[i - 1].bbox.h);
-            cv::line(mat, p0, p1, CommonHelper::CreateCvColor(255, 0, 0));
-        }
-        num_track++;
+    int32_t ret = UpdateResult(mat, det_result, result);
+    if (gate == CommonHelper::MotionGate::kGateSkip) {
+        result.is_detection_frame = false;
+        result.is_result_reused = true;
     }
-    CommonHelper::DrawText(mat, "DET: " + std::to_string(num_det) + ", TRACK: " + std::to_string(num_track), cv::Point(0, 20), 0.7, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(220, 220, 220));
-    DrawFps(mat, det_result.time_inference, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
+    return ret;
+}
 
-    /* Return the results */
-    int32_t bbox_num = 0;
-    for (auto& track : track_list) {
-        const auto& bbox = track.GetLatestData().bbox;
-        result.object_list[bbox_num].class_id = bbox.class_id;
-        snprintf(result.object_list[bbox_num].label, sizeof(result.object_list[bbox_num].label), "%s", bbox.label.c_str());
-        result.object_list[bbox_num].score = bbox.score;
-        result.object_list[bbox_num].x = bbox.x;
-        result.object_list[bbox_num].y = bbox.y;
-        result.object_list[bbox_num].width = bbox.w;
-        result.object_list[bbox_num].height = bbox.h;
-        bbox_num++;
-        if (bbox_num >= NUM_MAX_RESULT) break;
+int32_t ImageProcessor::ProcessYuv420(const uint8_t* y, const uint8_t* u, const uint8_t* v, int32_t width, int32_t height, int32_t y_row_stride, int32_t uv_row_stride, int32_t uv_pixel_stride, int32_t rotation, cv::Mat* mat_render, Result& result)
+{
+    if (!s_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
     }
-    result.object_num = bbox_num;
 
-    result.time_pre_process = det_result.time_pre_process;
-    result.time_inference = det_result.time_inference;
-    result.time_post_process = det_result.time_post_process;
+    CommonHelper::Yuv420Image yuv;
+    yuv.y = y;
+    yuv.u = u;
+    yuv.v = v;
+    yuv.width = width;
+    yuv.height = height;
+    yuv.y_row_stride = y_row_stride;
+    yuv.uv_row_stride = uv_row_stride;
+    yuv.uv_pixel_stride = uv_pixel_stride;
+    yuv.rotation = rotation;
 
-    return 0;
+    /* Detection runs every frame because there is no full resolution image for optical flow */
+    DetectionEngine::Result det_result;
+    if (s_engine->Process(yuv, det_result) != DetectionEngine::kRetOk) {
+        return -1;
+    }
+    s_tracker.Update(det_result.bbox_list);
+
+    /* Full resolution image is created only for rendering */
+    cv::Mat mat_dummy;
+    if (mat_render && s_renderer.GetMode() != OverlayRenderer::kModeOff) {
+        CommonHelper::ConvertYuv420(yuv, *mat_render);
+        return UpdateResult(*mat_render, det_result, result);
+    }
+    return UpdateResult(mat_dummy, det_result, result);
 }
 
+int32_t ImageProcessor::GetRenderedImage(cv::Mat& mat)
+{
+    if (s_renderer.GetMode() != OverlayRenderer::kModeThread) {
+        return -1;
+    }
+    return s_renderer.GetRendered(mat) ? 0 : -1;
+}
@@ -47,6 +47,8 @@ typedef struct {
         int32_t  width;
         int32_t  height;
     } object_list[NUM_MAX_RESULT];
+    bool   is_detection_frame;  // false: detector was not run and objects were moved by tracker
+    bool   is_result_reused;    // true: nothing moved, and the last result is returned without inference (motion gate)
     double time_pre_process;   // [msec]
     double time_inference;    // [msec]
     double time_post_process;  // [msec]
@@ -54,8 +56,14 @@ typedef struct {
 
 int32_t Initialize(const InputParam& input_param);
 int32_t Process(cv::Mat& mat, Result& result);
+/* Process the camera buffer (YUV 4:2:0, e.g. Android YUV_420_888) without creating a full resolution image for inference */
+#define IMAGE_PROCESSOR_HAS_PROCESS_YUV420
+/*   uv_pixel_stride: 1 = planar, 2 = semi planar. rotation: clockwise [deg]. mat_render: the rotated image with the result is drawn if not null and rendering is on */
+int32_t ProcessYuv420(const uint8_t* y, const uint8_t* u, const uint8_t* v, int32_t width, int32_t height, int32_t y_row_stride, int32_t uv_row_stride, int32_t uv_pixel_stride, int32_t rotation, cv::Mat* mat_render, Result& result);
 int32_t Finalize(void);
 int32_t Command(int32_t cmd);
+/* Only when render_mode is "thread". The latest rendered image (a frame or more behind). Returns -1 if not available */
+int32_t GetRenderedImage(cv::Mat& mat);
 
 }
 
@@ -17,6 +17,7 @@ limitations under the License.
 #include <cstdint>
 #include <cstdlib>
 #include <string>
+#include <vector>
 #include <algorithm>
 #include <chrono>
 
@@ -26,6 +27,8 @@ limitations under the License.
 /* for My modules */
 #include "image_processor.h"
 #include "common_helper_cv.h"
+#include "engine_config.h"
+#include "startup_profiler.h"
 
 /*** Macro ***/
 #define WORK_DIR                      RESOURCE_DIR
@@ -33,6 +36,37 @@ limitations under the License.
 #define LOOP_NUM_FOR_TIME_MEASUREMENT 10
 
 /*** Function ***/
+/* Replay recorded output tensors (--trace_replay=trace.bin) without camera and GUI, to measure post process and tracking only */
+/* The trace is recorded with --trace_record=trace.bin */
+static int32_t ReplayTrace(const ImageProcessor::InputParam& input_param)
+{
+    if (ImageProcessor::Initialize(input_param) != 0) {
+        printf("Initialization Error\n");
+        return -1;
+    }
+
+    double total_time_post_process = 0;
+    int32_t frame_cnt = 0;
+    cv::Mat image;  /* empty: nothing is drawn */
+    const auto& time0 = std::chrono::steady_clock::now();
+    for (frame_cnt = 0; ; frame_cnt++) {
+        ImageProcessor::Result result;
+        if (ImageProcessor::Process(image, result) != 0) break;    /* end of the trace */
+        total_time_post_process += result.time_post_process;
+    }
+    const auto& time1 = std::chrono::steady_clock::now();
+    double time_all = (time1 - time0).count() / 1000000.0;
+
+    printf("=== Replayed %d frames ===\n", frame_cnt);
+    if (frame_cnt > 0) {
+        printf("Total:               %9.3lf [msec] (%.1lf [FPS])\n", time_all / frame_cnt, frame_cnt * 1000.0 / time_all);
+        printf("    Post processing: %9.3lf [msec]\n", total_time_post_process / frame_cnt);
+    }
+
+    ImageProcessor::Finalize();
+    return 0;
+}
+
 int32_t main(int argc, char* argv[])
 {
     /*** Initialize ***/
@@ -44,36 +78,45 @@ int32_t main(int argc, char* argv[])
     double total_time_inference = 0;
     double total_time_post_process = 0;
 
+    /* Read runtime configuration (e.g. --config=config.json --num_threads=2 --auto_tune) */
+    EngineConfig& config = EngineConfig::GetInstance();
+    std::vector<std::string> arg_list = config.ParseCommandLine(argc, argv);
+
+    if (!config.GetString("trace_replay", "").empty()) {
+        ImageProcessor::InputParam input_param = { WORK_DIR, config.GetInt("num_threads", 4) };
+        return ReplayTrace(input_param);
+    }
+
     /* Find source image */
-    std::string input_name = (argc > 1) ? argv[1] : DEFAULT_INPUT_IMAGE;
-    cv::VideoCapture cap;   /* if cap is not opened, src is still image */
-    if (!CommonHelper::FindSourceImage(input_name, cap)) {
+    std::string input_name = (arg_list.size() > 0) ? arg_list[0] : DEFAULT_INPUT_IMAGE;
+    CommonHelper::VideoSource cap;   /* decoded on a background thread. if cap is not video, src is still image */
+    if (!cap.Open(input_name)) {
         return -1;
     }
 
     /* Create video writer to save output video */
-    cv::VideoWriter writer;
-    // writer = cv::VideoWriter("out.mp4", cv::VideoWriter::fourcc('M', 'P', '4', 'V'), (std::max)(10.0, cap.get(cv::CAP_PROP_FPS)), cv::Size(static_cast<int32_t>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int32_t>(cap.get(cv::CAP_PROP_FRAME_HEIGHT))));
+    CommonHelper::VideoSink writer;   /* frames are encoded on a background thread */
+    std::string video_record = config.GetString("video_record", "");
+    if (!video_record.empty()) {
+        writer.Open(video_record, cap);
+    }
 
     /* Initialize image processor library */
-    ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
+    ImageProcessor::InputParam input_param = { WORK_DIR, config.GetInt("num_threads", 4) };
     if (ImageProcessor::Initialize(input_param) != 0) {
         printf("Initialization Error\n");
         return -1;
     }
+    StartupProfiler::PrintAll();
 
     /*** Process for each frame ***/
     int32_t frame_cnt = 0;
-    for (frame_cnt = 0; cap.isOpened() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
+    for (frame_cnt = 0; cap.IsVideo() || frame_cnt < LOOP_NUM_FOR_TIME_MEASUREMENT; frame_cnt++) {
         const auto& time_all0 = std::chrono::steady_clock::now();
         /* Read image */
         const auto& time_cap0 = std::chrono::steady_clock::now();
         cv::Mat image;
-        if (cap.isOpened()) {
-            cap.read(image);
-        } else {
-            image = cv::imread(input_name);
-        }
+        cap.Read(image);
         if (image.empty()) break;
         const auto& time_cap1 = std::chrono::steady_clock::now();
 
@@ -84,11 +127,14 @@ int32_t main(int argc, char* argv[])
         const auto& time_image_process1 = std::chrono::steady_clock::now();
 
         /* Display result */
-        if (writer.isOpened()) writer.write(image);
-        cv::imshow("test", image);
+        /* image is drawn in Process, except when the render thread is used (--render_mode=thread) */
+        cv::Mat image_display;
+        if (ImageProcessor::GetRenderedImage(image_display) != 0) image_display = image;
+        if (writer.IsOpened()) writer.Write(image_display);
+        cv::imshow("test", image_display);
 
         /* Input key command */
-        if (cap.isOpened()) {
+        if (cap.IsVideo()) {
             /* this code needs to be before calculating processing time because cv::waitKey includes image output */
             /* however, when 'q' key is pressed (cap.released()), processing time significantly incraeases. So escape from the loop before calculating time */
             if (CommonHelper::InputKeyCommand(cap)) break;
@@ -132,7 +178,7 @@ int32_t main(int argc, char* argv[])
 
     /* Fianlize image processor library */
     ImageProcessor::Finalize();
-    if (writer.isOpened()) writer.release();
+    if (writer.IsOpened()) writer.Release();
     cv::waitKey(-1);
 
     return 0;
@@ -60,6 +60,7 @@ public:
     {}
     ~AgeGenderEngine() {}
     int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
+    static std::string GetModelFilename(const std::string& work_dir);
     int32_t Finalize(void);
     int32_t Process(const cv::Mat& original_mat, const BoundingBox& bbox, Result& result);
     static const std::vector<std::pair<int32_t, int32_t>>& GetConnectionList();
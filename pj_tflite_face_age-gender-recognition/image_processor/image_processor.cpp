@@ -32,6 +32,7 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "lazy_engine.h"
 #include "bounding_box.h"
 #include "face_detection_engine.h"
 #include "age_gender_engine.h"
@@ -44,7 +45,7 @@ limitations under the License.
 
 /*** Global variable ***/
 std::unique_ptr<FaceDetectionEngine> s_facedet_engine;
-std::unique_ptr<AgeGenderEngine> s_facemesh_engine;
+LazyEngine<AgeGenderEngine> s_facemesh_engine;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference_det, double time_inference_feature, int32_t num_feature, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -61,7 +62,7 @@ static void DrawFps(cv::Mat& mat, double time_inference_det, double time_inferen
 
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
-    if (s_facedet_engine || s_facemesh_engine) {
+    if (s_facedet_engine || s_facemesh_engine.IsSetup()) {
         PRINT_E("Already initialized\n");
         return -1;
     }
@@ -73,10 +74,9 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         return -1;
     }
 
-    s_facemesh_engine.reset(new AgeGenderEngine());
-    if (s_facemesh_engine->Initialize(input_param.work_dir, input_param.num_threads) != AgeGenderEngine::kRetOk) {
-        s_facemesh_engine->Finalize();
-        s_facemesh_engine.reset();
+    if (s_facemesh_engine.Setup(input_param.work_dir, input_param.num_threads) != LazyEngine<AgeGenderEngine>::kRetOk) {
+        s_facedet_engine->Finalize();
+        s_facedet_engine.reset();
         return -1;
     }
 
@@ -85,7 +85,7 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
 
 int32_t ImageProcessor::Finalize(void)
 {
-    if (!s_facedet_engine || !s_facemesh_engine) {
+    if (!s_facedet_engine || !s_facemesh_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -94,9 +94,9 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
-    if (s_facemesh_engine->Finalize() != AgeGenderEngine::kRetOk) {
-        return -1;
-    }
+    s_facemesh_engine.Release();
+
+    CommonHelper::FrameImageCache::GetInstance().Clear();
 
     return 0;
 }
@@ -104,7 +104,7 @@ int32_t ImageProcessor::Finalize(void)
 
 int32_t ImageProcessor::Command(int32_t cmd)
 {
-    if (!s_facedet_engine || !s_facemesh_engine) {
+    if (!s_facedet_engine || !s_facemesh_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -120,11 +120,14 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
 int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
 {
-    if (!s_facedet_engine || !s_facemesh_engine) {
+    if (!s_facedet_engine || !s_facemesh_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
 
+    /* Share the pyramid and color conversion of this frame among the engines */
+    CommonHelper::FrameImageCache::GetInstance().SetFrame(mat);
+
     /* Detect face */
     FaceDetectionEngine::Result det_result;
     if (s_facedet_engine->Process(mat, det_result) != FaceDetectionEngine::kRetOk) {
@@ -149,9 +152,14 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     double time_pre_process_feature = 0;   // [msec]
     double time_inference_feature = 0;    // [msec]
     double time_post_process_feature = 0;  // [msec]
+    AgeGenderEngine* agegender_engine = det_result.bbox_list.empty() ? nullptr : s_facemesh_engine.Get();     /* nullptr while loading */
+    if (s_facemesh_engine.IsError()) {
+        return -1;
+    }
     for (const auto& bbox : det_result.bbox_list) {
+        if (!agegender_engine) break;
         AgeGenderEngine::Result agegender_result;
-        if (s_facemesh_engine->Process(mat, bbox, agegender_result) != AgeGenderEngine::kRetOk) {
+        if (agegender_engine->Process(mat, bbox, agegender_result) != AgeGenderEngine::kRetOk) {
             return -1;
         }
         
@@ -169,6 +177,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         time_inference_feature += agegender_result.time_inference;
         time_post_process_feature += agegender_result.time_post_process;
     }
+    s_facemesh_engine.CheckIdle();
 
 
     /* Return the results */
@@ -51,6 +51,7 @@ public:
     FacemeshEngine() {}
     ~FacemeshEngine() {}
     int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
+    static std::string GetModelFilename(const std::string& work_dir);
     int32_t Finalize(void);
     int32_t Process(const cv::Mat& original_mat, const std::vector<BoundingBox>& bbox_list, std::vector<Result>& result_list);
     static const std::vector<std::pair<int32_t, int32_t>>& GetConnectionList();
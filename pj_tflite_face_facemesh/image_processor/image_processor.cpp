@@ -32,6 +32,8 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "lazy_engine.h"
+#include "compute_resource_manager.h"
 #include "bounding_box.h"
 #include "face_detection_engine.h"
 #include "facemesh_engine.h"
@@ -217,7 +219,7 @@ static constexpr int32_t kMeshIndices[] =
 
 /*** Global variable ***/
 std::unique_ptr<FaceDetectionEngine> s_facedet_engine;
-std::unique_ptr<FacemeshEngine> s_facemesh_engine;
+LazyEngine<FacemeshEngine> s_facemesh_engine;
 
 
 /*** Function ***/
@@ -234,22 +236,24 @@ static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double f
 
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
-    if (s_facedet_engine || s_facemesh_engine) {
+    if (s_facedet_engine || s_facemesh_engine.IsSetup()) {
         PRINT_E("Already initialized\n");
         return -1;
     }
 
+    auto& resource_manager = ComputeResourceManager::GetInstance();
+    resource_manager.ConfigureMainThread(input_param.num_threads);
+
     s_facedet_engine.reset(new FaceDetectionEngine());
-    if (s_facedet_engine->Initialize(input_param.work_dir, input_param.num_threads) != FaceDetectionEngine::kRetOk) {
+    if (s_facedet_engine->Initialize(input_param.work_dir, resource_manager.Reserve("FaceDetectionEngine", input_param.num_threads).num_threads) != FaceDetectionEngine::kRetOk) {
         s_facedet_engine->Finalize();
         s_facedet_engine.reset();
         return -1;
     }
 
-    s_facemesh_engine.reset(new FacemeshEngine());
-    if (s_facemesh_engine->Initialize(input_param.work_dir, input_param.num_threads) != FacemeshEngine::kRetOk) {
-        s_facemesh_engine->Finalize();
-        s_facemesh_engine.reset();
+    if (s_facemesh_engine.Setup(input_param.work_dir, resource_manager.Reserve("FacemeshEngine", input_param.num_threads)) != LazyEngine<FacemeshEngine>::kRetOk) {
+        s_facedet_engine->Finalize();
+        s_facedet_engine.reset();
         return -1;
     }
 
@@ -258,7 +262,7 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
 
 int32_t ImageProcessor::Finalize(void)
 {
-    if (!s_facedet_engine || !s_facemesh_engine) {
+    if (!s_facedet_engine || !s_facemesh_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -267,9 +271,10 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
-    if (s_facemesh_engine->Finalize() != FacemeshEngine::kRetOk) {
-        return -1;
-    }
+    s_facemesh_engine.Release();
+
+    CommonHelper::FrameImageCache::GetInstance().Clear();
+    ComputeResourceManager::GetInstance().Reset();
 
     return 0;
 }
@@ -277,7 +282,7 @@ int32_t ImageProcessor::Finalize(void)
 
 int32_t ImageProcessor::Command(int32_t cmd)
 {
-    if (!s_facedet_engine || !s_facemesh_engine) {
+    if (!s_facedet_engine || !s_facemesh_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -293,11 +298,14 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
 int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
 {
-    if (!s_facedet_engine || !s_facemesh_engine) {
+    if (!s_facedet_engine || !s_facemesh_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
 
+    /* Share the pyramid and color conversion of this frame among the engines */
+    CommonHelper::FrameImageCache::GetInstance().SetFrame(mat);
+
     /* Detect face */
     FaceDetectionEngine::Result det_result;
     if (s_facedet_engine->Process(mat, det_result) != FaceDetectionEngine::kRetOk) {
@@ -320,9 +328,14 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
 
     /* Detect facemesh */
     std::vector<FacemeshEngine::Result> facemesh_result_list;
-    if (s_facemesh_engine->Process(mat, det_result.bbox_list, facemesh_result_list) != FacemeshEngine::kRetOk) {
+    FacemeshEngine* facemesh_engine = det_result.bbox_list.empty() ? nullptr : s_facemesh_engine.Get();     /* nullptr while loading */
+    if (s_facemesh_engine.IsError()) {
+        return -1;
+    }
+    if (facemesh_engine && facemesh_engine->Process(mat, det_result.bbox_list, facemesh_result_list) != FacemeshEngine::kRetOk) {
         return -1;
     }
+    s_facemesh_engine.CheckIdle();
 
     /* Display result for detected faces */
     const auto& connection_list = FacemeshEngine::GetConnectionList();
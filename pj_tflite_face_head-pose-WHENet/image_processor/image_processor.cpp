@@ -32,6 +32,7 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "lazy_engine.h"
 #include "bounding_box.h"
 #include "face_detection_engine.h"
 #include "headpose_engine.h"
@@ -44,7 +45,7 @@ limitations under the License.
 
 /*** Global variable ***/
 std::unique_ptr<FaceDetectionEngine> s_facedet_engine;
-std::unique_ptr<HeadposeEngine> s_headpose_engine;
+LazyEngine<HeadposeEngine> s_headpose_engine;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -60,7 +61,7 @@ static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double f
 
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
-    if (s_facedet_engine || s_headpose_engine) {
+    if (s_facedet_engine || s_headpose_engine.IsSetup()) {
         PRINT_E("Already initialized\n");
         return -1;
     }
@@ -72,10 +73,9 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         return -1;
     }
 
-    s_headpose_engine.reset(new HeadposeEngine());
-    if (s_headpose_engine->Initialize(input_param.work_dir, input_param.num_threads) != HeadposeEngine::kRetOk) {
-        s_headpose_engine->Finalize();
-        s_headpose_engine.reset();
+    if (s_headpose_engine.Setup(input_param.work_dir, input_param.num_threads) != LazyEngine<HeadposeEngine>::kRetOk) {
+        s_facedet_engine->Finalize();
+        s_facedet_engine.reset();
         return -1;
     }
 
@@ -84,7 +84,7 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
 
 int32_t ImageProcessor::Finalize(void)
 {
-    if (!s_facedet_engine || !s_headpose_engine) {
+    if (!s_facedet_engine || !s_headpose_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -93,9 +93,9 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
-    if (s_headpose_engine->Finalize() != HeadposeEngine::kRetOk) {
-        return -1;
-    }
+    s_headpose_engine.Release();
+
+    CommonHelper::FrameImageCache::GetInstance().Clear();
 
     return 0;
 }
@@ -103,7 +103,7 @@ int32_t ImageProcessor::Finalize(void)
 
 int32_t ImageProcessor::Command(int32_t cmd)
 {
-    if (!s_facedet_engine || !s_headpose_engine) {
+    if (!s_facedet_engine || !s_headpose_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -146,11 +146,14 @@ static float CalcFocalLength(int32_t pixel_size, float fov)
 
 int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
 {
-    if (!s_facedet_engine || !s_headpose_engine) {
+    if (!s_facedet_engine || !s_headpose_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
 
+    /* Share the pyramid and color conversion of this frame among the engines */
+    CommonHelper::FrameImageCache::GetInstance().SetFrame(mat);
+
     /* Detect face */
     FaceDetectionEngine::Result det_result;
     if (s_facedet_engine->Process(mat, det_result) != FaceDetectionEngine::kRetOk) {
@@ -176,9 +179,14 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
 
     /* Estimate head pose */
     std::vector<HeadposeEngine::Result> headpose_result_list;
-    if (s_headpose_engine->Process(mat, bbox_list, headpose_result_list) != HeadposeEngine::kRetOk) {
+    HeadposeEngine* headpose_engine = bbox_list.empty() ? nullptr : s_headpose_engine.Get();     /* nullptr while loading */
+    if (s_headpose_engine.IsError()) {
+        return -1;
+    }
+    if (headpose_engine && headpose_engine->Process(mat, bbox_list, headpose_result_list) != HeadposeEngine::kRetOk) {
         return -1;
     }
+    s_headpose_engine.CheckIdle();
 
     /* Display head poses */
     for (int32_t i = 0; i < (std::min)(bbox_list.size(), headpose_result_list.size()); i++) {
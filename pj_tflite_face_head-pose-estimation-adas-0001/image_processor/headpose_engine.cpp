@@ -51,10 +51,15 @@ limitations under the License.
 #define OUTPUT_NAME_2 "Identity_2"
 
 /*** Function ***/
+std::string HeadposeEngine::GetModelFilename(const std::string& work_dir)
+{
+    return work_dir + "/model/" + MODEL_NAME;
+}
+
 int32_t HeadposeEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
 {
     /* Set model information */
-    std::string model_filename = work_dir + "/model/" + MODEL_NAME;
+    std::string model_filename = GetModelFilename(work_dir);
 
     /* Set input tensor info */
     input_tensor_info_list_.clear();
@@ -73,10 +73,15 @@ limitations under the License.
 #endif
 
 /*** Function ***/
+std::string FacemeshEngine::GetModelFilename(const std::string& work_dir)
+{
+    return work_dir + "/model/" + MODEL_NAME;
+}
+
 int32_t FacemeshEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
 {
     /* Set model information */
-    std::string model_filename = work_dir + "/model/" + MODEL_NAME;
+    std::string model_filename = GetModelFilename(work_dir);
 
     /* Set input tensor info */
     input_tensor_info_list_.clear();
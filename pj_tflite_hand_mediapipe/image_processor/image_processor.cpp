@@ -32,6 +32,7 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "compute_resource_manager.h"
 #include "palm_detection_engine.h"
 #include "hand_landmark_engine.h"
 #include "image_processor.h"
@@ -93,12 +94,15 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         return -1;
     }
 
+    auto& resource_manager = ComputeResourceManager::GetInstance();
+    resource_manager.ConfigureMainThread(input_param.num_threads);
+
     s_palm_detection_engine.reset(new PalmDetectionEngine());
-    if (s_palm_detection_engine->Initialize(input_param.work_dir, input_param.num_threads) != PalmDetectionEngine::kRetOk) {
+    if (s_palm_detection_engine->Initialize(input_param.work_dir, resource_manager.Reserve("PalmDetectionEngine", input_param.num_threads).num_threads) != PalmDetectionEngine::kRetOk) {
         return -1;
     }
     s_hand_landmark_engine.reset(new HandLandmarkEngine());
-    if (s_hand_landmark_engine->Initialize(input_param.work_dir, input_param.num_threads) != HandLandmarkEngine::kRetOk) {
+    if (s_hand_landmark_engine->Initialize(input_param.work_dir, resource_manager.Reserve("HandLandmarkEngine", input_param.num_threads).num_threads) != HandLandmarkEngine::kRetOk) {
         return -1;
     }
     return 0;
@@ -120,6 +124,9 @@ int32_t ImageProcessor::Finalize(void)
     s_palm_detection_engine.reset();
     s_hand_landmark_engine.reset();
 
+    CommonHelper::FrameImageCache::GetInstance().Clear();
+    ComputeResourceManager::GetInstance().Reset();
+
     return 0;
 }
 
@@ -147,6 +154,9 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    /* Share the pyramid and color conversion of this frame among the engines */
+    CommonHelper::FrameImageCache::GetInstance().SetFrame(mat);
+
     s_frame_cnt++;
     
     //bool enforce_palm_det = (s_frame_cnt % INTERVAL_TO_ENFORCE_PALM_DET) == 0;		// to increase accuracy
@@ -92,7 +92,16 @@ public:
 };
 
 
+// Editor: anchors in SoA layout, so that the decoder can look up only the candidate boxes
+typedef struct {
+	std::vector<float> x_center;
+	std::vector<float> y_center;
+	std::vector<float> h;
+	std::vector<float> w;
+} AnchorsSoA;
+
 
 namespace mediapipe {
 	int GenerateAnchors(std::vector<Anchor>* anchors, const SsdAnchorsCalculatorOptions& options);
+	int GenerateAnchors(AnchorsSoA* anchors, const SsdAnchorsCalculatorOptions& options);
 }
\ No newline at end of file
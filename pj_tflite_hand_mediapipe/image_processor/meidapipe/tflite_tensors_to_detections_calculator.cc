@@ -17,6 +17,7 @@
 // ----------------------------------------------------------------------
 
 #include <stdio.h>
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <unordered_map>
@@ -41,116 +42,118 @@
 
 namespace mediapipe {
 
-	int DecodeBoxes(const TfLiteTensorsToDetectionsCalculatorOptions &options_, const float* raw_boxes, const std::vector<Anchor>& anchors, std::vector<float>& boxes)
+	// Editor: the score threshold in the raw (logit) domain. sigmoid is monotonic, so sigmoid(x) >= thresh <=> x >= logit(thresh)
+	// A small margin is subtracted to absorb the rounding error. The exact check is done with sigmoid for the candidates
+	static float CalculateRawScoreThreshold(const TfLiteTensorsToDetectionsCalculatorOptions &options_)
 	{
-		int num_boxes_ = options_.num_boxes();
-		int num_coords_ = options_.num_coords();
-		if (boxes.size() != num_boxes_ * num_coords_) {
-			return -1;
-		}
-		if (anchors.size() != num_boxes_) {
-			return -1;
-		}
+		const float thresh = options_.min_score_thresh();
+		if (!options_.sigmoid_score()) return thresh;
+		if (thresh <= 0.0f) return -std::numeric_limits<float>::infinity();
+		if (thresh >= 1.0f) return std::numeric_limits<float>::infinity();
+		constexpr float kMargin = 1e-3f;
+		return std::log(thresh / (1.0f - thresh)) - kMargin;
+	}
 
-		for (int i = 0; i < num_boxes_; ++i) {
-			const int box_offset = i * num_coords_ + options_.box_coord_offset();
-			
-			float y_center = raw_boxes[box_offset];
-			float x_center = raw_boxes[box_offset + 1];
-			float h = raw_boxes[box_offset + 2];
-			float w = raw_boxes[box_offset + 3];
-			if (options_.reverse_output_order()) {
-				x_center = raw_boxes[box_offset];
-				y_center = raw_boxes[box_offset + 1];
-				w = raw_boxes[box_offset + 2];
-				h = raw_boxes[box_offset + 3];
+	// Editor: indices of the boxes which have at least one raw score >= raw_thresh
+	static void FindCandidates(const TfLiteTensorsToDetectionsCalculatorOptions &options_, const float* raw_scores, float raw_thresh, std::vector<int>& candidates)
+	{
+		constexpr int kBlockSize = 16;
+		const int num_boxes = options_.num_boxes();
+		const int num_classes = options_.num_classes();
+		candidates.clear();
+		if (num_classes == 1) {
+			int i = 0;
+			for (; i + kBlockSize <= num_boxes; i += kBlockSize) {
+				// Skip the block at once if no score passes (most of the anchors). This loop is vectorized
+				float score_max = raw_scores[i];
+				for (int j = 1; j < kBlockSize; ++j) {
+					score_max = (std::max)(score_max, raw_scores[i + j]);
+				}
+				if (score_max < raw_thresh) continue;
+				for (int j = 0; j < kBlockSize; ++j) {
+					if (raw_scores[i + j] >= raw_thresh) candidates.push_back(i + j);
+				}
 			}
-
-			x_center = x_center / options_.x_scale() * anchors[i].w() + anchors[i].x_center();
-			y_center = y_center / options_.y_scale() * anchors[i].h() + anchors[i].y_center();
-			if (options_.apply_exponential_on_box_size()) {
-				h = std::exp(h / options_.h_scale()) * anchors[i].h();
-				w = std::exp(w / options_.w_scale()) * anchors[i].w();
-			} else {
-				h = h / options_.h_scale() * anchors[i].h();
-				w = w / options_.w_scale() * anchors[i].w();
+			for (; i < num_boxes; ++i) {
+				if (raw_scores[i] >= raw_thresh) candidates.push_back(i);
 			}
-
-			const float ymin = y_center - h / 2.f;
-			const float xmin = x_center - w / 2.f;
-			const float ymax = y_center + h / 2.f;
-			const float xmax = x_center + w / 2.f;
-
-			boxes[i * num_coords_ + 0] = ymin;
-			boxes[i * num_coords_ + 1] = xmin;
-			boxes[i * num_coords_ + 2] = ymax;
-			boxes[i * num_coords_ + 3] = xmax;
-
-			if (options_.num_keypoints()) {
-				for (int k = 0; k < options_.num_keypoints(); ++k) {
-					const int offset = i * num_coords_ + options_.keypoint_coord_offset() + k * options_.num_values_per_keypoint();
-
-					float keypoint_y = raw_boxes[offset];
-					float keypoint_x = raw_boxes[offset + 1];
-					if (options_.reverse_output_order()) {
-						keypoint_x = raw_boxes[offset];
-						keypoint_y = raw_boxes[offset + 1];
+		} else {
+			for (int i = 0; i < num_boxes; ++i) {
+				for (int score_idx = 0; score_idx < num_classes; ++score_idx) {
+					if (raw_scores[i * num_classes + score_idx] >= raw_thresh) {
+						candidates.push_back(i);
+						break;
 					}
-
-					boxes[offset] = keypoint_x / options_.x_scale() * anchors[i].w() + anchors[i].x_center();
-					boxes[offset + 1] = keypoint_y / options_.y_scale() * anchors[i].h() + anchors[i].y_center();
 				}
 			}
 		}
-		return 0;
 	}
 
-
-	int ConvertToDetections(
-		const TfLiteTensorsToDetectionsCalculatorOptions &options_,
-		const float* detection_boxes, const float* detection_scores,
-		const int* detection_classes, std::vector<Detection>& output_detections)
+	static void DecodeBox(const TfLiteTensorsToDetectionsCalculatorOptions &options_, const float* raw_boxes, const AnchorsSoA& anchors, int i, Detection& detection)
 	{
-		for (int i = 0; i < options_.num_boxes(); ++i) {
-			if (detection_scores[i] < options_.min_score_thresh()) continue;
-			const int box_offset = i * options_.num_coords();
-			Detection detection;
-			detection.score = detection_scores[i];
-			detection.class_id = detection_classes[i];
-			detection.x = detection_boxes[box_offset + 1];
-			detection.y = detection_boxes[box_offset + 0];
-			detection.w = detection_boxes[box_offset + 3] - detection_boxes[box_offset + 1];
-			detection.h = detection_boxes[box_offset + 2] - detection_boxes[box_offset + 0];
-			
-			// Add keypoints.
-			if (options_.num_keypoints() > 0) {
-				detection.keypoints.clear();
-				std::vector<std::pair<int, int>> keypoints(options_.num_keypoints());
-				for (int kp_id = 0; kp_id < options_.num_keypoints() * options_.num_values_per_keypoint(); kp_id += options_.num_values_per_keypoint()) {
-					std::pair<float, float> keypoint;
-					const int keypoint_index = box_offset + options_.keypoint_coord_offset() + kp_id;
-					keypoint.first = detection_boxes[keypoint_index + 0];
-					keypoint.second = detection_boxes[keypoint_index + 1];
-					detection.keypoints.push_back(keypoint);
-				}
+		const int box_offset = i * options_.num_coords() + options_.box_coord_offset();
+
+		float y_center = raw_boxes[box_offset];
+		float x_center = raw_boxes[box_offset + 1];
+		float h = raw_boxes[box_offset + 2];
+		float w = raw_boxes[box_offset + 3];
+		if (options_.reverse_output_order()) {
+			x_center = raw_boxes[box_offset];
+			y_center = raw_boxes[box_offset + 1];
+			w = raw_boxes[box_offset + 2];
+			h = raw_boxes[box_offset + 3];
+		}
+
+		x_center = x_center / options_.x_scale() * anchors.w[i] + anchors.x_center[i];
+		y_center = y_center / options_.y_scale() * anchors.h[i] + anchors.y_center[i];
+		if (options_.apply_exponential_on_box_size()) {
+			h = std::exp(h / options_.h_scale()) * anchors.h[i];
+			w = std::exp(w / options_.w_scale()) * anchors.w[i];
+		} else {
+			h = h / options_.h_scale() * anchors.h[i];
+			w = w / options_.w_scale() * anchors.w[i];
+		}
+
+		const float ymin = y_center - h / 2.f;
+		const float xmin = x_center - w / 2.f;
+		const float ymax = y_center + h / 2.f;
+		const float xmax = x_center + w / 2.f;
+		detection.x = xmin;
+		detection.y = ymin;
+		detection.w = xmax - xmin;
+		detection.h = ymax - ymin;
+
+		// Add keypoints.
+		detection.keypoints.clear();
+		for (int k = 0; k < options_.num_keypoints(); ++k) {
+			const int offset = i * options_.num_coords() + options_.keypoint_coord_offset() + k * options_.num_values_per_keypoint();
+
+			float keypoint_y = raw_boxes[offset];
+			float keypoint_x = raw_boxes[offset + 1];
+			if (options_.reverse_output_order()) {
+				keypoint_x = raw_boxes[offset];
+				keypoint_y = raw_boxes[offset + 1];
 			}
-			output_detections.push_back(detection);
-			
+
+			std::pair<float, float> keypoint;
+			keypoint.first = keypoint_x / options_.x_scale() * anchors.w[i] + anchors.x_center[i];
+			keypoint.second = keypoint_y / options_.y_scale() * anchors.h[i] + anchors.y_center[i];
+			detection.keypoints.push_back(keypoint);
 		}
-		return 0;
 	}
 
 
+	int Process(const TfLiteTensorsToDetectionsCalculatorOptions &options, const float* raw_boxes, const float* raw_scores, const AnchorsSoA& anchors, std::vector<Detection>& output_detections) {
+		if (anchors.x_center.size() != options.num_boxes()) {
+			return -1;
+		}
 
-	int Process(const TfLiteTensorsToDetectionsCalculatorOptions &options, const float* raw_boxes, const float* raw_scores, const std::vector<Anchor>& anchors, std::vector<Detection>& output_detections) {
-		std::vector<float> boxes(options.num_boxes() * options.num_coords());
-		DecodeBoxes(options, raw_boxes, anchors, boxes);
-
-		std::vector<float> detection_scores(options.num_boxes());
-		std::vector<int> detection_classes(options.num_boxes());
+		// Find candidates without calculating sigmoid
+		std::vector<int> candidates;
+		FindCandidates(options, raw_scores, CalculateRawScoreThreshold(options), candidates);
 
 		// Filter classes by scores.
-		for (int i = 0; i < options.num_boxes(); ++i) {
+		for (int i : candidates) {
 			int class_id = -1;
 			float max_score = -std::numeric_limits<float>::max();
 			// Find the top score for box i.
@@ -172,11 +175,15 @@ namespace mediapipe {
 					class_id = score_idx;
 				}
 			}
-			detection_scores[i] = max_score;
-			detection_classes[i] = class_id;
-		}
+			if (max_score < options.min_score_thresh()) continue;
 
-		ConvertToDetections(options, boxes.data(), detection_scores.data(), detection_classes.data(), output_detections);
+			// Decode the box only for the detection
+			Detection detection;
+			detection.score = max_score;
+			detection.class_id = class_id;
+			DecodeBox(options, raw_boxes, anchors, i, detection);
+			output_detections.push_back(detection);
+		}
 		return 0;
 	}
 
@@ -36,6 +36,7 @@ limitations under the License.
 
 /* for My modules */
 #include "common_helper.h"
+#include "common_helper_cv.h"
 #include "inference_helper.h"
 #include "palm_detection_engine.h"
 
@@ -50,7 +51,7 @@ limitations under the License.
 static float CalculateRotation(const Detection& det);
 static void Nms(std::vector<Detection>& detection_list, std::vector<Detection>& detection_list_nms, bool use_weight);
 static void RectTransformationCalculator(const Detection& det, const float rotation, float& x, float& y, float& width, float& height);
-static std::vector<Anchor> s_anchors;
+static AnchorsSoA s_anchors;
 
 /*** Function ***/
 int32_t PalmDetectionEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
@@ -135,11 +136,12 @@ int32_t PalmDetectionEngine::Process(const cv::Mat& original_mat, Result& result
     const auto& t_pre_process0 = std::chrono::steady_clock::now();
     InputTensorInfo& input_tensor_info = input_tensor_info_list_[0];
     /* do resize and color conversion here because some inference engine doesn't support these operations */
-    cv::Mat img_src;
-    cv::resize(original_mat, img_src, cv::Size(input_tensor_info.GetWidth(), input_tensor_info.GetHeight()));
-#ifndef CV_COLOR_IS_RGB
-    cv::cvtColor(img_src, img_src, cv::COLOR_BGR2RGB);
-#endif
+    int32_t crop_x = 0;
+    int32_t crop_y = 0;
+    int32_t crop_w = original_mat.cols;
+    int32_t crop_h = original_mat.rows;
+    cv::Mat img_src = cv::Mat(input_tensor_info.GetHeight(), input_tensor_info.GetWidth(), CV_8UC3);
+    CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, true, CommonHelper::kCropTypeStretch);
     input_tensor_info.data = img_src.data;
     input_tensor_info.data_type = InputTensorInfo::kDataTypeImage;
     input_tensor_info.image_info.width = img_src.cols;
@@ -32,6 +32,7 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "camera_model.h"
 #include "lane_engine.h"
 #include "image_processor.h"
 
@@ -42,6 +43,8 @@ limitations under the License.
 
 /*** Global variable ***/
 std::unique_ptr<LaneEngine> s_engine;
+static RoadAreaEstimator s_road_area_estimator;
+static bool s_is_crop_road_area = false;     /* Off by default. The crop keeps the aspect of the default crop area (bottom, w x w/2) */
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -108,6 +111,10 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
     switch (cmd) {
     case 0:
+        /* Toggle crop area b/w road area estimated from camera parameter and the engine's default area */
+        s_is_crop_road_area = !s_is_crop_road_area;
+        PRINT("Crop road area: %s\n", s_is_crop_road_area ? "ON" : "OFF");
+        return 0;
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
         return -1;
@@ -122,7 +129,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     LaneEngine::Result lane_result;
-    if (s_engine->Process(mat, lane_result) != LaneEngine::kRetOk) {
+    if (s_engine->Process(mat, lane_result, s_is_crop_road_area ? s_road_area_estimator.Get(mat.size(), 2.0f) : cv::Rect()) != LaneEngine::kRetOk) {
         return -1;
     }
 
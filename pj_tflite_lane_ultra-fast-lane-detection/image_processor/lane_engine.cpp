@@ -217,7 +217,7 @@ static inline std::vector<bool> CheckIfValid(const std::vector<float>& val_list,
     return res;
 }
 
-int32_t LaneEngine::Process(const cv::Mat& original_mat, Result& result)
+int32_t LaneEngine::Process(const cv::Mat& original_mat, Result& result, const cv::Rect& crop_area)
 {
     if (!inference_helper_) {
         PRINT_E("Inference helper is not created\n");
@@ -232,6 +232,12 @@ int32_t LaneEngine::Process(const cv::Mat& original_mat, Result& result)
     int32_t crop_y = 0;
     int32_t crop_w = original_mat.cols;
     int32_t crop_h = original_mat.rows;
+    if (crop_area.area() > 0) {
+        crop_x = crop_area.x;
+        crop_y = crop_area.y;
+        crop_w = crop_area.width;
+        crop_h = crop_area.height;
+    }
     cv::Mat img_src = cv::Mat::zeros(input_tensor_info.GetHeight(), input_tensor_info.GetWidth(), CV_8UC3);
     CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeStretch);
     //CommonHelper::CropResizeCvt(original_mat, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeCut);
@@ -32,6 +32,7 @@ limitations under the License.
 #include "common_helper.h"
 #include "common_helper_cv.h"
 #include "inference_helper.h"
+#include "startup_profiler.h"
 #include "frame_interpolation_engine.h"
 
 /*** Macro ***/
@@ -63,9 +64,14 @@ limitations under the License.
 #define IS_RGB      true
 #define TENSORTYPE  TensorInfo::kTensorTypeFp32
 
+/* Number of inferences in Initialize to make the first frame as fast as others */
+static constexpr int32_t kWarmupNum = 1;
+
 /*** Function ***/
 int32_t FrameInterpolationEngine::Initialize(const std::string& work_dir, const int32_t num_threads)
 {
+    StartupProfiler profiler(TAG);
+
     /* Set model information */
     std::string model_filename = work_dir + "/model/" + MODEL_NAME;
 
@@ -111,10 +117,31 @@ int32_t FrameInterpolationEngine::Initialize(const std::string& work_dir, const
         inference_helper_.reset();
         return kRetErr;
     }
+    profiler.Mark("initialize");    /* model load, delegate init and weight packing */
+
+    /* The first invocations are slow (XNNPACK packs weights, buffers are allocated). Do them here instead of at the first frame */
+    if (Warmup(kWarmupNum) != kRetOk) {
+        return kRetErr;
+    }
+    profiler.Mark("warmup");
+    profiler.Finish();
 
     return kRetOk;
 }
 
+/* Run inference on gray images so that lazy allocation and weight packing are done before the first frame */
+int32_t FrameInterpolationEngine::Warmup(int32_t warmup_num)
+{
+    cv::Mat img_src = cv::Mat(input_tensor_info_list_[0].GetHeight(), input_tensor_info_list_[0].GetWidth(), CV_8UC3, cv::Scalar(128, 128, 128));
+    for (int32_t i = 0; i < warmup_num; i++) {
+        Result result;
+        if (Process(img_src, img_src, 0.5f, result) != kRetOk) {
+            return kRetErr;
+        }
+    }
+    return kRetOk;
+}
+
 int32_t FrameInterpolationEngine::Finalize()
 {
 
@@ -184,19 +211,12 @@ int32_t FrameInterpolationEngine::Process(const cv::Mat& image_0, const cv::Mat&
 
     /*** PostProcess ***/
     const auto& t_post_process0 = std::chrono::steady_clock::now();
-    /* Retrieve the result */
-    const int32_t output_height = input_tensor_info_list_[0].image_info.height;
-    const int32_t output_width = input_tensor_info_list_[0].image_info.width;
-    //const std::vector<float> value_list(output_tensor_info_list_[0].GetDataAsFloat(), output_tensor_info_list_[0].GetDataAsFloat() + output_height * output_width * 3);
-    //printf("%f, %f, %f\n", value_list[0], value_list[100], value_list[400]);
-    cv::Mat mat_out_fp32(cv::Size(output_width, output_height), CV_32FC3, output_tensor_info_list_[0].GetDataAsFloat());
-    cv::Mat mat_out;
-    mat_out_fp32.convertTo(mat_out, CV_8UC3, 255);
-    if (IS_RGB) cv::cvtColor(mat_out, mat_out, cv::COLOR_RGB2BGR);
+    if (PostProcess(result) != kRetOk) {
+        return kRetErr;
+    }
     const auto& t_post_process1 = std::chrono::steady_clock::now();
 
     /* Return the results */
-    result.mat_out = mat_out;
     result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
     result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
     result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;;
@@ -204,3 +224,114 @@ int32_t FrameInterpolationEngine::Process(const cv::Mat& image_0, const cv::Mat&
     return kRetOk;
 }
 
+
+int32_t FrameInterpolationEngine::PushFrame(const cv::Mat& image, double& time_pre_process)
+{
+    if (!inference_helper_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    const auto& t_pre_process0 = std::chrono::steady_clock::now();
+
+    /* Resize, color conversion and normalization [0.0, 1.0] are done here only once per frame */
+    int32_t crop_x = 0;
+    int32_t crop_y = 0;
+    int32_t crop_w = image.cols;
+    int32_t crop_h = image.rows;
+    cv::Mat img_src = cv::Mat::zeros(input_tensor_info_list_[0].GetHeight(), input_tensor_info_list_[0].GetWidth(), CV_8UC3);
+    CommonHelper::CropResizeCvt(image, img_src, crop_x, crop_y, crop_w, crop_h, IS_RGB, CommonHelper::kCropTypeStretch);
+
+    stream_frame_num_++;
+    cv::Mat& blob = stream_blob_list_[stream_frame_num_ % 2];   /* overwrite the oldest frame */
+    if (IS_NCHW) {
+        cv::Mat img_fp32;
+        img_src.convertTo(img_fp32, CV_32FC3, 1.0 / 255.0);
+        blob.create(3, img_src.rows * img_src.cols, CV_32FC1);
+        for (int32_t c = 0; c < 3; c++) {
+            cv::Mat plane = blob.row(c).reshape(1, img_src.rows);   /* HWC -> CHW */
+            cv::extractChannel(img_fp32, plane, c);
+        }
+    } else {
+        img_src.convertTo(blob, CV_32FC3, 1.0 / 255.0);
+    }
+    const auto& t_pre_process1 = std::chrono::steady_clock::now();
+    time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
+    return kRetOk;
+}
+
+int32_t FrameInterpolationEngine::ProcessPushedFrames(const std::vector<float>& time_list, std::vector<Result>& result_list)
+{
+    if (!inference_helper_) {
+        PRINT_E("Inference helper is not created\n");
+        return kRetErr;
+    }
+    if (stream_frame_num_ < 2) {
+        PRINT_E("Two frames need to be pushed\n");
+        return kRetErr;
+    }
+    result_list.clear();
+
+    /*** PreProcess ***/
+    /* Set the image tensors only once. They stay in the input tensors while only time is updated */
+    const auto& t_pre_process0 = std::chrono::steady_clock::now();
+    const int32_t data_type_blob = IS_NCHW ? InputTensorInfo::kDataTypeBlobNchw : InputTensorInfo::kDataTypeBlobNhwc;
+    input_tensor_info_list_[0].data = stream_blob_list_[(stream_frame_num_ - 1) % 2].data;
+    input_tensor_info_list_[0].data_type = data_type_blob;
+    input_tensor_info_list_[1].data = stream_blob_list_[stream_frame_num_ % 2].data;
+    input_tensor_info_list_[1].data_type = data_type_blob;
+    std::vector<InputTensorInfo> image_tensor_info_list = { input_tensor_info_list_[0], input_tensor_info_list_[1] };
+    if (inference_helper_->PreProcess(image_tensor_info_list) != InferenceHelper::kRetOk) {
+        return kRetErr;
+    }
+    const auto& t_pre_process1 = std::chrono::steady_clock::now();
+    const double time_pre_process_image = static_cast<std::chrono::duration<double>>(t_pre_process1 - t_pre_process0).count() * 1000.0;
+
+    std::vector<InputTensorInfo> time_tensor_info_list = { input_tensor_info_list_[2] };
+    for (float time : time_list) {
+        Result result;
+        const auto& t_pre_process_time0 = std::chrono::steady_clock::now();
+        time_tensor_info_list[0].data = &time;
+        if (inference_helper_->PreProcess(time_tensor_info_list) != InferenceHelper::kRetOk) {
+            return kRetErr;
+        }
+        const auto& t_pre_process_time1 = std::chrono::steady_clock::now();
+
+        /*** Inference ***/
+        const auto& t_inference0 = std::chrono::steady_clock::now();
+        if (inference_helper_->Process(output_tensor_info_list_) != InferenceHelper::kRetOk) {
+            return kRetErr;
+        }
+        const auto& t_inference1 = std::chrono::steady_clock::now();
+
+        /*** PostProcess ***/
+        const auto& t_post_process0 = std::chrono::steady_clock::now();
+        if (PostProcess(result) != kRetOk) {
+            return kRetErr;
+        }
+        const auto& t_post_process1 = std::chrono::steady_clock::now();
+
+        /* The cost to set image tensors is counted only in the first result */
+        result.time_pre_process = static_cast<std::chrono::duration<double>>(t_pre_process_time1 - t_pre_process_time0).count() * 1000.0;
+        if (result_list.empty()) result.time_pre_process += time_pre_process_image;
+        result.time_inference = static_cast<std::chrono::duration<double>>(t_inference1 - t_inference0).count() * 1000.0;
+        result.time_post_process = static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;
+        result_list.push_back(result);
+    }
+
+    return kRetOk;
+}
+
+int32_t FrameInterpolationEngine::PostProcess(Result& result)
+{
+    /* Retrieve the result */
+    const int32_t output_height = input_tensor_info_list_[0].GetHeight();
+    const int32_t output_width = input_tensor_info_list_[0].GetWidth();
+    //const std::vector<float> value_list(output_tensor_info_list_[0].GetDataAsFloat(), output_tensor_info_list_[0].GetDataAsFloat() + output_height * output_width * 3);
+    //printf("%f, %f, %f\n", value_list[0], value_list[100], value_list[400]);
+    cv::Mat mat_out_fp32(cv::Size(output_width, output_height), CV_32FC3, output_tensor_info_list_[0].GetDataAsFloat());
+    cv::Mat mat_out;
+    mat_out_fp32.convertTo(mat_out, CV_8UC3, 255);  /* copy here because the output tensor is overwritten by the next inference */
+    if (IS_RGB) cv::cvtColor(mat_out, mat_out, cv::COLOR_RGB2BGR);
+    result.mat_out = mat_out;
+    return kRetOk;
+}
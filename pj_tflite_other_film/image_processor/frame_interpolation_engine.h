@@ -53,11 +53,24 @@ public:
     int32_t Finalize(void);
     int32_t Process(const cv::Mat& image_0, const cv::Mat& image_1, float time, Result& result);
 
+    /* Streaming mode (e.g. frame rate up-conversion for video) */
+    /* The frame pushed previously becomes image_0, and the new frame becomes image_1. Each frame is pre-processed only once */
+    int32_t PushFrame(const cv::Mat& image, double& time_pre_process);
+    /* Generate interpolated frames at each time between the last two pushed frames. Image tensors are set only once for all the times */
+    int32_t ProcessPushedFrames(const std::vector<float>& time_list, std::vector<Result>& result_list);
+
+private:
+    int32_t Warmup(int32_t warmup_num);
+    int32_t PostProcess(Result& result);
+
 
 private:
     std::unique_ptr<InferenceHelper> inference_helper_;
     std::vector<InputTensorInfo> input_tensor_info_list_;
     std::vector<OutputTensorInfo> output_tensor_info_list_;
+
+    std::array<cv::Mat, 2> stream_blob_list_;   /* pre-processed (normalized) frames. the newest one is [stream_frame_num_ % 2] */
+    int32_t stream_frame_num_ = 0;
 };
 
 #endif
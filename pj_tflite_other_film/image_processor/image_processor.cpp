@@ -24,6 +24,8 @@ limitations under the License.
 #include <algorithm>
 #include <chrono>
 #include <memory>
+#include <future>
+#include <functional>
 
 /* for OpenCV */
 #include <opencv2/opencv.hpp>
@@ -46,6 +48,12 @@ static constexpr bool  kIsDrawAllResult = true;
 std::unique_ptr<FrameInterpolationEngine> s_engine;
 CommonHelper::NiceColorGenerator s_nice_color_generator(16);
 
+/* for streaming mode */
+static std::future<int32_t> s_stream_future;
+static cv::Mat s_stream_frame_previous;
+static std::vector<cv::Mat> s_stream_image_result_list;    /* written by the pipeline thread */
+static ImageProcessor::Result s_stream_result;              /* written by the pipeline thread */
+
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
 {
@@ -59,6 +67,43 @@ static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double f
 }
 
 
+/* Run on the pipeline thread. The engine is accessed only from this thread while streaming */
+static int32_t InterpolateStream(cv::Mat frame_previous, cv::Mat frame, int32_t interpolation_num, std::vector<cv::Mat>& image_result_list, ImageProcessor::Result& result)
+{
+    image_result_list.clear();
+    result = ImageProcessor::Result{ 0, 0, 0 };
+
+    double time_pre_process = 0;
+    if (s_engine->PushFrame(frame, time_pre_process) != FrameInterpolationEngine::kRetOk) {
+        return -1;
+    }
+    result.time_pre_process = time_pre_process;
+    if (frame_previous.empty()) return 0;   /* the first frame */
+
+    std::vector<float> time_list;
+    for (int32_t i = 1; i <= interpolation_num; i++) {
+        time_list.push_back(static_cast<float>(i) / (interpolation_num + 1));
+    }
+    std::vector<FrameInterpolationEngine::Result> engine_result_list;
+    if (s_engine->ProcessPushedFrames(time_list, engine_result_list) != FrameInterpolationEngine::kRetOk) {
+        return -1;
+    }
+
+    image_result_list.push_back(frame_previous);
+    for (auto& engine_result : engine_result_list) {
+        const auto& t_post_process0 = std::chrono::steady_clock::now();
+        cv::Mat image_result;
+        cv::resize(engine_result.mat_out, image_result, frame.size());
+        image_result_list.push_back(image_result);
+        const auto& t_post_process1 = std::chrono::steady_clock::now();
+        result.time_pre_process += engine_result.time_pre_process;
+        result.time_inference += engine_result.time_inference;
+        result.time_post_process += engine_result.time_post_process + static_cast<std::chrono::duration<double>>(t_post_process1 - t_post_process0).count() * 1000.0;
+    }
+    return 0;
+}
+
+
 int32_t ImageProcessor::Initialize(const InputParam& input_param)
 {
     if (s_engine) {
@@ -82,6 +127,9 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
+    if (s_stream_future.valid()) s_stream_future.wait();
+    s_stream_frame_previous = cv::Mat();
+
     if (s_engine->Finalize() != FrameInterpolationEngine::kRetOk) {
         return -1;
     }
@@ -131,3 +179,34 @@ int32_t ImageProcessor::Process(cv::Mat& image_0, cv::Mat& image_1, float time,
     return 0;
 }
 
+
+int32_t ImageProcessor::ProcessStream(cv::Mat& frame, int32_t interpolation_num, Result& result, std::vector<cv::Mat>& image_result_list)
+{
+    if (!s_engine) {
+        PRINT_E("Not initialized\n");
+        return -1;
+    }
+
+    /* Wait for the previous pair. Its result is returned by this call */
+    image_result_list.clear();
+    result = Result{ 0, 0, 0 };
+    if (s_stream_future.valid()) {
+        if (s_stream_future.get() != 0) return -1;
+        image_result_list = s_stream_image_result_list;
+        result = s_stream_result;
+    }
+
+    if (frame.empty()) {
+        /* Flush. The last frame doesn't have the next frame to interpolate with */
+        if (!s_stream_frame_previous.empty()) image_result_list.push_back(s_stream_frame_previous);
+        s_stream_frame_previous = cv::Mat();
+        return 0;
+    }
+
+    /* Start interpolation of (t-1, t) on the pipeline thread, so that it overlaps with reading the next frame by the caller */
+    cv::Mat frame_current = frame.clone();  /* the caller may reuse the buffer for the next frame */
+    s_stream_future = std::async(std::launch::async, InterpolateStream, s_stream_frame_previous, frame_current, interpolation_num, std::ref(s_stream_image_result_list), std::ref(s_stream_result));
+    s_stream_frame_previous = frame_current;
+
+    return 0;
+}
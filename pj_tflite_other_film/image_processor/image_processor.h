@@ -42,6 +42,10 @@ typedef struct {
 
 int32_t Initialize(const InputParam& input_param);
 int32_t Process(cv::Mat& image_0, cv::Mat& image_1, float time, Result& result, cv::Mat& image_result);
+/* Streaming mode for video frame rate up-conversion. Input frames one by one */
+/* image_result_list receives [frame(t-1), interpolated frames between t-1 and t], because interpolation for (t-1, t) runs on the pipeline thread while the caller reads the next frame */
+/* Input an empty mat after the last frame to receive the last frame */
+int32_t ProcessStream(cv::Mat& frame, int32_t interpolation_num, Result& result, std::vector<cv::Mat>& image_result_list);
 int32_t Finalize(void);
 int32_t Command(int32_t cmd);
 
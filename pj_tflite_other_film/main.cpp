@@ -17,6 +17,7 @@ limitations under the License.
 #include <cstdint>
 #include <cstdlib>
 #include <string>
+#include <vector>
 #include <algorithm>
 #include <chrono>
 
@@ -26,6 +27,7 @@ limitations under the License.
 /* for My modules */
 #include "common_helper_cv.h"
 #include "image_processor.h"
+#include "startup_profiler.h"
 
 /*** Macro ***/
 static constexpr char kOutputVideoFilename[] = "";
@@ -33,10 +35,92 @@ static constexpr char kOutputVideoFilename[] = "";
 #define DEFAULT_INPUT_IMAGE_0         RESOURCE_DIR"/frame_interpolation_0.jpg"
 #define DEFAULT_INPUT_IMAGE_1         RESOURCE_DIR"/frame_interpolation_1.jpg"
 #define LOOP_NUM_FOR_TIME_MEASUREMENT -1
+static constexpr int32_t kInterpolationNum = 1;    /* the number of frames generated b/w two frames in video mode (1: 30fps -> 60fps, 3: 30fps -> 120fps) */
 
 /*** Function ***/
+/* Video mode: frame rate up-conversion. Interpolation of the previous pair runs in ImageProcessor while the next frame is read here */
+static int32_t ConvertVideoFrameRate(const std::string& input_name)
+{
+    cv::VideoCapture cap;
+    cap = cv::VideoCapture(input_name);
+    if (!cap.isOpened()) {
+        printf("Unable to open %s\n", input_name.c_str());
+        return -1;
+    }
+    const double fps_output = (cap.get(cv::CAP_PROP_FPS) > 0 ? cap.get(cv::CAP_PROP_FPS) : 30.0) * (kInterpolationNum + 1);
+
+    /* Create video writer to save output video */
+    CommonHelper::VideoSink writer;   /* frames are encoded on a background thread */
+
+    /* Initialize image processor library */
+    ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
+    if (ImageProcessor::Initialize(input_param) != 0) {
+        printf("Initialization Error\n");
+        return -1;
+    }
+    StartupProfiler::PrintAll();
+
+    /*** Process for each frame ***/
+    double total_time_all = 0;
+    int32_t output_frame_cnt = 0;
+    cv::Mat image_input;
+    for (int32_t frame_cnt = 0; ; frame_cnt++) {
+        const auto& time_all0 = std::chrono::steady_clock::now();
+        /* Read image (an empty image at the end flushes the last frame) */
+        const auto& time_cap0 = std::chrono::steady_clock::now();
+        cap.read(image_input);
+        if (!image_input.empty() && image_input.rows > 480) {
+            cv::resize(image_input, image_input, cv::Size(), 480.0 / image_input.rows, 480.0 / image_input.rows);
+        }
+        const auto& time_cap1 = std::chrono::steady_clock::now();
+
+        /* Call image processor library */
+        const auto& time_image_process0 = std::chrono::steady_clock::now();
+        std::vector<cv::Mat> image_result_list;
+        ImageProcessor::Result result;
+        if (ImageProcessor::ProcessStream(image_input, kInterpolationNum, result, image_result_list) != 0) break;
+        const auto& time_image_process1 = std::chrono::steady_clock::now();
+
+        /* Display and save result */
+        for (const auto& image_result : image_result_list) {
+            if (!writer.IsOpened() && kOutputVideoFilename[0] != '\0') {
+                writer.Open(kOutputVideoFilename, fps_output, image_result.size(), 8, true);   /* wait for the encoder instead of dropping frames */
+            }
+            if (writer.IsOpened()) writer.Write(image_result);
+            cv::imshow("image_result", image_result);
+            cv::waitKey(1);
+            output_frame_cnt++;
+        }
+        if (image_input.empty()) break;
+
+        /* Print processing time */
+        const auto& time_all1 = std::chrono::steady_clock::now();
+        double time_all = (time_all1 - time_all0).count() / 1000000.0;
+        printf("Total:               %9.3lf [msec]\n", time_all);
+        printf("  Capture:           %9.3lf [msec]\n", (time_cap1 - time_cap0).count() / 1000000.0);
+        printf("  Image processing:  %9.3lf [msec] (waiting for the previous pair)\n", (time_image_process1 - time_image_process0).count() / 1000000.0);
+        printf("    Pre processing:  %9.3lf [msec]\n", result.time_pre_process);
+        printf("    Inference:       %9.3lf [msec]\n", result.time_inference);
+        printf("    Post processing: %9.3lf [msec]\n", result.time_post_process);
+        printf("=== Finished %d frame ===\n\n", frame_cnt);
+        if (frame_cnt > 0) total_time_all += time_all;
+    }
+
+    /*** Finalize ***/
+    if (output_frame_cnt > 0) {
+        printf("=== Output %d frames (%.1f fps) in %.1f [sec] ===\n", output_frame_cnt, fps_output, total_time_all / 1000.0);
+    }
+    ImageProcessor::Finalize();
+    return 0;
+}
+
 int32_t main(int argc, char* argv[])
 {
+    /* Video mode if a video file is specified */
+    if (argc == 2) {
+        return ConvertVideoFrameRate(argv[1]);
+    }
+
     /*** Initialize ***/
     /* variables for processing time measurement */
     double total_time_all = 0;
@@ -62,7 +146,7 @@ int32_t main(int argc, char* argv[])
     }
 
     /* Create video writer to save output video */
-    cv::VideoWriter writer;
+    CommonHelper::VideoSink writer;   /* frames are encoded on a background thread */
 
     /* Initialize image processor library */
     ImageProcessor::InputParam input_param = { WORK_DIR, 4 };
@@ -70,6 +154,7 @@ int32_t main(int argc, char* argv[])
         printf("Initialization Error\n");
         return -1;
     }
+    StartupProfiler::PrintAll();
 
     /*** Process for each frame ***/
     int32_t frame_cnt = 0;
@@ -92,9 +177,9 @@ int32_t main(int argc, char* argv[])
         cv::imshow("image_result", image_result);
 
         if (frame_cnt == 0 && kOutputVideoFilename[0] != '\0') {
-            writer = cv::VideoWriter(kOutputVideoFilename, cv::VideoWriter::fourcc('M', 'P', '4', 'V'), 5.0f, image_result.size());
+            writer.Open(kOutputVideoFilename, 5.0f, image_result.size(), 8, true);
         }
-        if (writer.isOpened()) writer.write(image_result);
+        if (writer.IsOpened()) writer.Write(image_result);
 
         /* Input key command */
         int32_t key = cv::waitKey(1) & 0xff;
@@ -32,10 +32,12 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "engine_config.h"
 #include "camera_model.h"
 #include "bounding_box.h"
 #include "detection_engine.h"
 #include "tracker.h"
+#include "detection_scheduler.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -43,15 +45,29 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/*** Setting ***/
+/* Run the model every N frames (and when tracks are uncertain). Tracks are moved by Kalman filter + optical flow on the other frames. 1: every frame */
+static constexpr int32_t kDetectionInterval = 1;
+/* Draw the segmentation of the last model run on the other frames. It doesn't follow the scene, so it's off unless requested */
+static constexpr bool kReuseSegmentation = false;
+
 /*** Global variable ***/
 std::unique_ptr<DetectionEngine> s_engine;
 Tracker s_tracker;
+DetectionScheduler s_scheduler;
+bool s_reuse_segmentation = kReuseSegmentation;
+DetectionEngine::Result s_det_result_last;     /* segmentation and crop only */
 CommonHelper::NiceColorGenerator s_nice_color_generator;
 
 /* For top view transform */
 static CameraModel s_camera_real;
 static CameraModel s_camera_top;
-static cv::Mat s_mat_transform_topview;
+static cv::Mat s_mat_transform_topview;           /* original image -> top view */
+static cv::Mat s_mat_transform_seg2topview;        /* segmentation map (model resolution) -> original image -> top view */
+static cv::Rect s_seg_area_for_transform;           /* area in original image the segmentation map corresponds to */
+static cv::Size s_seg_size_for_transform;
+static cv::Mat s_mat_topview_grid;                  /* pre-rendered grid lines on top view */
+static cv::Mat s_mat_topview_grid_mask;
 #define COLOR_BG  CommonHelper::CreateCvColor(70, 70, 70)
 static cv::Size s_size_topview;
 
@@ -80,6 +96,10 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         s_engine.reset();
         return -1;
     }
+
+    const EngineConfig& config = EngineConfig::GetInstance();
+    s_scheduler = DetectionScheduler(config.GetInt(TAG, "detection_interval", kDetectionInterval));
+    s_reuse_segmentation = config.GetBool(TAG, "reuse_segmentation", kReuseSegmentation);
     return 0;
 }
 
@@ -113,15 +133,36 @@ int32_t ImageProcessor::Command(int32_t cmd)
     }
 }
 
-static void CreateTopViewMat(const cv::Mat& mat_original, cv::Mat& mat_topview)
+static const cv::Mat& GetSegColorLut()
+{
+    static cv::Mat s_mat_lut;
+    if (s_mat_lut.empty()) {
+        s_mat_lut = cv::Mat::zeros(256, 1, CV_8UC3);
+        s_mat_lut.at<cv::Vec3b>(0) = cv::Vec3b(0, 0, 0);
+        s_mat_lut.at<cv::Vec3b>(1) = cv::Vec3b(0, 255, 0);
+        s_mat_lut.at<cv::Vec3b>(2) = cv::Vec3b(0, 0, 255);
+    }
+    return s_mat_lut;
+}
+
+static void ColorizeSeg(const cv::Mat& mat_seg, cv::Mat& mat_color)
 {
-    /* Perspective Transform */
-    mat_topview = cv::Mat(cv::Size(s_camera_top.width, s_camera_top.height), CV_8UC3, COLOR_BG);
-    //cv::warpPerspective(mat_original, mat_topview, s_mat_transform_topview, mat_topview.size(), cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
-    cv::warpPerspective(mat_original, mat_topview, s_mat_transform_topview, mat_topview.size(), cv::INTER_NEAREST);
+    const cv::Mat& mat_lut = GetSegColorLut();
+    mat_color.create(mat_seg.size(), CV_8UC3);
+#pragma omp parallel for
+    for (int32_t y = 0; y < mat_seg.rows; y++) {
+        const uint8_t* p_seg = mat_seg.ptr<uint8_t>(y);
+        cv::Vec3b* p_color = mat_color.ptr<cv::Vec3b>(y);
+        for (int32_t x = 0; x < mat_seg.cols; x++) {
+            p_color[x] = mat_lut.at<cv::Vec3b>(p_seg[x]);
+        }
+    }
+}
 
-#if 1
-    /* Display Grid lines */
+static void CreateTopViewGrid()
+{
+    /* The grid doesn't change, so render it once with its mask and overlay it on every frame */
+    s_mat_topview_grid = cv::Mat(s_size_topview, CV_8UC3, COLOR_BG);
     static constexpr int32_t kDepthInterval = 5;
     static constexpr int32_t kHorizontalRange = 10;
     std::vector<cv::Point3f> object_point_list;
@@ -133,12 +174,48 @@ static void CreateTopViewMat(const cv::Mat& mat_original, cv::Mat& mat_topview)
     cv::projectPoints(object_point_list, s_camera_top.rvec, s_camera_top.tvec, s_camera_top.K, s_camera_top.dist_coeff, image_point_list);
     for (int32_t i = 0; i < static_cast<int32_t>(image_point_list.size()); i++) {
         if (i % 2 != 0) {
-            cv::line(mat_topview, image_point_list[i - 1], image_point_list[i], cv::Scalar(255, 255, 255));
+            cv::line(s_mat_topview_grid, image_point_list[i - 1], image_point_list[i], cv::Scalar(255, 255, 255));
         } else {
-            CommonHelper::DrawText(mat_topview, std::to_string(i / 2 * kDepthInterval) + "[m]", image_point_list[i], 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(255, 255, 255), false);
+            CommonHelper::DrawText(s_mat_topview_grid, std::to_string(i / 2 * kDepthInterval) + "[m]", image_point_list[i], 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(255, 255, 255), false);
+        }
+    }
+
+    cv::Mat mat_diff;
+    cv::absdiff(s_mat_topview_grid, COLOR_BG, mat_diff);
+    cv::cvtColor(mat_diff, mat_diff, cv::COLOR_BGR2GRAY);
+    s_mat_topview_grid_mask = mat_diff > 0;
+}
+
+static void CreateTopViewMat(const cv::Mat& mat_seg, const cv::Rect& seg_area, cv::Mat& mat_topview)
+{
+    /* Compose (segmentation map -> original image) and (original image -> top view) only when the area changes */
+    if (s_mat_transform_seg2topview.empty() || s_seg_area_for_transform != seg_area || s_seg_size_for_transform != mat_seg.size()) {
+        s_seg_area_for_transform = seg_area;
+        s_seg_size_for_transform = mat_seg.size();
+        cv::Mat mat_transform_seg2original = (cv::Mat_<double>(3, 3) <<
+            static_cast<double>(seg_area.width) / mat_seg.cols, 0, seg_area.x,
+            0, static_cast<double>(seg_area.height) / mat_seg.rows, seg_area.y,
+            0, 0, 1);
+        s_mat_transform_seg2topview = s_mat_transform_topview * mat_transform_seg2original;
+    }
+
+    /* Perspective Transform for class index (1 channel, model resolution) */
+    cv::Mat mat_topview_seg;
+    cv::warpPerspective(mat_seg, mat_topview_seg, s_mat_transform_seg2topview, s_size_topview, cv::INTER_NEAREST, cv::BORDER_CONSTANT, cv::Scalar(0));
+
+    /* Color map only the final pixels, and overlay the grid */
+    const cv::Mat& mat_lut = GetSegColorLut();
+    mat_topview.create(s_size_topview, CV_8UC3);
+#pragma omp parallel for
+    for (int32_t y = 0; y < mat_topview.rows; y++) {
+        const uint8_t* p_seg = mat_topview_seg.ptr<uint8_t>(y);
+        const uint8_t* p_grid_mask = s_mat_topview_grid_mask.ptr<uint8_t>(y);
+        const cv::Vec3b* p_grid = s_mat_topview_grid.ptr<cv::Vec3b>(y);
+        cv::Vec3b* p_topview = mat_topview.ptr<cv::Vec3b>(y);
+        for (int32_t x = 0; x < mat_topview.cols; x++) {
+            p_topview[x] = p_grid_mask[x] ? p_grid[x] : mat_lut.at<cv::Vec3b>(p_seg[x]);
         }
     }
-#endif
 }
 
 static void CreateTransformMat(int32_t width, int32_t height, float fov_deg)
@@ -170,6 +247,9 @@ static void CreateTransformMat(int32_t width, int32_t height, float fov_deg)
     cv::projectPoints(object_point_list, s_camera_top.rvec, s_camera_top.tvec, s_camera_top.K, s_camera_top.dist_coeff, image_point_top_list);
 
     s_mat_transform_topview = cv::getPerspectiveTransform(&image_point_real_list[0], &image_point_top_list[0]);
+    s_mat_transform_seg2topview = cv::Mat();
+
+    CreateTopViewGrid();
 }
 
 
@@ -188,29 +268,34 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     /*** Call inference ***/
+    const bool is_detection_frame = s_scheduler.CheckDetectionFrame(mat);
     DetectionEngine::Result det_result;
-    if (s_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
-        return -1;
+    if (is_detection_frame) {
+        if (s_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
+            return -1;
+        }
+        s_det_result_last.mat_seg_max = det_result.mat_seg_max;    /* created for each frame, so no need to copy */
+        s_det_result_last.crop = det_result.crop;
+    } else {
+        if (s_reuse_segmentation) det_result.mat_seg_max = s_det_result_last.mat_seg_max;
+        det_result.crop = s_det_result_last.crop;
     }
 
     /*** Draw target area  ***/
     cv::rectangle(mat, cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
 
     /*** Draw segmentation image for the class of the highest score ***/
-    cv::Mat& mat_seg_max = det_result.mat_seg_max;
-    cv::Mat mat_seg_max_list[] = { mat_seg_max, mat_seg_max, mat_seg_max };
-    cv::merge(mat_seg_max_list, 3, mat_seg_max);
-    cv::Mat mat_lut = cv::Mat::zeros(256, 1, CV_8UC3);
-    mat_lut.at<cv::Vec3b>(0) = cv::Vec3b(0, 0, 0);
-    mat_lut.at<cv::Vec3b>(1) = cv::Vec3b(0, 255, 0);
-    mat_lut.at<cv::Vec3b>(2) = cv::Vec3b(0, 0, 255);
-    cv::LUT(mat_seg_max, mat_lut, mat_seg_max);
-    cv::resize(mat_seg_max, mat_seg_max, mat.size(), 0.0, 0.0, cv::INTER_NEAREST);
-    cv::Mat mat_masked;
-    cv::addWeighted(mat, 0.8, mat_seg_max, 0.5, 0, mat_masked);
+    /* Color map at model resolution, then resize only the color image to the target area */
+    const cv::Mat& mat_seg_max = det_result.mat_seg_max;
+    const cv::Rect seg_area = cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h) & cv::Rect(0, 0, mat.cols, mat.rows);
+    if (!mat_seg_max.empty()) {
+        cv::Mat mat_seg_color;
+        ColorizeSeg(mat_seg_max, mat_seg_color);
+        cv::resize(mat_seg_color, mat_seg_color, seg_area.size(), 0.0, 0.0, cv::INTER_NEAREST);
+        cv::Mat mat_seg_area = mat(seg_area);
+        cv::addWeighted(mat_seg_area, 0.8, mat_seg_color, 0.5, 0, mat_seg_area);
+    }
     //cv::add(mat_seg_max * kResultMixRatio, mat * (1.0f - kResultMixRatio), mat_masked);
-    //cv::hconcat(mat, mat_masked, mat);
-    mat = mat_masked;
 
     /*** Draw detection result (black rectangle) ***/
     int32_t num_det = 0;
@@ -220,7 +305,13 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     /*** Draw tracking result ***/
-    s_tracker.Update(det_result.bbox_list);
+    if (is_detection_frame) {
+        s_tracker.Update(det_result.bbox_list);
+    } else {
+        /* No inference. Only tracks move */
+        s_scheduler.Interpolate(s_tracker);
+    }
+    s_scheduler.UpdateTrackStatus(s_tracker);
     int32_t num_track = 0;
     auto& track_list = s_tracker.GetTrackList();
     for (auto& track : track_list) {
@@ -243,7 +334,11 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
 
     /*** Draw top view ***/
     cv::Mat mat_topview;
-    CreateTopViewMat(mat_seg_max, mat_topview);
+    if (!mat_seg_max.empty()) {
+        CreateTopViewMat(mat_seg_max, seg_area, mat_topview);
+    } else {
+        mat_topview = s_mat_topview_grid.clone();   /* no segmentation for this frame */
+    }
     /* Draw object on top view */
     std::vector<cv::Point2f> normal_points;
     std::vector<cv::Point2f> topview_points;
@@ -281,6 +376,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         if (bbox_num >= NUM_MAX_RESULT) break;
     }
     result.object_num = bbox_num;
+    result.is_detection_frame = is_detection_frame;
 
     result.time_pre_process = det_result.time_pre_process;
     result.time_inference = det_result.time_inference;
@@ -47,6 +47,7 @@ typedef struct {
         int32_t  width;
         int32_t  height;
     } object_list[NUM_MAX_RESULT];
+    bool   is_detection_frame;  // false: detector was not run and objects were moved by tracker
     double time_pre_process;   // [msec]
     double time_inference;    // [msec]
     double time_post_process;  // [msec]
@@ -31,7 +31,9 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "engine_config.h"
 #include "segmentation_engine.h"
+#include "keyframe_scheduler.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -42,8 +44,12 @@ static constexpr bool  kIsDrawAllResult = true;
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/*** Setting ***/
+static constexpr int32_t kKeyframeInterval = 1;    /* see KeyframeScheduler. overwritten by keyframe_interval in EngineConfig */
+
 /*** Global variable ***/
 std::unique_ptr<SegmentationEngine> s_engine;
+KeyframeScheduler s_keyframe_scheduler;
 CommonHelper::NiceColorGenerator s_nice_color_generator(16);
 
 /*** Function ***/
@@ -72,6 +78,8 @@ int32_t ImageProcessor::Initialize(const InputParam& input_param)
         s_engine.reset();
         return -1;
     }
+
+    s_keyframe_scheduler = KeyframeScheduler(EngineConfig::GetInstance().GetInt(TAG, "keyframe_interval", kKeyframeInterval));
     return 0;
 }
 
@@ -116,9 +124,22 @@ int32_t ImageProcessor::Process(cv::Mat& mat, Result& result)
     cv::resize(mat, mat, cv::Size(640, 640 * mat.rows / mat.cols));
 
     SegmentationEngine::Result segmentation_result;
-    if (s_engine->Process(mat, segmentation_result) != SegmentationEngine::kRetOk) {
+    std::vector<cv::Mat> result_list;
+    if (s_keyframe_scheduler.Process(mat, [&](std::vector<cv::Mat>& keyframe_result_list, cv::Rect& crop) {
+        if (s_engine->Process(mat, segmentation_result) != SegmentationEngine::kRetOk) return -1;
+        keyframe_result_list = segmentation_result.mat_out_list;
+        keyframe_result_list.push_back(segmentation_result.mat_out_max);
+        return 0;
+    }, result_list, cv::INTER_NEAREST) != 0) {
         return -1;
     }
+    if (s_keyframe_scheduler.GetFrameCountFromKeyframe() > 0) {
+        segmentation_result.mat_out_max = result_list.back();
+        result_list.pop_back();
+        segmentation_result.mat_out_list = result_list;
+    }
+    segmentation_result.time_pre_process += s_keyframe_scheduler.GetTimeCheck();
+    segmentation_result.time_post_process += s_keyframe_scheduler.GetTimePropagate();
 
     /* Draw segmentation image for all the classes weighted by score */
     cv::Mat mat_all_class = cv::Mat::zeros(segmentation_result.mat_out_list[0].size(), CV_8UC3);
@@ -33,7 +33,9 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "engine_config.h"
 #include "segmentation_engine.h"
+#include "keyframe_scheduler.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -43,8 +45,12 @@ static constexpr float kResultMixRatio = 0.5f;
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/*** Setting ***/
+static constexpr int32_t kKeyframeInterval = 1;    /* see KeyframeScheduler. overwritten by keyframe_interval in EngineConfig */
+
 /*** Global variable ***/
 std::unique_ptr<SegmentationEngine> s_engine;
+KeyframeScheduler s_keyframe_scheduler;
 cv::Mat s_mat_lut;
 extern std::vector<std::array<uint8_t, 3>> s_palette;
 
@@ -96,6 +102,7 @@ int32_t ImageProcessor::Initialize(const InputParam& input_param)
     }
 #endif
 
+    s_keyframe_scheduler = KeyframeScheduler(EngineConfig::GetInstance().GetInt(TAG, "keyframe_interval", kKeyframeInterval));
     return 0;
 }
 
@@ -139,9 +146,17 @@ int32_t ImageProcessor::Process(cv::Mat& mat, Result& result)
     cv::resize(mat, mat, cv::Size(640, 640 * mat.rows / mat.cols));
 
     SegmentationEngine::Result segmentation_result;
-    if (s_engine->Process(mat, segmentation_result) != SegmentationEngine::kRetOk) {
+    std::vector<cv::Mat> result_list;
+    if (s_keyframe_scheduler.Process(mat, [&](std::vector<cv::Mat>& keyframe_result_list, cv::Rect& crop) {
+        if (s_engine->Process(mat, segmentation_result) != SegmentationEngine::kRetOk) return -1;
+        keyframe_result_list = { segmentation_result.mat_out_max };
+        return 0;
+    }, result_list, cv::INTER_NEAREST) != 0) {
         return -1;
     }
+    segmentation_result.mat_out_max = result_list[0];
+    segmentation_result.time_pre_process += s_keyframe_scheduler.GetTimeCheck();
+    segmentation_result.time_post_process += s_keyframe_scheduler.GetTimePropagate();
 
     /* Draw segmentation image for the class of the highest score */
     cv::Mat& mat_seg_max = segmentation_result.mat_out_max;
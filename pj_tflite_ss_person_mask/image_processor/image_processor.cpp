@@ -32,7 +32,9 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "engine_config.h"
 #include "semantic_segmentation_engine.h"
+#include "keyframe_scheduler.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -40,8 +42,12 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/*** Setting ***/
+static constexpr int32_t kKeyframeInterval = 1;    /* see KeyframeScheduler. overwritten by keyframe_interval in EngineConfig */
+
 /*** Global variable ***/
 std::unique_ptr<SemanticSegmentationEngine> s_engine;
+KeyframeScheduler s_keyframe_scheduler;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -68,6 +74,8 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         s_engine.reset();
         return -1;
     }
+
+    s_keyframe_scheduler = KeyframeScheduler(EngineConfig::GetInstance().GetInt(TAG, "keyframe_interval", kKeyframeInterval));
     return 0;
 }
 
@@ -110,9 +118,17 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     SemanticSegmentationEngine::Result ss_result;
-    if (s_engine->Process(mat, ss_result) != SemanticSegmentationEngine::kRetOk) {
+    std::vector<cv::Mat> result_list;
+    if (s_keyframe_scheduler.Process(mat, [&](std::vector<cv::Mat>& keyframe_result_list, cv::Rect& crop) {
+        if (s_engine->Process(mat, ss_result) != SemanticSegmentationEngine::kRetOk) return -1;
+        keyframe_result_list = { ss_result.image_mask };
+        return 0;
+    }, result_list) != 0) {
         return -1;
     }
+    ss_result.image_mask = result_list[0];
+    ss_result.time_pre_process += s_keyframe_scheduler.GetTimeCheck();
+    ss_result.time_post_process += s_keyframe_scheduler.GetTimePropagate();
 
     /* Draw the result */
     cv::cvtColor(ss_result.image_mask, ss_result.image_mask, cv::COLOR_GRAY2BGR);
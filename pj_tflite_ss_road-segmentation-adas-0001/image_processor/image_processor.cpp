@@ -32,7 +32,11 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "engine_config.h"
+#include "camera_model.h"
 #include "semantic_segmentation_engine.h"
+#include "keyframe_scheduler.h"
+#include "overlay_renderer.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -40,8 +44,16 @@ limitations under the License.
 #define PRINT(...)   COMMON_HELPER_PRINT(TAG, __VA_ARGS__)
 #define PRINT_E(...) COMMON_HELPER_PRINT_E(TAG, __VA_ARGS__)
 
+/*** Setting ***/
+/* Aspect (w / h) of the model input (896 x 512). The road area is expanded to it, so that it's not stretched into the model input */
+static constexpr float kRoadAreaAspect = 896.0f / 512.0f;
+static constexpr int32_t kKeyframeInterval = 1;    /* see KeyframeScheduler. overwritten by keyframe_interval in EngineConfig */
+
 /*** Global variable ***/
 std::unique_ptr<SemanticSegmentationEngine> s_engine;
+KeyframeScheduler s_keyframe_scheduler;
+static RoadAreaEstimator s_road_area_estimator;
+static bool s_is_crop_road_area = true;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -83,6 +95,8 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         s_engine.reset();
         return -1;
     }
+
+    s_keyframe_scheduler = KeyframeScheduler(EngineConfig::GetInstance().GetInt(TAG, "keyframe_interval", kKeyframeInterval));
     return 0;
 }
 
@@ -110,6 +124,10 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
     switch (cmd) {
     case 0:
+        /* Toggle crop area b/w road area estimated from camera parameter and the whole image */
+        s_is_crop_road_area = !s_is_crop_road_area;
+        PRINT("Crop road area: %s\n", s_is_crop_road_area ? "ON" : "OFF");
+        return 0;
     default:
         PRINT_E("command(%d) is not supported\n", cmd);
         return -1;
@@ -125,20 +143,52 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     SemanticSegmentationEngine::Result ss_result;
-    if (s_engine->Process(mat, ss_result) != SemanticSegmentationEngine::kRetOk) {
+    std::vector<cv::Mat> result_list;
+    if (s_keyframe_scheduler.Process(mat, [&](std::vector<cv::Mat>& keyframe_result_list, cv::Rect& crop) {
+        if (s_engine->Process(mat, ss_result, s_is_crop_road_area ? s_road_area_estimator.Get(mat.size(), kRoadAreaAspect) : cv::Rect()) != SemanticSegmentationEngine::kRetOk) return -1;
+        keyframe_result_list = ss_result.image_list;
+        crop = cv::Rect(ss_result.crop.x, ss_result.crop.y, ss_result.crop.w, ss_result.crop.h);
+        return 0;
+    }, result_list) != 0) {
         return -1;
     }
-
-#pragma omp parallel for
-    for (int32_t i = 0; i < ss_result.image_list.size(); i++) {
-        cv::cvtColor(ss_result.image_list[i], ss_result.image_list[i], cv::COLOR_GRAY2BGR); /* 1channel -> 3 channel */
-        cv::resize(ss_result.image_list[i], ss_result.image_list[i], mat.size());
-        cv::multiply(ss_result.image_list[i], GetColor(i), ss_result.image_list[i]);
-        ss_result.image_list[i].convertTo(ss_result.image_list[i], CV_8UC3, 1, 0);
+    if (s_keyframe_scheduler.GetFrameCountFromKeyframe() > 0) {
+        /* Propagated from the keyframe, so it covers the crop area of the keyframe */
+        const cv::Rect& crop = s_keyframe_scheduler.GetKeyframeCrop();
+        ss_result.image_list = result_list;
+        ss_result.crop.x = crop.x;
+        ss_result.crop.y = crop.y;
+        ss_result.crop.w = crop.width;
+        ss_result.crop.h = crop.height;
     }
-    for (int32_t i = 0; i < ss_result.image_list.size(); i++) {
-        cv::add(mat, ss_result.image_list[i], mat);
+    ss_result.time_pre_process += s_keyframe_scheduler.GetTimeCheck();
+    ss_result.time_post_process += s_keyframe_scheduler.GetTimePropagate();
+
+    /* Draw the result only on the crop area (the model doesn't see outside of it) */
+    /* Colorize at the model resolution (sum of score x color), then the compositor upsamples and adds it to the frame in one pass */
+    const cv::Rect crop = cv::Rect(ss_result.crop.x, ss_result.crop.y, ss_result.crop.w, ss_result.crop.h);
+    OverlayRenderer::DrawList draw_list;
+    if (!ss_result.image_list.empty()) {
+        const int32_t class_num = static_cast<int32_t>(ss_result.image_list.size());
+        std::vector<cv::Scalar> color_list;
+        for (int32_t i = 0; i < class_num; i++) color_list.push_back(GetColor(i));
+        cv::Mat mat_mask(ss_result.image_list[0].size(), CV_8UC3);
+#pragma omp parallel for
+        for (int32_t y = 0; y < mat_mask.rows; y++) {
+            cv::Vec3b* dst = mat_mask.ptr<cv::Vec3b>(y);
+            for (int32_t x = 0; x < mat_mask.cols; x++) {
+                float color[3] = { 0.0f, 0.0f, 0.0f };
+                for (int32_t i = 0; i < class_num; i++) {
+                    const float score = ss_result.image_list[i].ptr<float>(y)[x];
+                    for (int32_t c = 0; c < 3; c++) color[c] += score * static_cast<float>(color_list[i][c]);
+                }
+                dst[x] = cv::Vec3b(cv::saturate_cast<uint8_t>(color[0]), cv::saturate_cast<uint8_t>(color[1]), cv::saturate_cast<uint8_t>(color[2]));
+            }
+        }
+        draw_list.AddOverlay(mat_mask, crop, OverlayRenderer::kBlendAdd);
     }
+    draw_list.AddRect(crop & cv::Rect(0, 0, mat.cols, mat.rows), CommonHelper::CreateCvColor(0, 0, 0), 2);
+    OverlayRenderer::Render(mat, draw_list);
 
     DrawFps(mat, ss_result.time_inference, cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 
@@ -60,7 +60,7 @@ public:
     ~SemanticSegmentationEngine() {}
     int32_t Initialize(const std::string& work_dir, const int32_t num_threads);
     int32_t Finalize(void);
-    int32_t Process(const cv::Mat& original_mat, Result& result);
+    int32_t Process(const cv::Mat& original_mat, Result& result, const cv::Rect& crop_area = cv::Rect());
 
 
 private:
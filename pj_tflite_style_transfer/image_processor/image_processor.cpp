@@ -32,6 +32,7 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "compute_resource_manager.h"
 #include "style_prediction_engine.h"
 #include "style_transfer_engine.h"
 #include "image_processor.h"
@@ -85,17 +86,20 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         return -1;
     }
 
+    auto& resource_manager = ComputeResourceManager::GetInstance();
+    resource_manager.ConfigureMainThread(input_param.num_threads);
+
     s_work_dir = input_param.work_dir;
 
     s_style_prediction_engine.reset(new StylePredictionEngine());
-    if (s_style_prediction_engine->Initialize(input_param.work_dir, input_param.num_threads) != StylePredictionEngine::kRetOk) {
+    if (s_style_prediction_engine->Initialize(input_param.work_dir, resource_manager.Reserve("StylePredictionEngine", input_param.num_threads).num_threads) != StylePredictionEngine::kRetOk) {
         s_style_prediction_engine->Finalize();
         s_style_prediction_engine.reset();
         return -1;
     }
 
     s_style_transfer_engine.reset(new StyleTransferEngine());
-    if (s_style_transfer_engine->Initialize(input_param.work_dir, input_param.num_threads) != StyleTransferEngine::kRetOk) {
+    if (s_style_transfer_engine->Initialize(input_param.work_dir, resource_manager.Reserve("StyleTransferEngine", input_param.num_threads).num_threads) != StyleTransferEngine::kRetOk) {
         s_style_transfer_engine->Finalize();
         s_style_transfer_engine.reset();
         return -1;
@@ -121,6 +125,9 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
+    CommonHelper::FrameImageCache::GetInstance().Clear();
+    ComputeResourceManager::GetInstance().Reset();
+
     return 0;
 }
 
@@ -163,6 +170,9 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         return -1;
     }
 
+    /* Share the pyramid and color conversion of this frame among the engines */
+    CommonHelper::FrameImageCache::GetInstance().SetFrame(mat);
+
     constexpr int32_t INTERVAL_TO_CALCULATE_CONTENT_BOTTLENECK = 10; // to increase FPS (no need to do this every frame)
     static float s_merged_style_bottleneck[StylePredictionEngine::SIZE_STYLE_BOTTLENECK];
     static int32_t s_cnt = 0;
@@ -32,10 +32,14 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "engine_config.h"
+#include "lazy_engine.h"
+#include "compute_resource_manager.h"
 #include "bounding_box.h"
 #include "detection_engine.h"
 #include "feature_engine.h"
 #include "tracker_deepsort.h"
+#include "detection_scheduler.h"
 #include "image_processor.h"
 
 /*** Macro ***/
@@ -45,14 +49,20 @@ limitations under the License.
 
 #define USE_DEEPSORT
 
+/*** Setting ***/
+/* Run detector (and feature extraction) every N frames (and when tracks are uncertain). Tracks are moved by Kalman filter + optical flow on the other frames. 1: every frame */
+static constexpr int32_t kDetectionInterval = 1;
+
 /*** Global variable ***/
 std::unique_ptr<DetectionEngine> s_det_engine;
-std::unique_ptr<FeatureEngine> s_feature_engine;
+LazyEngine<FeatureEngine> s_feature_engine;
 #ifdef USE_DEEPSORT
 TrackerDeepSort s_tracker(30);
 #else
 TrackerDeepSort s_tracker(2);
 #endif
+DetectionScheduler s_scheduler;
+cv::Rect s_crop_last;
 
 /*** Function ***/
 static void DrawFps(cv::Mat& mat, double time_inference_det, double time_inference_feature, int32_t num_feature, cv::Point pos, double font_scale, int32_t thickness, cv::Scalar color_front, cv::Scalar color_back, bool is_text_on_rect = true)
@@ -81,31 +91,34 @@ static cv::Scalar GetColorForId(int32_t id)
 
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
-    if (s_det_engine || s_feature_engine) {
+    if (s_det_engine || s_feature_engine.IsSetup()) {
         PRINT_E("Already initialized\n");
         return -1;
     }
 
+    auto& resource_manager = ComputeResourceManager::GetInstance();
+    resource_manager.ConfigureMainThread(input_param.num_threads);
+
     s_det_engine.reset(new DetectionEngine(0.4f, 0.2f, 0.5f));
-    if (s_det_engine->Initialize(input_param.work_dir, input_param.num_threads) != DetectionEngine::kRetOk) {
+    if (s_det_engine->Initialize(input_param.work_dir, resource_manager.Reserve("DetectionEngine", input_param.num_threads).num_threads) != DetectionEngine::kRetOk) {
         s_det_engine->Finalize();
         s_det_engine.reset();
         return -1;
     }
 
-    s_feature_engine.reset(new FeatureEngine());
-    if (s_feature_engine->Initialize(input_param.work_dir, input_param.num_threads) != FeatureEngine::kRetOk) {
-        s_feature_engine->Finalize();
-        s_feature_engine.reset();
+    if (s_feature_engine.Setup(input_param.work_dir, resource_manager.Reserve("FeatureEngine", input_param.num_threads)) != LazyEngine<FeatureEngine>::kRetOk) {
+        s_det_engine->Finalize();
+        s_det_engine.reset();
         return -1;
     }
-    
+
+    s_scheduler = DetectionScheduler(EngineConfig::GetInstance().GetInt(TAG, "detection_interval", kDetectionInterval));
     return 0;
 }
 
 int32_t ImageProcessor::Finalize(void)
 {
-    if (!s_det_engine || !s_feature_engine) {
+    if (!s_det_engine || !s_feature_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -114,9 +127,10 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
-    if (s_feature_engine->Finalize() != FeatureEngine::kRetOk) {
-        return -1;
-    }
+    s_feature_engine.Release();
+
+    CommonHelper::FrameImageCache::GetInstance().Clear();
+    ComputeResourceManager::GetInstance().Reset();
 
     return 0;
 }
@@ -124,7 +138,7 @@ int32_t ImageProcessor::Finalize(void)
 
 int32_t ImageProcessor::Command(int32_t cmd)
 {
-    if (!s_det_engine || !s_feature_engine) {
+    if (!s_det_engine || !s_feature_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -140,15 +154,27 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
 int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
 {
-    if (!s_det_engine || !s_feature_engine) {
+    if (!s_det_engine || !s_feature_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
 
+    /* Share the pyramid and color conversion of this frame among the engines */
+    CommonHelper::FrameImageCache::GetInstance().SetFrame(mat);
+
     /* Detection */
+    const bool is_detection_frame = s_scheduler.CheckDetectionFrame(mat);
     DetectionEngine::Result det_result;
-    if (s_det_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
-        return -1;
+    if (is_detection_frame) {
+        if (s_det_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
+            return -1;
+        }
+        s_crop_last = cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h);
+    } else {
+        det_result.crop.x = s_crop_last.x;
+        det_result.crop.y = s_crop_last.y;
+        det_result.crop.w = s_crop_last.width;
+        det_result.crop.h = s_crop_last.height;
     }
 
     /* Extract feature for the detected objects */
@@ -159,8 +185,12 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     for (const auto& bbox : det_result.bbox_list) {
 #ifdef USE_DEEPSORT
         if (bbox.class_id == 0) {   /* Calculate face feature for person only */
-            FeatureEngine::Result feature_result;
-            if (s_feature_engine->Process(mat, bbox, feature_result) != DetectionEngine::kRetOk) {
+            FeatureEngine::Result feature_result;   /* the length of feature is 0 while FeatureEngine is loading */
+            FeatureEngine* feature_engine = s_feature_engine.Get();
+            if (s_feature_engine.IsError()) {
+                return -1;
+            }
+            if (feature_engine && feature_engine->Process(mat, bbox, feature_result) != DetectionEngine::kRetOk) {
                 return -1;
             }
             feature_list.push_back(feature_result.feature);
@@ -174,6 +204,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         feature_list.push_back(std::vector<float>());   /* the length of feature is 0. so it's not used in tracker (DeepSORT) */
 #endif
     }
+    s_feature_engine.CheckIdle();
 
     /* Display target area  */
     cv::rectangle(mat, cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);
@@ -186,7 +217,13 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     }
 
     /* Display tracking result  */
-    s_tracker.Update(det_result.bbox_list, feature_list);
+    if (is_detection_frame) {
+        s_tracker.Update(det_result.bbox_list, feature_list);
+    } else {
+        /* No inference. Only tracks move */
+        s_scheduler.Interpolate(s_tracker);
+    }
+    s_scheduler.UpdateTrackStatus(s_tracker);
     int32_t num_track = 0;
     auto& track_list = s_tracker.GetTrackList();
     for (auto& track : track_list) {
@@ -210,6 +247,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     DrawFps(mat, det_result.time_inference, time_inference_feature, static_cast<int32_t>(feature_list.size()), cv::Point(0, 0), 0.5, 2, CommonHelper::CreateCvColor(0, 0, 0), CommonHelper::CreateCvColor(180, 180, 180), true);
 
     /* Return the results */
+    result.is_detection_frame = is_detection_frame;
     result.time_pre_process = det_result.time_pre_process + time_pre_process_feature;
     result.time_inference = det_result.time_inference + time_inference_feature;
     result.time_post_process = det_result.time_post_process + time_post_process_feature;
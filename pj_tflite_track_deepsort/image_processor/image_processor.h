@@ -37,6 +37,7 @@ typedef struct {
 } InputParam;
 
 typedef struct {
+    bool   is_detection_frame;  // false: detector was not run and objects were moved by tracker
     double time_pre_process;   // [msec]
     double time_inference;    // [msec]
     double time_post_process;  // [msec]
@@ -99,6 +99,18 @@ void TrackDeepSort::UpdateNoDetect()
     cnt_undetected_++;
 }
 
+void TrackDeepSort::Correct(const BoundingBox& bbox)
+{
+    kf_.Update(Bbox2KalmanObserved(bbox));
+
+    BoundingBox& bbox_latest = data_history_.back().bbox;
+    BoundingBox bbox_est = KalmanStatus2Bbox(kf_.X);   // w, y, w, h only
+    bbox_latest.w = bbox_est.w;
+    bbox_latest.h = bbox_est.h;
+    bbox_latest.x = bbox_est.x;
+    bbox_latest.y = bbox_est.y;
+}
+
 std::deque<TrackDeepSort::Data>& TrackDeepSort::GetDataHistory()
 {
     return data_history_;
@@ -129,6 +141,16 @@ const int32_t TrackDeepSort::GetDetectedCount() const
     return cnt_detected_;
 }
 
+float TrackDeepSort::GetPositionUncertainty() const
+{
+    return static_cast<float>(std::sqrt((kf_.P(0, 0) + kf_.P(1, 1)) / 2));
+}
+
+float TrackDeepSort::GetSpeed() const
+{
+    return static_cast<float>(std::sqrt(kf_.X(4, 0) * kf_.X(4, 0) + kf_.X(5, 0) * kf_.X(5, 0)));
+}
+
 
 static constexpr int32_t kNumObserve = 4;   /* (cx, cy, area, aspect) */
 static constexpr int32_t kNumStatus = 7;    /* (cx, cy, area, aspect, vx, vy, vz)   (v = speed)*/
@@ -345,6 +367,16 @@ float TrackerDeepSort::CalculateCost(TrackDeepSort& track, const BoundingBox& de
 }
 
 
+void TrackerDeepSort::Predict()
+{
+    for (auto& track : track_list_) {
+        float score = track.GetLatestBoundingBox().score;
+        track.Predict();
+        track.GetLatestData().bbox.score = score;   /* bbox_raw keeps score = 0 (not detected), so the feature is not compared */
+        track.UpdateNoDetect();     /* count frames, not detection frames, so that a lost track is deleted after the same time at any detection interval */
+    }
+}
+
 void TrackerDeepSort::Update(const std::vector<BoundingBox>& det_list, const std::vector<std::vector<float>>& feature_list)
 {
     /*** Predict the position at the current frame using the previous status for all tracked bbox ***/
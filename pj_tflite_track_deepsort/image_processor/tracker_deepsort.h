@@ -48,6 +48,8 @@ public:
     BoundingBox Predict();
     void Update(const BoundingBox& bbox_det);
     void UpdateNoDetect();
+    /* Correct the predicted position with a measurement which is not a detection (e.g. optical flow). Counters are not changed */
+    void Correct(const BoundingBox& bbox);
 
     std::deque<Data>& GetDataHistory();
     Data& GetLatestData() ;
@@ -56,6 +58,8 @@ public:
     const int32_t GetId() const;
     const int32_t GetUndetectedCount() const;
     const int32_t GetDetectedCount() const;
+    float GetPositionUncertainty() const;   /* standard deviation of the center position in Kalman filter [px] */
+    float GetSpeed() const;                 /* speed of the center position in Kalman filter [px/frame] */
 
 private:
     KalmanFilter CreateKalmanFilter_UniformLinearMotion(const BoundingBox& bbox_start);
@@ -82,6 +86,9 @@ public:
     void Reset();
 
     void Update(const std::vector<BoundingBox>& det_list, const std::vector<std::vector<float>>& feature_list);
+    /* For the frame where detection is not run. All tracks move by prediction only and keep the score of the last detection */
+    /* They are not deleted here, but the frame is counted as undetected (reset by the next detection) */
+    void Predict();
 
     std::vector<TrackDeepSort>& GetTrackList();
 
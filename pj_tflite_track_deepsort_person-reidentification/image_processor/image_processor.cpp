@@ -32,6 +32,7 @@ limitations under the License.
 /* for My modules */
 #include "common_helper.h"
 #include "common_helper_cv.h"
+#include "lazy_engine.h"
 #include "bounding_box.h"
 #include "detection_engine.h"
 #include "feature_engine.h"
@@ -47,7 +48,7 @@ limitations under the License.
 
 /*** Global variable ***/
 std::unique_ptr<DetectionEngine> s_det_engine;
-std::unique_ptr<FeatureEngine> s_feature_engine;
+LazyEngine<FeatureEngine> s_feature_engine;
 #ifdef USE_DEEPSORT
 TrackerDeepSort s_tracker(200);
 #else
@@ -81,7 +82,7 @@ static cv::Scalar GetColorForId(int32_t id)
 
 int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param)
 {
-    if (s_det_engine || s_feature_engine) {
+    if (s_det_engine || s_feature_engine.IsSetup()) {
         PRINT_E("Already initialized\n");
         return -1;
     }
@@ -93,10 +94,9 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
         return -1;
     }
 
-    s_feature_engine.reset(new FeatureEngine());
-    if (s_feature_engine->Initialize(input_param.work_dir, input_param.num_threads) != FeatureEngine::kRetOk) {
-        s_feature_engine->Finalize();
-        s_feature_engine.reset();
+    if (s_feature_engine.Setup(input_param.work_dir, input_param.num_threads) != LazyEngine<FeatureEngine>::kRetOk) {
+        s_det_engine->Finalize();
+        s_det_engine.reset();
         return -1;
     }
     
@@ -105,7 +105,7 @@ int32_t ImageProcessor::Initialize(const ImageProcessor::InputParam& input_param
 
 int32_t ImageProcessor::Finalize(void)
 {
-    if (!s_det_engine || !s_feature_engine) {
+    if (!s_det_engine || !s_feature_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -114,9 +114,9 @@ int32_t ImageProcessor::Finalize(void)
         return -1;
     }
 
-    if (s_feature_engine->Finalize() != FeatureEngine::kRetOk) {
-        return -1;
-    }
+    s_feature_engine.Release();
+
+    CommonHelper::FrameImageCache::GetInstance().Clear();
 
     return 0;
 }
@@ -124,7 +124,7 @@ int32_t ImageProcessor::Finalize(void)
 
 int32_t ImageProcessor::Command(int32_t cmd)
 {
-    if (!s_det_engine || !s_feature_engine) {
+    if (!s_det_engine || !s_feature_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
@@ -140,11 +140,14 @@ int32_t ImageProcessor::Command(int32_t cmd)
 
 int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
 {
-    if (!s_det_engine || !s_feature_engine) {
+    if (!s_det_engine || !s_feature_engine.IsSetup()) {
         PRINT_E("Not initialized\n");
         return -1;
     }
 
+    /* Share the pyramid and color conversion of this frame among the engines */
+    CommonHelper::FrameImageCache::GetInstance().SetFrame(mat);
+
     /* Detection */
     DetectionEngine::Result det_result;
     if (s_det_engine->Process(mat, det_result) != DetectionEngine::kRetOk) {
@@ -159,8 +162,12 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
     for (const auto& bbox : det_result.bbox_list) {
 #ifdef USE_DEEPSORT
         if (bbox.class_id == 0) {   /* Calculate face feature for person only */
-            FeatureEngine::Result feature_result;
-            if (s_feature_engine->Process(mat, bbox, feature_result) != DetectionEngine::kRetOk) {
+            FeatureEngine::Result feature_result;   /* the length of feature is 0 while FeatureEngine is loading */
+            FeatureEngine* feature_engine = s_feature_engine.Get();
+            if (s_feature_engine.IsError()) {
+                return -1;
+            }
+            if (feature_engine && feature_engine->Process(mat, bbox, feature_result) != DetectionEngine::kRetOk) {
                 return -1;
             }
             feature_list.push_back(feature_result.feature);
@@ -174,6 +181,7 @@ int32_t ImageProcessor::Process(cv::Mat& mat, ImageProcessor::Result& result)
         feature_list.push_back(std::vector<float>());   /* the length of feature is 0. so it's not used in tracker (DeepSORT) */
 #endif
     }
+    s_feature_engine.CheckIdle();
 
     /* Display target area  */
     cv::rectangle(mat, cv::Rect(det_result.crop.x, det_result.crop.y, det_result.crop.w, det_result.crop.h), CommonHelper::CreateCvColor(0, 0, 0), 2);